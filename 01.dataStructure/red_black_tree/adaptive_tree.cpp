@@ -0,0 +1,478 @@
+/**
+ * @file adaptive_tree.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 根据负载自动切换底层引擎的有序集合：小数组 / 冻结的有序数组 / 红黑树
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#define RBTREE_NO_MAIN
+#include "red_black_tree_recursion.cpp"
+
+using std::vector;
+
+/*
+    没有一种数据结构对所有负载都是最优的：
+    1. 元素很少时，一个放在结构体内部的小有序数组最快，查找是在一两条缓存行里线性扫描，插入删除也只是挪动几个元素；
+    2. 读多写少时，有序数组 + 二分查找比红黑树更快也更省内存，数组是连续的，没有指针和颜色的开销；如果写入的key总是
+       比当前最大值大（例如自增ID、时间戳），有序数组的插入就是push_back，同样适合用有序数组；
+    3. 随机写多的时候，有序数组每次插入都要挪动O(n)个元素，只能使用红黑树。
+
+    因此门面在每次操作时顺便统计一个采样窗口内的：读写比例、写入的顺序性（追加到末尾的比例）以及读的倾斜程度（命中
+最近访问过的key的比例）。每个窗口结束时根据统计结果以及当前的元素个数决定应该使用的引擎，连续两个窗口的结论一致
+才真正迁移，避免在两个引擎之间来回抖动。迁移时先把数据按序导出到数组中，再一次性批量构建新的引擎，不逐个key重新插入。
+*/
+
+#define ADAPTIVE_ENGINE_INLINE 0
+#define ADAPTIVE_ENGINE_SORTED 1
+#define ADAPTIVE_ENGINE_RBTREE 2
+
+#define ADAPTIVE_INLINE_MAX     16
+#define ADAPTIVE_SAMPLE_WINDOW  4096
+#define ADAPTIVE_RECENT_SLOTS   64
+
+static const char *adaptive_engine_names[] = {"inline", "sorted", "rbtree"};
+
+// 一个采样窗口内的统计信息
+typedef struct adaptive_stats {
+    int reads;
+    int writes;
+    int appends;        // 写入的key大于当前最大值的次数
+    int recent_hits;    // 读命中最近访问过的key的次数
+    USER_KEY_TYPE recent[ADAPTIVE_RECENT_SLOTS];
+} t_adaptive_stats;
+
+typedef struct adaptive_tree {
+    int engine;
+    int pending_engine;     // 上一个窗口建议迁移到的引擎，用于防抖
+    long long size;
+    int migrations;
+    int max_valid;          // max_key是否有效，删除最大值后失效，下次插入时重新计算
+    USER_KEY_TYPE max_key;
+
+    // ADAPTIVE_ENGINE_INLINE
+    int inline_count;
+    USER_KEY_TYPE inline_keys[ADAPTIVE_INLINE_MAX];
+
+    // ADAPTIVE_ENGINE_SORTED
+    vector<USER_KEY_TYPE> sorted;
+
+    // ADAPTIVE_ENGINE_RBTREE
+    t_rbtree rbtree;
+
+    t_adaptive_stats stats;
+} t_adaptive_tree;
+
+void adaptive_init(t_adaptive_tree *tree) {
+    tree->engine = tree->pending_engine = ADAPTIVE_ENGINE_INLINE;
+    tree->size = 0;
+    tree->migrations = 0;
+    tree->max_valid = 0;
+    tree->inline_count = 0;
+    tree->sorted.clear();
+    rbtree_init(&tree->rbtree);
+    tree->stats = t_adaptive_stats{};
+}
+
+/* ------------------------------ 红黑树的批量构建 ------------------------------ */
+
+/*
+    由有序数组直接构建红黑树：每次取中点作为根，左右两半递归构建，得到的是一棵除最后一层以外全满的二叉树。
+设满的层数为full_levels，那么把最后一层（深度为full_levels）的节点染红，其余全部染黑，从根到任意nil节点的路径上
+都恰好有full_levels个黑色节点，且红色节点的孩子都是nil，满足红黑树的所有性质。整个过程是O(n)的，没有任何旋转。
+*/
+static t_rbtree_node *__rbtree_build(const USER_KEY_TYPE *keys, long long lo, long long hi, int depth, int full_levels) {
+    if (lo >= hi)
+        return nil_node;
+
+    long long mid = lo + (hi - lo) / 2;
+    t_rbtree_node *node = rbtree_create_node(keys[mid]);
+    node->color = (depth >= full_levels ? RBTREE_CLR_RED : RBTREE_CLR_BLK);
+    node->left = __rbtree_build(keys, lo, mid, depth + 1, full_levels);
+    node->right = __rbtree_build(keys, mid + 1, hi, depth + 1, full_levels);
+
+    return node;
+}
+
+void rbtree_build_from_sorted(t_rbtree *tree, const USER_KEY_TYPE *keys, long long count) {
+    int full_levels = 0;
+    while ((1LL << (full_levels + 1)) - 1 <= count) {
+        ++full_levels;
+    }
+
+    tree->root = __rbtree_build(keys, 0, count, 0, full_levels);
+    tree->size = count;
+}
+
+/* ---------------------------------- 引擎迁移 --------------------------------- */
+
+// 把当前引擎中的所有key按序导出
+static void __adaptive_export(t_adaptive_tree *tree, vector<USER_KEY_TYPE>& keys) {
+    keys.reserve(tree->size);
+    if (tree->engine == ADAPTIVE_ENGINE_INLINE) {
+        keys.assign(tree->inline_keys, tree->inline_keys + tree->inline_count);
+    } else if (tree->engine == ADAPTIVE_ENGINE_SORTED) {
+        keys.swap(tree->sorted);
+    } else {
+        inorder_traversal(&tree->rbtree, keys);
+        rbtree_destroy(&tree->rbtree);
+        rbtree_init(&tree->rbtree);
+    }
+}
+
+static void __adaptive_migrate(t_adaptive_tree *tree, int engine) {
+    if (engine == tree->engine)
+        return;
+
+    vector<USER_KEY_TYPE> keys;
+    __adaptive_export(tree, keys);
+    tree->inline_count = 0;
+
+    if (engine == ADAPTIVE_ENGINE_INLINE) {
+        std::copy(keys.begin(), keys.end(), tree->inline_keys);
+        tree->inline_count = keys.size();
+    } else if (engine == ADAPTIVE_ENGINE_SORTED) {
+        tree->sorted.swap(keys);
+    } else {
+        rbtree_build_from_sorted(&tree->rbtree, keys.data(), keys.size());
+    }
+
+    tree->engine = engine;
+    tree->migrations++;
+}
+
+// 根据一个窗口的统计结果决定应该使用的引擎
+static int __adaptive_choose_engine(const t_adaptive_tree *tree) {
+    const t_adaptive_stats *stats = &tree->stats;
+    // 小数组满了之后的下一次插入就要迁移出去，刚好满的时候不再迁回来
+    if (tree->size < ADAPTIVE_INLINE_MAX)
+        return ADAPTIVE_ENGINE_INLINE;
+
+    // 写入几乎都是追加时，有序数组的插入是O(1)的
+    if (stats->writes > 0 && stats->appends * 10 >= stats->writes * 9)
+        return ADAPTIVE_ENGINE_SORTED;
+
+    // 读多写少时使用有序数组。有序数组的一次随机写要挪动O(n)个元素，按每64个元素的挪动大致相当于一次树上查找
+    // 的代价估算，写的总代价不超过读的总代价时才用有序数组；读越倾斜，热点所在的缓存行越集中，能容忍的写越多
+    int skewed = stats->reads && stats->recent_hits * 2 >= stats->reads;
+    long long write_cost = (long long)stats->writes * (tree->size / 64 + 1);
+    if (write_cost <= (long long)stats->reads * (skewed ? 2 : 1))
+        return ADAPTIVE_ENGINE_SORTED;
+
+    return ADAPTIVE_ENGINE_RBTREE;
+}
+
+// 每次操作后调用，窗口结束时做一次决策
+static void __adaptive_sample(t_adaptive_tree *tree) {
+    t_adaptive_stats *stats = &tree->stats;
+    if (stats->reads + stats->writes < ADAPTIVE_SAMPLE_WINDOW)
+        return;
+
+    int engine = __adaptive_choose_engine(tree);
+    if (engine != tree->engine && engine == tree->pending_engine) {
+        __adaptive_migrate(tree, engine);
+    }
+    tree->pending_engine = engine;
+    *stats = t_adaptive_stats{};
+}
+
+// 返回当前的最大key，用于判断写入是否为追加，集合为空时返回0
+static int __adaptive_max_key(t_adaptive_tree *tree, USER_KEY_TYPE *max_key) {
+    if (tree->size == 0)
+        return 0;
+
+    if (!tree->max_valid) {
+        if (tree->engine == ADAPTIVE_ENGINE_INLINE) {
+            tree->max_key = tree->inline_keys[tree->inline_count - 1];
+        } else if (tree->engine == ADAPTIVE_ENGINE_SORTED) {
+            tree->max_key = tree->sorted.back();
+        } else {
+            t_rbtree_node *cursor = tree->rbtree.root;
+            while (cursor->right != nil_node) {
+                cursor = cursor->right;
+            }
+            tree->max_key = cursor->key;
+        }
+        tree->max_valid = 1;
+    }
+
+    *max_key = tree->max_key;
+    return 1;
+}
+
+/*
+    无分支的二分查找：每轮只根据比较结果选择下一段的起点，编译器会生成条件传送指令，没有分支预测失败，并且下一轮
+访问的两个候选位置在比较之前就已经确定，CPU可以提前把它们取到缓存中。
+*/
+static int __sorted_contains(const USER_KEY_TYPE *base, size_t count, USER_KEY_TYPE key) {
+    if (count == 0)
+        return 0;
+
+    while (count > 1) {
+        size_t half = count / 2;
+        base = (base[half] <= key) ? base + half : base;
+        count -= half;
+    }
+
+    return *base == key;
+}
+
+/* ---------------------------------- 对外接口 --------------------------------- */
+
+// 查找key，存在返回1，否则返回0
+int adaptive_find(t_adaptive_tree *tree, USER_KEY_TYPE key) {
+    if (nullptr == tree)
+        return 0;
+
+    int found = 0;
+    if (tree->engine == ADAPTIVE_ENGINE_INLINE) {
+        // 元素很少，不做提前退出，全部比较一遍反而没有分支预测失败
+        for (int i = 0; i < tree->inline_count; ++i) {
+            found |= (tree->inline_keys[i] == key);
+        }
+    } else if (tree->engine == ADAPTIVE_ENGINE_SORTED) {
+        found = __sorted_contains(tree->sorted.data(), tree->sorted.size(), key);
+    } else {
+        found = rbtree_find(&tree->rbtree, key) != nullptr;
+    }
+
+    t_adaptive_stats *stats = &tree->stats;
+    unsigned slot = (unsigned)key % ADAPTIVE_RECENT_SLOTS;
+    stats->recent_hits += (stats->recent[slot] == key);
+    stats->recent[slot] = key;
+    stats->reads++;
+    __adaptive_sample(tree);
+
+    return found;
+}
+
+// 插入key，成功返回0，已存在返回1
+int adaptive_insert(t_adaptive_tree *tree, USER_KEY_TYPE key) {
+    if (nullptr == tree)
+        return -1;
+
+    USER_KEY_TYPE max_key = 0;
+    int append = !__adaptive_max_key(tree, &max_key) || key > max_key;
+    int ret = 0;
+
+    // 小数组已经满了，不能等到窗口结束，写入之前先迁移到有序数组
+    if (tree->engine == ADAPTIVE_ENGINE_INLINE && tree->inline_count == ADAPTIVE_INLINE_MAX) {
+        __adaptive_migrate(tree, ADAPTIVE_ENGINE_SORTED);
+    }
+
+    if (tree->engine == ADAPTIVE_ENGINE_INLINE) {
+        USER_KEY_TYPE *end = tree->inline_keys + tree->inline_count;
+        USER_KEY_TYPE *pos = std::lower_bound(tree->inline_keys, end, key);
+        if (pos != end && *pos == key) {
+            ret = 1;
+        } else {
+            std::copy_backward(pos, end, end + 1);
+            *pos = key;
+            tree->inline_count++;
+        }
+    } else if (tree->engine == ADAPTIVE_ENGINE_SORTED) {
+        if (append) {
+            tree->sorted.push_back(key);
+        } else {
+            auto pos = std::lower_bound(tree->sorted.begin(), tree->sorted.end(), key);
+            if (*pos == key) {
+                ret = 1;
+            } else {
+                tree->sorted.insert(pos, key);
+            }
+        }
+    } else {
+        // rbtree_insert不返回是否重复，先查一次以维护元素个数
+        if (rbtree_find(&tree->rbtree, key)) {
+            ret = 1;
+        } else {
+            rbtree_insert(&tree->rbtree, key);
+        }
+    }
+
+    if (ret == 0) {
+        tree->size++;
+        if (append) {
+            tree->max_key = key;
+            tree->max_valid = 1;
+        }
+    }
+    tree->stats.writes++;
+    tree->stats.appends += append;
+    __adaptive_sample(tree);
+
+    return ret;
+}
+
+// 删除key，成功返回0，不存在返回1
+int adaptive_erase(t_adaptive_tree *tree, USER_KEY_TYPE key) {
+    if (nullptr == tree)
+        return -1;
+
+    int ret = 0;
+    if (tree->engine == ADAPTIVE_ENGINE_INLINE) {
+        USER_KEY_TYPE *end = tree->inline_keys + tree->inline_count;
+        USER_KEY_TYPE *pos = std::lower_bound(tree->inline_keys, end, key);
+        if (pos == end || *pos != key) {
+            ret = 1;
+        } else {
+            std::copy(pos + 1, end, pos);
+            tree->inline_count--;
+        }
+    } else if (tree->engine == ADAPTIVE_ENGINE_SORTED) {
+        auto pos = std::lower_bound(tree->sorted.begin(), tree->sorted.end(), key);
+        if (pos == tree->sorted.end() || *pos != key) {
+            ret = 1;
+        } else {
+            tree->sorted.erase(pos);
+        }
+    } else {
+        if (!rbtree_find(&tree->rbtree, key)) {
+            ret = 1;
+        } else {
+            rbtree_erase(&tree->rbtree, key);
+        }
+    }
+
+    if (ret == 0) {
+        tree->size--;
+        tree->max_valid &= (key != tree->max_key);
+    }
+    tree->stats.writes++;
+    __adaptive_sample(tree);
+
+    return ret;
+}
+
+int inorder_traversal(t_adaptive_tree *tree, vector<int>& result) {
+    if (nullptr == tree)
+        return -1;
+
+    if (tree->engine == ADAPTIVE_ENGINE_INLINE) {
+        result.insert(result.end(), tree->inline_keys, tree->inline_keys + tree->inline_count);
+    } else if (tree->engine == ADAPTIVE_ENGINE_SORTED) {
+        result.insert(result.end(), tree->sorted.begin(), tree->sorted.end());
+    } else {
+        inorder_traversal(&tree->rbtree, result);
+    }
+
+    return 0;
+}
+
+void adaptive_destroy(t_adaptive_tree *tree) {
+    if (nullptr == tree)
+        return;
+
+    rbtree_destroy(&tree->rbtree);
+    adaptive_init(tree);
+}
+
+/* ---------------------------------- 性能对比 --------------------------------- */
+
+#define BENCH_OPS (1 << 20)
+
+// 模拟一个租户的负载，kind决定读写比例和key的分布
+static void tenant_workload(int kind, int i, std::mt19937& rng, int& op, int& key) {
+    switch (kind) {
+    case 0: // 只有少量key的配置表
+        op = (i % 8 == 0) ? 0 : 2;
+        key = rng() % 12;
+        break;
+    case 1: // 先批量导入，之后几乎只读
+        op = (i < BENCH_OPS / 4) ? 0 : ((rng() % 100000 == 0) ? 0 : 2);
+        key = rng() % (BENCH_OPS / 2);
+        break;
+    case 2: // 自增ID，追加写和查找各占一半
+        op = (i & 1) ? 0 : 2;
+        key = (i & 1) ? i : rng() % (i + 1);
+        break;
+    default: // 随机读写各占一半
+        op = rng() % 4;
+        op = (op == 3) ? 2 : op;
+        key = rng() % (BENCH_OPS / 2);
+        break;
+    }
+}
+
+int main() {
+    // 与红黑树相同的测试数据
+    int nums[] = {12,31,24,5,12,5,34,9,2985,324,5,69,8};
+    int len = sizeof(nums) / sizeof(int);
+
+    t_adaptive_tree tree;
+    adaptive_init(&tree);
+    for (int i = 0; i < len; ++i) {
+        adaptive_insert(&tree, nums[i]);
+    }
+
+    int del_nums[] = {5, 0, 12, 2985, 69};
+    len = sizeof(del_nums) / sizeof(int);
+    for (int i = 0; i < len; ++i) {
+        adaptive_erase(&tree, del_nums[i]);
+    }
+
+    vector<int> result;
+    inorder_traversal(&tree, result);
+    for (auto key : result) {
+        std::printf("%d ", key);
+    }
+    std::printf("(engine: %s)\n", adaptive_engine_names[tree.engine]);
+    adaptive_destroy(&tree);
+
+    const char *tenants[] = {"tiny", "read-mostly", "append", "random-rw"};
+    std::printf("%12s %10s %12s %14s %14s\n", "tenant", "engine", "migrations", "adaptive ms", "rbtree ms");
+    for (int kind = 0; kind < 4; ++kind) {
+        std::mt19937 rng(kind + 1);
+        long long hits = 0; // 两边命中的次数应该相同，同时防止编译器把查找优化掉
+        adaptive_init(&tree);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < BENCH_OPS; ++i) {
+            int op, key;
+            tenant_workload(kind, i, rng, op, key);
+            if (op == 0) {
+                adaptive_insert(&tree, key);
+            } else if (op == 1) {
+                adaptive_erase(&tree, key);
+            } else {
+                hits += adaptive_find(&tree, key);
+            }
+        }
+        double adaptive_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        rng.seed(kind + 1);
+        t_rbtree rbtree = {};
+        rbtree_init(&rbtree);
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < BENCH_OPS; ++i) {
+            int op, key;
+            tenant_workload(kind, i, rng, op, key);
+            if (op == 0) {
+                rbtree_insert(&rbtree, key);
+            } else if (op == 1) {
+                rbtree_erase(&rbtree, key);
+            } else {
+                hits -= rbtree_find(&rbtree, key) != nullptr;
+            }
+        }
+        double rbtree_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        rbtree_destroy(&rbtree);
+        if (hits != 0) {
+            std::printf("hits mismatch: %lld\n", hits);
+        }
+
+        std::printf("%12s %10s %12d %14.1f %14.1f\n",
+                    tenants[kind], adaptive_engine_names[tree.engine], tree.migrations, adaptive_ms, rbtree_ms);
+        adaptive_destroy(&tree);
+    }
+
+    return 0;
+}
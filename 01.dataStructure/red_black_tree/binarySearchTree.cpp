@@ -10,6 +10,7 @@
  */
 
 #include <cstdio>
+#include <malloc.h>
 #include <vector>
 
 using std::vector;
@@ -37,6 +38,7 @@ typedef struct bstree_node {
 // 两个结构体，第二个结构体只保存二叉搜索树的根节点 
 typedef struct bstree {
     t_bstree_node *root;
+    long long size;     // 节点个数，由插入、删除维护
 } t_bstree; 
 
 // 创建二叉搜索树的节点
@@ -51,6 +53,38 @@ t_bstree_node *create_bstree_node(USER_KEY_TYPE key) {
     return node;
 }
 
+// 初始化为空树
+void bstree_init(t_bstree *tree) {
+    tree->root = nullptr;
+    tree->size = 0;
+}
+
+/*
+    每个节点实际占用的字节数，bstree_memory_usage按它计算整棵树的内存。与红黑树的rbtree_node_footprint一样，默认值
+按glibc malloc估算：malloc_usable_size加上8字节的块头，换用其他分配器时只是估计值。
+*/
+size_t bstree_default_node_footprint() {
+    t_bstree_node *node = new t_bstree_node;
+    size_t footprint = malloc_usable_size(node) + sizeof(size_t);
+    delete node;
+    return footprint;
+}
+
+size_t bstree_node_footprint = bstree_default_node_footprint();
+
+// 节点个数，O(1)
+long long bstree_size(t_bstree *tree) {
+    return nullptr == tree ? 0 : tree->size;
+}
+
+// 整棵树占用的内存字节数（树本身加上所有节点），O(1)
+size_t bstree_memory_usage(t_bstree *tree) {
+    if (nullptr == tree)
+        return 0;
+
+    return sizeof(t_bstree) + tree->size * bstree_node_footprint;
+}
+
 // 向指定的二叉搜索树中插入节点
 int insert_node_to_bstree(t_bstree *tree, USER_KEY_TYPE key) {
     if (nullptr == tree) 
@@ -64,6 +98,7 @@ int insert_node_to_bstree(t_bstree *tree, USER_KEY_TYPE key) {
         }
 
         tree->root = node;
+        tree->size = 1;
         return 0;
     }    
     
@@ -93,10 +128,82 @@ int insert_node_to_bstree(t_bstree *tree, USER_KEY_TYPE key) {
     } else {
         cursor_parent->entry.right = node;
     }
+    ++tree->size;
+
+    return 0;
+}
+
+// 查找指定key的节点，找不到时返回nullptr
+t_bstree_node *find_node_in_bstree(t_bstree *tree, USER_KEY_TYPE key) {
+    if (nullptr == tree)
+        return nullptr;
+
+    t_bstree_node *cursor = tree->root;
+    while (cursor && cursor->key != key) {
+        cursor = (key < cursor->key ? cursor->entry.left : cursor->entry.right);
+    }
+
+    return cursor;
+}
+
+// 删除指定key的节点，成功返回0，不存在返回1
+int erase_node_from_bstree(t_bstree *tree, USER_KEY_TYPE key) {
+    if (nullptr == tree)
+        return -1;
+
+    // link指向“指向当前节点的指针”，删除时直接改写它，不需要区分当前节点是根、左孩子还是右孩子
+    t_bstree_node **link = &tree->root;
+    while (*link && (*link)->key != key) {
+        link = (key < (*link)->key ? &(*link)->entry.left : &(*link)->entry.right);
+    }
+
+    t_bstree_node *node = *link;
+    if (nullptr == node)
+        return 1;
+
+    // 度为2时，把右子树中的最小节点（后继）摘下来顶替当前节点
+    if (node->entry.left && node->entry.right) {
+        t_bstree_node **successor = &node->entry.right;
+        while ((*successor)->entry.left) {
+            successor = &(*successor)->entry.left;
+        }
+
+        t_bstree_node *next = *successor;
+        *successor = next->entry.right;
+        next->entry.left = node->entry.left;
+        next->entry.right = node->entry.right;
+        *link = next;
+    } else {
+        *link = (node->entry.left ? node->entry.left : node->entry.right);
+    }
+    delete node;
+    --tree->size;
 
     return 0;
 }
 
+// 销毁整棵树。二叉搜索树可能退化成一条链，这里不用递归，而是不断右旋把左子树拉直，再逐个释放
+void destroy_bstree(t_bstree *tree) {
+    if (nullptr == tree)
+        return;
+
+    t_bstree_node *cursor = tree->root;
+    while (cursor) {
+        if (cursor->entry.left) {
+            t_bstree_node *child = cursor->entry.left;
+            cursor->entry.left = child->entry.right;
+            child->entry.right = cursor;
+            cursor = child;
+        } else {
+            t_bstree_node *next = cursor->entry.right;
+            delete cursor;
+            cursor = next;
+        }
+    }
+    tree->root = nullptr;
+    tree->size = 0;
+}
+
 // 中序遍历
 int inorder_traversal(t_bstree_node *root, vector<int>& result) {
     if (nullptr == root)
@@ -109,11 +216,14 @@ int inorder_traversal(t_bstree_node *root, vector<int>& result) {
     return 0;
 }
 
+// 其他文件可以直接#include本文件来复用二叉搜索树的实现，此时先定义BSTREE_NO_MAIN去掉下面的示例
+#ifndef BSTREE_NO_MAIN
 int main() {
     int nums[] = {12,31,24,5,12,5,34,9,2985,324,5,69,8};
     int len = sizeof(nums) / sizeof(int);
 
-    t_bstree tree = {0};
+    t_bstree tree;
+    bstree_init(&tree);
     for (int i = 0; i < len; ++i) {
         insert_node_to_bstree(&tree, nums[i]);
     }
@@ -124,6 +234,11 @@ int main() {
         std::printf("%d ", key);
     }
     std::printf("\n");
+    std::printf("size %lld, %zu bytes (%zu bytes per node)\n", bstree_size(&tree), bstree_memory_usage(&tree),
+                bstree_node_footprint);
+
+    destroy_bstree(&tree);
 
     return 0;
-}
\ No newline at end of file
+}
+#endif
@@ -0,0 +1,232 @@
+/**
+ * @file red_black_tree_adversarial.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 对抗性输入下的红黑树基准测试：构造让旋转、变色和双黑上移尽量多的操作序列，报告单个操作的最坏延迟
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// 打开调整计数，再复用并行构建中的__rbtree_build构造全黑的满二叉树
+#define RBTREE_COUNT_FIXUPS
+#define RBTREE_PARALLEL_BUILD_NO_MAIN
+#include "red_black_tree_parallel_build.cpp"
+
+using std::vector;
+
+/*
+    客户端可以任意选择key时，平均情况下的性能没有意义，需要关心的是对手能把单个操作的延迟推到多高。红黑树保证每次操作
+都是O(logn)的，但常数差别很大：rbtree_insert_maintian在回溯的每一层都可能做“红色上浮”的变色，__rbtree_erase_maintain
+在兄弟子树全黑时会让双黑节点一层层上移直到根。这里构造以下几类输入，逐个操作计时，并统计每个操作引起的旋转、变色和
+双黑上移次数：
+
+    1. ascending：递增插入，新节点总是挂在最右侧的脊上，每两次插入就要旋转一次，红色不断沿右脊上浮；
+    2. sawtooth：两端交替插入（0, n, 1, n-1, ...），左右两条脊轮流触发调整；
+    3. spine-churn：先建好一棵树，然后反复删除最小值、插入一个更小的新最小值，所有的修改都集中在最左侧的脊上；
+    4. black-leaf-erase：由2^k-1个有序key构建一棵所有节点都是黑色的满二叉树，此时删除任何一个叶子，兄弟子树都是
+       全黑的，双黑节点会一路上移到根。按位反转的顺序删除叶子，让每次删除尽量落在还没有被改过颜色的子树中，删除
+       之后再插回去，保持树的规模不变；
+    5. random：随机插入和删除，作为对照。
+
+    计时使用steady_clock，每次读取时钟本身有几十ns的开销，对最坏延迟（微秒级）的影响可以忽略。但max中也包含了线程被
+调度出去、缺页等与树无关的停顿，分析时应当结合p99.9以及单个操作的最大旋转数（maxR）和最大双黑上移层数（maxD），
+后两者只取决于输入。调整计数是编译期打开的（RBTREE_COUNT_FIXUPS），只是几个全局计数器的自增。
+*/
+
+#define ADV_OP_INSERT 0
+#define ADV_OP_ERASE  1
+
+typedef struct adv_op {
+    int type;
+    USER_KEY_TYPE key;
+} t_adv_op;
+
+typedef struct adv_report {
+    long long ops;
+    double mean_ns;
+    double p99_ns;
+    double p999_ns;
+    double max_ns;
+    t_adv_op worst_op;
+    double rotations;               // 平均每个操作
+    double recolors;
+    double dbl_pushups;
+    long long max_rotations;        // 单个操作中的最大值
+    long long max_dbl_pushups;
+} t_adv_report;
+
+static void run_ops(t_rbtree *tree, const vector<t_adv_op>& ops, t_adv_report *report) {
+    vector<int64_t> latencies;
+    latencies.reserve(ops.size());
+    report->max_rotations = report->max_dbl_pushups = 0;
+    report->worst_op = ops.empty() ? t_adv_op{0, 0} : ops[0];
+    int64_t worst = -1;
+
+    t_rbtree_fixup_stats before = rbtree_fixup_stats;
+    for (auto& op : ops) {
+        t_rbtree_fixup_stats previous = rbtree_fixup_stats;
+        auto start = std::chrono::steady_clock::now();
+        if (op.type == ADV_OP_INSERT) {
+            rbtree_insert(tree, op.key);
+        } else {
+            rbtree_erase(tree, op.key);
+        }
+        int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+        latencies.push_back(ns);
+        if (ns > worst) {
+            worst = ns;
+            report->worst_op = op;
+        }
+        report->max_rotations = std::max(report->max_rotations, rbtree_fixup_stats.rotations - previous.rotations);
+        report->max_dbl_pushups = std::max(report->max_dbl_pushups, rbtree_fixup_stats.dbl_pushups - previous.dbl_pushups);
+    }
+
+    long long count = std::max<long long>(1, ops.size());
+    report->ops = ops.size();
+    report->rotations = (double)(rbtree_fixup_stats.rotations - before.rotations) / count;
+    report->recolors = (double)(rbtree_fixup_stats.recolors - before.recolors) / count;
+    report->dbl_pushups = (double)(rbtree_fixup_stats.dbl_pushups - before.dbl_pushups) / count;
+
+    double sum = 0;
+    for (auto ns : latencies) {
+        sum += ns;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies.empty() ? 0.0 : (double)latencies[(size_t)(p * (latencies.size() - 1))];
+    };
+    report->mean_ns = sum / count;
+    report->p99_ns = percentile(0.99);
+    report->p999_ns = percentile(0.999);
+    report->max_ns = percentile(1.0);
+}
+
+static void print_report(const char *name, const t_adv_report& report) {
+    std::printf("%-18s %9lld %8.0f %8.0f %9.0f %9.0f %10s %-11d %7.2f %7.2f %7.2f %5lld %5lld\n", name, report.ops,
+                report.mean_ns, report.p99_ns, report.p999_ns, report.max_ns,
+                report.worst_op.type == ADV_OP_INSERT ? "insert" : "erase", report.worst_op.key,
+                report.rotations, report.recolors, report.dbl_pushups, report.max_rotations, report.max_dbl_pushups);
+}
+
+static void bench_pattern(const char *name, t_rbtree *tree, const vector<t_adv_op>& ops) {
+    t_adv_report report;
+    run_ops(tree, ops, &report);
+    print_report(name, report);
+    if (tree->root->color != RBTREE_CLR_BLK || __rbtree_check(tree->root) < 0) {
+        std::printf("%s: tree is no longer a valid red-black tree\n", name);
+    }
+}
+
+// 位反转，用于打散叶子的删除顺序
+static long long reverse_bits(long long value, int bits) {
+    long long result = 0;
+    for (int i = 0; i < bits; ++i) {
+        result = (result << 1) | ((value >> i) & 1);
+    }
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    int levels = argc > 1 ? std::atoi(argv[1]) : 20;
+    long long n = (1LL << levels) - 1;
+
+    std::printf("tree size %lld (%d levels)\n", n, levels);
+    std::printf("%-18s %9s %8s %8s %9s %9s %10s %-11s %7s %7s %7s %5s %5s\n", "pattern", "ops", "mean ns", "p99 ns",
+                "p99.9 ns", "max ns", "worst op", "key", "rot/op", "clr/op", "dbl/op", "maxR", "maxD");
+
+    // 1. 递增插入
+    {
+        vector<t_adv_op> ops;
+        for (long long i = 0; i < n; ++i) {
+            ops.push_back({ADV_OP_INSERT, (USER_KEY_TYPE)i});
+        }
+        t_rbtree tree = {};
+        rbtree_init(&tree);
+        bench_pattern("ascending", &tree, ops);
+        rbtree_destroy(&tree);
+    }
+
+    // 2. 两端交替插入
+    {
+        vector<t_adv_op> ops;
+        for (long long i = 0; i < n; ++i) {
+            ops.push_back({ADV_OP_INSERT, (USER_KEY_TYPE)(i % 2 == 0 ? i / 2 : n - i / 2)});
+        }
+        t_rbtree tree = {};
+        rbtree_init(&tree);
+        bench_pattern("sawtooth", &tree, ops);
+        rbtree_destroy(&tree);
+    }
+
+    // 3. 在最左侧的脊上反复删除最小值、插入新的最小值
+    {
+        vector<USER_KEY_TYPE> keys(n);
+        for (long long i = 0; i < n; ++i) {
+            keys[i] = (USER_KEY_TYPE)(i + n);
+        }
+        t_rbtree tree = {};
+        rbtree_init(&tree);
+        for (auto key : keys) {
+            rbtree_insert(&tree, key);
+        }
+
+        vector<t_adv_op> ops;
+        for (long long i = 0; i < n; ++i) {
+            ops.push_back({ADV_OP_ERASE, (USER_KEY_TYPE)(n + i)});
+            ops.push_back({ADV_OP_INSERT, (USER_KEY_TYPE)(n - 1 - i)});
+        }
+        bench_pattern("spine-churn", &tree, ops);
+        rbtree_destroy(&tree);
+    }
+
+    // 4. 全黑满二叉树上删除叶子再插回
+    {
+        vector<USER_KEY_TYPE> keys(n);
+        for (long long i = 0; i < n; ++i) {
+            keys[i] = (USER_KEY_TYPE)(i * 2);
+        }
+        t_rbtree tree = {};
+        tree.root = __rbtree_build(keys.data(), 0, n, 0, levels);
+        tree.size = n;
+
+        // 满二叉树中序第2j个key是第j个叶子
+        long long leaves = (n + 1) / 2;
+        vector<t_adv_op> ops;
+        for (long long j = 0; j < leaves; ++j) {
+            USER_KEY_TYPE key = keys[reverse_bits(j, levels - 1) * 2];
+            ops.push_back({ADV_OP_ERASE, key});
+            ops.push_back({ADV_OP_INSERT, key});
+        }
+        bench_pattern("black-leaf-erase", &tree, ops);
+        rbtree_destroy(&tree);
+    }
+
+    // 5. 随机插入删除作为对照
+    {
+        std::mt19937 rng(20260417);
+        vector<t_adv_op> ops;
+        for (long long i = 0; i < n; ++i) {
+            ops.push_back({ADV_OP_INSERT, (USER_KEY_TYPE)(rng() % (n * 2))});
+        }
+        for (long long i = 0; i < n; ++i) {
+            ops.push_back({(int)(rng() & 1), (USER_KEY_TYPE)(rng() % (n * 2))});
+        }
+        t_rbtree tree = {};
+        rbtree_init(&tree);
+        bench_pattern("random", &tree, ops);
+        rbtree_destroy(&tree);
+    }
+
+    return 0;
+}
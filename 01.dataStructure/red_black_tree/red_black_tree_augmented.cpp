@@ -0,0 +1,159 @@
+/**
+ * @file red_black_tree_augmented.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 带子树聚合值的红黑树的公共部分：旋转、插入调整和删除调整，聚合值的计算由包含本文件的文件提供
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+/*
+    merkle树、时间序列索引和分位数窗口都在每个节点上记录子树的聚合值（子树哈希，count/sum/min/max，样本权重）。
+它们的key类型和节点字段各不相同，不能直接使用red_black_tree_recursion.cpp中的t_rbtree_node，但旋转和两种调整的
+逻辑完全相同，唯一的差别是旋转之后要重新计算聚合值，因此把这部分放在这里，由各个文件#include进去。
+    包含本文件之前需要定义：
+    1. t_rbtree_node，至少包含color、left、right三个字段；
+    2. nil_node，以及RBTREE_CLR_RED、RBTREE_CLR_BLK、RBTREE_CLR_DBL；
+    3. 宏RBTREE_AUGMENT_UPDATE(node)：根据node的两个孩子重新计算node的聚合值，nil_node的聚合值应当是单位元。
+    插入和删除的递归（key的比较、重复key的处理、删除度为2的节点时要搬哪些字段）各个文件不同，留在各自的文件中，
+回溯时先调用RBTREE_AUGMENT_UPDATE再调用这里的调整函数。
+    red_black_tree_spill.cpp的删除调整中途要换入兄弟子树，red_black_tree_mvcc.cpp是路径复制，不在原地旋转，
+red_black_tree_shm.cpp的节点之间用偏移量而不是指针相连，这三个文件仍然各自实现调整。本文件不能单独编译。
+*/
+
+int has_red_child_node(t_rbtree_node *node) {
+    return node->left->color == RBTREE_CLR_RED || node->right->color == RBTREE_CLR_RED;
+}
+
+// 旋转不改变子树中的元素，只需要先更新下沉的节点，再更新上浮的节点
+t_rbtree_node *rbtree_left_rotate(t_rbtree_node *up) {
+    t_rbtree_node *down = up->right;
+    up->right = down->left;
+    down->left = up;
+
+    RBTREE_AUGMENT_UPDATE(up);
+    RBTREE_AUGMENT_UPDATE(down);
+    return down;
+}
+
+t_rbtree_node *rbtree_right_rotate(t_rbtree_node *up) {
+    t_rbtree_node *down = up->left;
+    up->left = down->right;
+    down->right = up;
+
+    RBTREE_AUGMENT_UPDATE(up);
+    RBTREE_AUGMENT_UPDATE(down);
+    return down;
+}
+
+// 插入调整与red_black_tree_recursion.cpp相同，改色不影响聚合值
+#define RBTREE_INSERT_CLT_NONE  0
+#define RBTREE_INSERT_CLT_LEFT  1
+#define RBTREE_INSERT_CLT_RIGHT 2
+t_rbtree_node *rbtree_insert_maintian(t_rbtree_node *root) {
+    if (!has_red_child_node(root))
+        return root;
+
+    if (root->left->color == RBTREE_CLR_RED && root->right->color == RBTREE_CLR_RED) {
+        root->color = RBTREE_CLR_RED;
+        root->left->color = root->right->color = RBTREE_CLR_BLK;
+
+        return root;
+    }
+
+    int has_red_conflict = RBTREE_INSERT_CLT_NONE;
+    if (root->left->color == RBTREE_CLR_RED && has_red_child_node(root->left)) {
+        has_red_conflict = RBTREE_INSERT_CLT_LEFT;
+    } else if (root->right->color == RBTREE_CLR_RED && has_red_child_node(root->right)) {
+        has_red_conflict = RBTREE_INSERT_CLT_RIGHT;
+    }
+
+    if (!has_red_conflict)
+        return root;
+
+    if (has_red_conflict == RBTREE_INSERT_CLT_LEFT) {
+        if (root->left->right->color == RBTREE_CLR_RED) {
+            root->left = rbtree_left_rotate(root->left);
+        }
+        root = rbtree_right_rotate(root);
+    } else {
+        if (root->right->left->color == RBTREE_CLR_RED) {
+            root->right = rbtree_right_rotate(root->right);
+        }
+        root = rbtree_left_rotate(root);
+    }
+
+    root->color = RBTREE_CLR_RED;
+    root->left->color = root->right->color = RBTREE_CLR_BLK;
+    return root;
+}
+
+// 删除调整与red_black_tree_recursion.cpp相同
+#define RBTREE_ERASE_CLT_NONE  0
+#define RBTREE_ERASE_CLT_LEFT  1
+#define RBTREE_ERASE_CLT_RIGHT 2
+t_rbtree_node *__rbtree_erase_maintain(t_rbtree_node *root) {
+    if (root->left->color != RBTREE_CLR_DBL && root->right->color != RBTREE_CLR_DBL) {
+        return root;
+    }
+
+    if (has_red_child_node(root)) {
+        int has_red_conflict = RBTREE_ERASE_CLT_NONE;
+        root->color = RBTREE_CLR_RED;
+        if (root->left->color == RBTREE_CLR_RED) {
+            root = rbtree_right_rotate(root);
+            has_red_conflict = RBTREE_ERASE_CLT_LEFT;
+        } else {
+            root = rbtree_left_rotate(root);
+            has_red_conflict = RBTREE_ERASE_CLT_RIGHT;
+        }
+        root->color = RBTREE_CLR_BLK;
+
+        // 递归调整只在子树内部旋转，不改变子树中的元素，root的聚合值不用重新计算
+        if (has_red_conflict == RBTREE_ERASE_CLT_LEFT) {
+            root->right = __rbtree_erase_maintain(root->right);
+        } else {
+            root->left = __rbtree_erase_maintain(root->left);
+        }
+
+        return root;
+    }
+
+    if ((root->left->color == RBTREE_CLR_DBL && !has_red_child_node(root->right)) ||
+        (root->right->color == RBTREE_CLR_DBL && !has_red_child_node(root->left))) {
+
+        root->left->color -= RBTREE_CLR_BLK;
+        root->right->color -= RBTREE_CLR_BLK;
+
+        root->color += RBTREE_CLR_BLK;
+        return root;
+    }
+
+    if (root->left->color == RBTREE_CLR_DBL) {
+        if (root->right->left->color == RBTREE_CLR_RED) {
+            root->right->color = RBTREE_CLR_RED;
+            root->right = rbtree_right_rotate(root->right);
+            root->right->color = RBTREE_CLR_BLK;
+        }
+
+        root->left->color -= RBTREE_CLR_BLK;
+        root = rbtree_left_rotate(root);
+        root->color = root->left->color;
+    } else {
+        if (root->left->right->color == RBTREE_CLR_RED) {
+            root->left->color = RBTREE_CLR_RED;
+            root->left = rbtree_left_rotate(root->left);
+            root->left->color = RBTREE_CLR_BLK;
+        }
+
+        root->right->color -= RBTREE_CLR_BLK;
+        root = rbtree_right_rotate(root);
+        root->color = root->right->color;
+    }
+
+    root->left->color = root->right->color = RBTREE_CLR_BLK;
+
+    return root;
+}
@@ -0,0 +1,260 @@
+/**
+ * @file red_black_tree_bgsave.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 仿照Redis BGSAVE，fork子进程在后台把红黑树写到磁盘，父进程继续处理写请求
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <random>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#define RBTREE_NO_MAIN
+#include "red_black_tree_recursion.cpp"
+
+using std::vector;
+
+/*
+    直接在当前进程中把整棵树写到磁盘，写的过程中树不能被修改，所有写请求都要阻塞到写完为止。
+    fork之后，子进程得到的是父进程在fork那一刻的内存快照：父子进程共享同一份物理页，页表被标记为只读，任何一方写某个
+页时，内核才为写的一方复制一份（写时复制，COW）。因此子进程看到的永远是fork那一刻的树，可以慢慢地遍历、写盘；父进程
+继续插入删除，代价只是第一次写某个页时的缺页中断和一次4K的拷贝。
+    需要注意的几点：
+    1. fork本身要复制整个页表，树越大fork越慢，这段时间父进程是完全阻塞的，所以要测量fork的耗时；
+    2. 子进程中只做遍历和写文件，不要调用可能持有锁的函数：fork时别的线程可能正持有malloc或stdio的锁，子进程中
+       这些锁永远不会被释放。因此子进程中不用stdio也不分配内存，只用open/write/fsync/rename这些系统调用，路径在
+       fork之前就准备好，结束时用_exit，避免执行父进程注册的atexit和析构；
+    3. 子进程中用固定大小的数组做显式栈迭代中序遍历，红黑树的高度不超过RBTREE_MAX_HEIGHT；
+    4. 先写到临时文件，写完fsync后再rename，rename之后再fsync所在的目录，保证磁盘上的快照要么是旧的，要么是完整
+       的新快照。
+    父进程在子进程运行期间的minor fault次数（getrusage中的ru_minflt）近似等于它触发的COW次数。
+*/
+
+#define RBTREE_SNAPSHOT_MAGIC "RBSNAP01"
+
+typedef struct rbtree_bgsave {
+    pid_t child;
+    double fork_us;                 // fork调用本身阻塞父进程的时间
+    long minflt_before;             // fork之后父进程的minor fault计数
+    std::chrono::steady_clock::time_point start;
+} t_rbtree_bgsave;
+
+static long current_minflt() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+// 把len个字节全部写出去，处理被信号打断和部分写的情况
+static int __write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(fd, data, len);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        data += written;
+        len -= written;
+    }
+
+    return 0;
+}
+
+// 子进程中执行：迭代中序遍历，把key写到文件中，成功返回0。只使用异步信号安全的系统调用
+static int __rbtree_dump(t_rbtree_node *root, const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return -1;
+
+    // 攒满一个大的缓冲区再write，减少系统调用的次数
+    static char buffer[1 << 20];
+    size_t used = 0;
+    std::memcpy(buffer, RBTREE_SNAPSHOT_MAGIC, 8);
+    used += 8;
+
+    t_rbtree_node *stack[RBTREE_MAX_HEIGHT];
+    int top = 0;
+    t_rbtree_node *cursor = root;
+    while (cursor != nil_node || top > 0) {
+        while (cursor != nil_node) {
+            stack[top++] = cursor;
+            cursor = cursor->left;
+        }
+
+        cursor = stack[--top];
+        if (used + sizeof(USER_KEY_TYPE) > sizeof(buffer)) {
+            if (__write_all(fd, buffer, used) != 0) {
+                close(fd);
+                return -1;
+            }
+            used = 0;
+        }
+        std::memcpy(buffer + used, &cursor->key, sizeof(USER_KEY_TYPE));
+        used += sizeof(USER_KEY_TYPE);
+        cursor = cursor->right;
+    }
+
+    if (__write_all(fd, buffer, used) != 0 || fsync(fd) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    return close(fd) == 0 ? 0 : -1;
+}
+
+// 子进程中执行：fsync目录，让rename本身也落盘
+static int __fsync_dir(const char *dir) {
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd < 0)
+        return -1;
+
+    int ret = fsync(fd);
+    close(fd);
+    return ret;
+}
+
+// 启动后台快照，成功返回0，父进程立即返回
+int rbtree_bgsave_start(t_rbtree *tree, const char *path, t_rbtree_bgsave *save) {
+    if (tree == nullptr || path == nullptr || save == nullptr)
+        return -1;
+
+    // 子进程中不能调用snprintf，临时文件和所在目录的路径在fork之前准备好
+    char tmp_path[4096];
+    char dir_path[4096];
+    if (std::snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path))
+        return -1;
+    const char *slash = std::strrchr(path, '/');
+    if (slash == nullptr) {
+        std::strcpy(dir_path, ".");
+    } else if (slash == path) {
+        std::strcpy(dir_path, "/");
+    } else {
+        std::snprintf(dir_path, sizeof(dir_path), "%.*s", (int)(slash - path), path);
+    }
+
+    // 子进程会继承stdio缓冲区中还没输出的内容，fork之前先刷掉，否则会输出两遍
+    std::fflush(nullptr);
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0)
+        return -2;
+
+    if (pid == 0) {
+        if (__rbtree_dump(tree->root, tmp_path) != 0 || rename(tmp_path, path) != 0) {
+            unlink(tmp_path);
+            _exit(1);
+        }
+        _exit(__fsync_dir(dir_path) == 0 ? 0 : 1);
+    }
+
+    save->child = pid;
+    save->start = start;
+    save->fork_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    save->minflt_before = current_minflt();
+    return 0;
+}
+
+// 查看后台快照是否结束，未结束返回1，成功返回0，失败返回负数；block为1时一直等到结束
+int rbtree_bgsave_poll(t_rbtree_bgsave *save, int block) {
+    if (save == nullptr || save->child <= 0)
+        return -1;
+
+    int status = 0;
+    pid_t pid = waitpid(save->child, &status, block ? 0 : WNOHANG);
+    if (pid == 0)
+        return 1;
+    if (pid < 0)
+        return -2;
+
+    save->child = 0;
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : -3;
+}
+
+// 从快照文件加载到树中，返回加载的key的个数，失败返回负数
+long long rbtree_load(t_rbtree *tree, const char *path) {
+    FILE *fp = std::fopen(path, "rb");
+    if (fp == nullptr)
+        return -1;
+
+    char magic[8];
+    if (std::fread(magic, 1, 8, fp) != 8 || std::memcmp(magic, RBTREE_SNAPSHOT_MAGIC, 8) != 0) {
+        std::fclose(fp);
+        return -2;
+    }
+
+    long long count = 0;
+    USER_KEY_TYPE key;
+    while (std::fread(&key, sizeof(key), 1, fp) == 1) {
+        rbtree_insert(tree, key);
+        ++count;
+    }
+    std::fclose(fp);
+
+    return count;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = argc > 1 ? argv[1] : "/tmp/rbtree.snapshot";
+    long long sizes[] = {100000, 1000000, 4000000};
+
+    std::printf("%10s %10s %10s %12s %12s %12s\n",
+                "nodes", "fork us", "save ms", "parent ops", "minflt", "loaded");
+    for (auto size : sizes) {
+        std::mt19937 rng(size);
+        t_rbtree tree = {};
+        rbtree_init(&tree);
+        for (long long i = 0; i < size; ++i) {
+            rbtree_insert(&tree, (int)(rng() % (size * 4)));
+        }
+
+        t_rbtree_bgsave save;
+        if (rbtree_bgsave_start(&tree, path, &save) != 0) {
+            std::perror("bgsave");
+            return 1;
+        }
+
+        // 子进程写盘期间，父进程继续随机写
+        long long parent_ops = 0;
+        int ret;
+        while ((ret = rbtree_bgsave_poll(&save, 0)) == 1) {
+            for (int i = 0; i < 1000; ++i) {
+                int key = (int)(rng() % (size * 4));
+                if (i & 1) {
+                    rbtree_insert(&tree, key);
+                } else {
+                    rbtree_erase(&tree, key);
+                }
+            }
+            parent_ops += 1000;
+        }
+        double save_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - save.start).count();
+        long minflt = current_minflt() - save.minflt_before;
+
+        t_rbtree loaded = {};
+        rbtree_init(&loaded);
+        long long count = ret == 0 ? rbtree_load(&loaded, path) : -1;
+        std::printf("%10lld %10.1f %10.1f %12lld %12ld %12lld\n",
+                    size, save.fork_us, save_ms, parent_ops, minflt, count);
+
+        rbtree_destroy(&loaded);
+        rbtree_destroy(&tree);
+    }
+
+    unlink(path);
+    return 0;
+}
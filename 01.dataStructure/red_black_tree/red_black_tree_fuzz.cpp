@@ -0,0 +1,384 @@
+/**
+ * @file red_black_tree_fuzz.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 红黑树与二叉搜索树的差分模糊测试：与std::set对比结果，并记录每个输入的吞吐量，把异常慢的输入保存下来
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <random>
+#include <set>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+// 红黑树和校验来自red_black_tree_validate.cpp（其中包含了red_black_tree_recursion.cpp），二叉搜索树来自binarySearchTree.cpp
+#define RBTREE_VALIDATE_NO_MAIN
+#include "red_black_tree_validate.cpp"
+#define BSTREE_NO_MAIN
+#include "binarySearchTree.cpp"
+
+using std::vector;
+
+/*
+    __rbtree_erase_maintain中双黑节点的处理分支很多，手写的用例很难覆盖所有的组合。这里把任意字节序列解释成一串操作，
+同时作用在t_rbtree、t_bstree和std::set上，以std::set为准对比结果：
+
+    1. 输入格式：每3个字节是一个操作，第1个字节的低2位是操作类型（0、1插入，2删除，3查找），后2个字节是小端的int16
+       key。key的取值范围小，随机输入中会有大量的重复插入、删除不存在的key等边界情况。每个输入最多FUZZ_MAX_OPS个操作。
+    2. 差分检查：每个操作之后检查该key在三者中是否同时存在；每FUZZ_CHECK_INTERVAL个操作以及结束时，再对比两棵树的
+       中序遍历和std::set的内容，并用rbtree_parallel_validate（串行模式）校验红黑树的所有性质，包括没有残留的双黑。
+       发现不一致时打印出错的位置并abort，libFuzzer会把当前输入保存为crash文件。
+    3. 吞吐量：差分检查本身是O(n)的，会淹没树操作的耗时，所以先单独把整串操作在空的红黑树和二叉搜索树上各执行
+       FUZZ_TIMING_RUNS遍并计时，取最短的一次作为每个输入在两种树上的ns/op（单次计时会被中断、缓存冷启动等噪声放大，
+       产生误报的慢输入），再做差分检查。
+       - 独立运行时，所有输入跑完后写出throughput.csv，并把红黑树ns/op超过中位数FUZZ_SLOW_FACTOR倍的输入复制为
+         slow-<hash>，作为需要跟踪的性能回归用例；
+       - libFuzzer模式下没有全局的中位数，使用固定的阈值FUZZ_SLOW_NS_PER_OP。
+       产物目录由环境变量RBTREE_FUZZ_ARTIFACTS指定，默认为当前目录。
+
+    编译方式：
+        独立运行：g++ -O2 red_black_tree_fuzz.cpp -pthread，参数是语料文件或目录，不给参数时使用内置的随机输入
+        libFuzzer：clang++ -O1 -g -fsanitize=fuzzer,address -DRBTREE_FUZZ_LIBFUZZER red_black_tree_fuzz.cpp -pthread
+*/
+
+#define FUZZ_MAX_OPS        4096
+#define FUZZ_CHECK_INTERVAL 64
+#define FUZZ_SLOW_FACTOR    8
+#define FUZZ_SLOW_NS_PER_OP 2000
+#define FUZZ_SLOW_MIN_OPS   256         // 操作太少时计时不准，不参与慢输入的判断
+#define FUZZ_TIMING_RUNS    5
+
+#define FUZZ_OP_INSERT 0
+#define FUZZ_OP_ERASE  2
+#define FUZZ_OP_FIND   3
+
+typedef struct fuzz_op {
+    int type;
+    USER_KEY_TYPE key;
+} t_fuzz_op;
+
+typedef struct fuzz_result {
+    long long ops;
+    double rbtree_ns_per_op;
+    double bstree_ns_per_op;
+} t_fuzz_result;
+
+static void fuzz_decode(const uint8_t *data, size_t size, vector<t_fuzz_op>& ops) {
+    ops.clear();
+    for (size_t i = 0; i + 3 <= size && ops.size() < FUZZ_MAX_OPS; i += 3) {
+        int type = data[i] & 3;
+        USER_KEY_TYPE key = (int16_t)(data[i + 1] | (data[i + 2] << 8));
+        ops.push_back({type == 1 ? FUZZ_OP_INSERT : type, key});
+    }
+}
+
+static uint64_t fuzz_hash(const uint8_t *data, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void fuzz_fail(const char *what, size_t index, const t_fuzz_op& op) {
+    std::fprintf(stderr, "fuzz mismatch: %s at op #%zu (type %d, key %d)\n", what, index, op.type, op.key);
+    std::abort();
+}
+
+static void fuzz_check_contents(t_rbtree *rbtree, t_bstree *bstree, const std::set<int>& model,
+                                size_t index, const t_fuzz_op& op) {
+    vector<int> expected(model.begin(), model.end());
+    if (rbtree->size != (long long)model.size())
+        fuzz_fail("rbtree size", index, op);
+
+    vector<int> keys(rbtree->size);
+    rbtree_inorder_copy(rbtree, keys.data(), rbtree->size);
+    if (keys != expected)
+        fuzz_fail("rbtree contents", index, op);
+
+    if (bstree->size != (long long)model.size())
+        fuzz_fail("bstree size", index, op);
+
+    keys.clear();
+    inorder_traversal(bstree->root, keys);
+    if (keys != expected)
+        fuzz_fail("bstree contents", index, op);
+
+    t_rbtree_violation violation;
+    if (rbtree_parallel_validate(nullptr, rbtree, &violation) < 0)
+        fuzz_fail(rbtree_violation_name(violation.kind), index, op);
+}
+
+// 查找的结果写到这里，避免计时的循环被编译器优化掉
+static volatile long long fuzz_sink;
+
+// 在空的红黑树上执行一遍整串操作，返回耗时（ns）
+static double fuzz_time_rbtree(const vector<t_fuzz_op>& ops) {
+    t_rbtree rbtree = {};
+    rbtree_init(&rbtree);
+    long long found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (auto& op : ops) {
+        if (op.type == FUZZ_OP_INSERT) {
+            rbtree_insert(&rbtree, op.key);
+        } else if (op.type == FUZZ_OP_ERASE) {
+            rbtree_erase(&rbtree, op.key);
+        } else {
+            found += rbtree_find(&rbtree, op.key) != nullptr;
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    rbtree_destroy(&rbtree);
+
+    fuzz_sink = found;
+    return ns;
+}
+
+// 在空的二叉搜索树上执行一遍整串操作，返回耗时（ns）
+static double fuzz_time_bstree(const vector<t_fuzz_op>& ops) {
+    t_bstree bstree;
+    bstree_init(&bstree);
+    long long found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (auto& op : ops) {
+        if (op.type == FUZZ_OP_INSERT) {
+            insert_node_to_bstree(&bstree, op.key);
+        } else if (op.type == FUZZ_OP_ERASE) {
+            erase_node_from_bstree(&bstree, op.key);
+        } else {
+            found += find_node_in_bstree(&bstree, op.key) != nullptr;
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    destroy_bstree(&bstree);
+
+    fuzz_sink = found;
+    return ns;
+}
+
+// 对整串操作在两种树上分别计时，各取FUZZ_TIMING_RUNS次中最短的一次
+static void fuzz_measure(const vector<t_fuzz_op>& ops, t_fuzz_result *result) {
+    double rbtree_ns = fuzz_time_rbtree(ops);
+    double bstree_ns = fuzz_time_bstree(ops);
+    for (int run = 1; run < FUZZ_TIMING_RUNS; ++run) {
+        rbtree_ns = std::min(rbtree_ns, fuzz_time_rbtree(ops));
+        bstree_ns = std::min(bstree_ns, fuzz_time_bstree(ops));
+    }
+
+    long long count = std::max<long long>(1, ops.size());
+    result->ops = ops.size();
+    result->rbtree_ns_per_op = rbtree_ns / count;
+    result->bstree_ns_per_op = bstree_ns / count;
+}
+
+// 差分检查一个输入，不一致时abort
+static void fuzz_one(const uint8_t *data, size_t size, t_fuzz_result *result) {
+    vector<t_fuzz_op> ops;
+    fuzz_decode(data, size, ops);
+    fuzz_measure(ops, result);
+
+    t_rbtree rbtree = {};
+    rbtree_init(&rbtree);
+    t_bstree bstree;
+    bstree_init(&bstree);
+    std::set<int> model;
+    for (size_t i = 0; i < ops.size(); ++i) {
+        const t_fuzz_op& op = ops[i];
+        if (op.type == FUZZ_OP_INSERT) {
+            rbtree_insert(&rbtree, op.key);
+            int inserted = model.insert(op.key).second;
+            if (insert_node_to_bstree(&bstree, op.key) != (inserted ? 0 : 1))
+                fuzz_fail("bstree insert result", i, op);
+        } else if (op.type == FUZZ_OP_ERASE) {
+            rbtree_erase(&rbtree, op.key);
+            int erased = model.erase(op.key) == 1;
+            if (erase_node_from_bstree(&bstree, op.key) != (erased ? 0 : 1))
+                fuzz_fail("bstree erase result", i, op);
+        }
+
+        int expected = model.count(op.key) == 1;
+        if ((rbtree_find(&rbtree, op.key) != nullptr) != expected)
+            fuzz_fail("rbtree find", i, op);
+        if ((find_node_in_bstree(&bstree, op.key) != nullptr) != expected)
+            fuzz_fail("bstree find", i, op);
+        if ((i + 1) % FUZZ_CHECK_INTERVAL == 0 || i + 1 == ops.size())
+            fuzz_check_contents(&rbtree, &bstree, model, i, op);
+    }
+
+    rbtree_destroy(&rbtree);
+    destroy_bstree(&bstree);
+}
+
+static std::string fuzz_artifact_dir() {
+    const char *dir = std::getenv("RBTREE_FUZZ_ARTIFACTS");
+    return dir != nullptr && *dir != '\0' ? dir : ".";
+}
+
+// 把慢输入保存为<dir>/slow-<hash>，返回文件名
+static std::string fuzz_save_slow(const uint8_t *data, size_t size) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "slow-%016llx", (unsigned long long)fuzz_hash(data, size));
+    std::string path = fuzz_artifact_dir() + "/" + name;
+    FILE *file = std::fopen(path.c_str(), "wb");
+    if (file != nullptr) {
+        std::fwrite(data, 1, size, file);
+        std::fclose(file);
+    }
+    return path;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    t_fuzz_result result;
+    fuzz_one(data, size, &result);
+    if (result.ops >= FUZZ_SLOW_MIN_OPS && result.rbtree_ns_per_op > FUZZ_SLOW_NS_PER_OP) {
+        std::string path = fuzz_save_slow(data, size);
+        std::fprintf(stderr, "slow input: %.0f ns/op over %lld ops, saved to %s\n",
+                     result.rbtree_ns_per_op, result.ops, path.c_str());
+    }
+    return 0;
+}
+
+// libFuzzer自带main，独立运行时使用下面的main
+#ifndef RBTREE_FUZZ_LIBFUZZER
+typedef struct fuzz_entry {
+    std::string name;
+    vector<uint8_t> data;
+    t_fuzz_result result;
+} t_fuzz_entry;
+
+static int fuzz_load_file(const std::string& path, vector<t_fuzz_entry>& entries) {
+    FILE *file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr)
+        return -1;
+
+    t_fuzz_entry entry;
+    entry.name = path;
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        entry.data.insert(entry.data.end(), buffer, buffer + n);
+    }
+    std::fclose(file);
+    entries.push_back(std::move(entry));
+    return 0;
+}
+
+static int fuzz_load_path(const std::string& path, vector<t_fuzz_entry>& entries) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return -1;
+    if (!S_ISDIR(info.st_mode))
+        return fuzz_load_file(path, entries);
+
+    DIR *dir = opendir(path.c_str());
+    if (dir == nullptr)
+        return -1;
+
+    vector<std::string> names;
+    struct dirent *item;
+    while ((item = readdir(dir)) != nullptr) {
+        if (item->d_name[0] != '.') {
+            names.push_back(item->d_name);
+        }
+    }
+    closedir(dir);
+
+    std::sort(names.begin(), names.end());
+    for (auto& name : names) {
+        fuzz_load_path(path + "/" + name, entries);
+    }
+    return 0;
+}
+
+// 没有语料时生成的随机输入：小值域（大量重复）、大值域、以及对二叉搜索树最不友好的递增序列
+static void fuzz_generate(vector<t_fuzz_entry>& entries, int count) {
+    std::mt19937 rng(20260417);
+    for (int i = 0; i < count; ++i) {
+        t_fuzz_entry entry;
+        entry.name = "random-" + std::to_string(i);
+        int ops = 1 + (int)(rng() % FUZZ_MAX_OPS);
+        int mode = i % 4;
+        int range = (mode == 0 ? 16 : mode == 1 ? 512 : 65536);
+        for (int j = 0; j < ops; ++j) {
+            int key = (mode == 3 ? j * 3 : (int)(rng() % range) - range / 2);
+            entry.data.push_back((uint8_t)(mode == 3 ? 0 : rng()));
+            entry.data.push_back((uint8_t)(key & 0xff));
+            entry.data.push_back((uint8_t)((key >> 8) & 0xff));
+        }
+        entries.push_back(std::move(entry));
+    }
+}
+
+int main(int argc, char *argv[]) {
+    vector<t_fuzz_entry> entries;
+    for (int i = 1; i < argc; ++i) {
+        if (fuzz_load_path(argv[i], entries) != 0) {
+            std::fprintf(stderr, "cannot read %s\n", argv[i]);
+        }
+    }
+    if (argc == 1) {
+        fuzz_generate(entries, 2000);
+    }
+
+    long long total_ops = 0;
+    vector<double> rbtree_costs;
+    for (auto& entry : entries) {
+        fuzz_one(entry.data.data(), entry.data.size(), &entry.result);
+        total_ops += entry.result.ops;
+        if (entry.result.ops >= FUZZ_SLOW_MIN_OPS) {
+            rbtree_costs.push_back(entry.result.rbtree_ns_per_op);
+        }
+    }
+
+    std::sort(rbtree_costs.begin(), rbtree_costs.end());
+    double median = rbtree_costs.empty() ? 0 : rbtree_costs[rbtree_costs.size() / 2];
+
+    std::string report = fuzz_artifact_dir() + "/throughput.csv";
+    FILE *csv = std::fopen(report.c_str(), "w");
+    if (csv != nullptr) {
+        std::fprintf(csv, "entry,ops,rbtree_ops_per_sec,bstree_ops_per_sec\n");
+    }
+
+    int slow = 0;
+    const t_fuzz_entry *worst_bstree = nullptr;
+    for (auto& entry : entries) {
+        const t_fuzz_result& result = entry.result;
+        if (csv != nullptr) {
+            std::fprintf(csv, "%s,%lld,%.0f,%.0f\n", entry.name.c_str(), result.ops,
+                         result.rbtree_ns_per_op > 0 ? 1e9 / result.rbtree_ns_per_op : 0.0,
+                         result.bstree_ns_per_op > 0 ? 1e9 / result.bstree_ns_per_op : 0.0);
+        }
+        if (result.ops >= FUZZ_SLOW_MIN_OPS && result.rbtree_ns_per_op > median * FUZZ_SLOW_FACTOR) {
+            std::string path = fuzz_save_slow(entry.data.data(), entry.data.size());
+            std::printf("slow input %s: %.0f ns/op (median %.0f), saved to %s\n",
+                        entry.name.c_str(), result.rbtree_ns_per_op, median, path.c_str());
+            ++slow;
+        }
+        if (worst_bstree == nullptr || result.bstree_ns_per_op > worst_bstree->result.bstree_ns_per_op) {
+            worst_bstree = &entry;
+        }
+    }
+    if (csv != nullptr) {
+        std::fclose(csv);
+    }
+
+    std::printf("%zu inputs, %lld ops, all consistent with std::set\n", entries.size(), total_ops);
+    std::printf("rbtree median %.0f ns/op, %d slow inputs; report written to %s\n", median, slow, report.c_str());
+    if (worst_bstree != nullptr) {
+        std::printf("worst bstree input %s: %.0f ns/op (rbtree %.0f ns/op)\n", worst_bstree->name.c_str(),
+                    worst_bstree->result.bstree_ns_per_op, worst_bstree->result.rbtree_ns_per_op);
+    }
+    return 0;
+}
+#endif
@@ -0,0 +1,259 @@
+/**
+ * @file red_black_tree_hugepage.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 使用大页（2MB）作为红黑树节点内存池，并对比4K页与2M页下的随机查找性能
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sys/mman.h>
+#include <vector>
+
+#define RBTREE_NO_MAIN
+#include "red_black_tree_recursion.cpp"
+
+using std::vector;
+
+/*
+    上亿个节点的红黑树，随机查找时每一层访问的节点都散落在不同的4K页上，页表项远远超出了TLB的容量，几乎每访问一个节点
+都伴随着一次TLB miss和页表遍历。换成2MB的大页以后，同样大小的内存需要的页表项是原来的1/512，TLB的覆盖范围大得多。
+
+    节点内存池以slab为单位向内核申请内存，每个slab是2MB的整数倍并按2MB对齐，节点在slab中顺序切分，释放的节点挂到空闲
+链表上复用。申请slab时按以下顺序尝试，失败了就退到下一种：
+    1. mmap + MAP_HUGETLB：使用预留的hugetlbfs大页（需要事先配置vm.nr_hugepages）；
+    2. mmap + madvise(MADV_HUGEPAGE)：使用透明大页（THP），需要/sys/kernel/mm/transparent_hugepage/enabled
+       为always或madvise；
+    3. 普通的4K页。
+    为了做对比，也可以指定NODE_ARENA_PAGE_4K，此时用madvise(MADV_NOHUGEPAGE)明确禁止透明大页。
+*/
+
+#define NODE_ARENA_PAGE_4K   0
+#define NODE_ARENA_PAGE_HUGE 1
+
+#define NODE_ARENA_HUGE_PAGE_SIZE (2UL << 20)
+#define NODE_ARENA_SLAB_SIZE      (64UL << 20)
+
+// 节点在slab中紧挨着切分，没有块头和对齐填充，使用内存池时rbtree_node_footprint应当设置为该值
+#define NODE_ARENA_FOOTPRINT sizeof(t_rbtree_node)
+
+// 每个slab实际拿到的页的类型
+#define NODE_ARENA_BACKING_4K      0
+#define NODE_ARENA_BACKING_THP     1
+#define NODE_ARENA_BACKING_HUGETLB 2
+
+typedef struct node_arena_slab {
+    void *base;             // mmap返回的地址，munmap时使用
+    size_t length;
+    int backing;
+} t_node_arena_slab;
+
+// 空闲链表直接复用节点本身的内存
+typedef struct node_arena_free {
+    struct node_arena_free *next;
+} t_node_arena_free;
+
+typedef struct node_arena {
+    int page_mode;
+    vector<t_node_arena_slab> slabs;
+    char *cursor;           // 当前slab中下一个可用的位置
+    char *limit;
+    t_node_arena_free *free_list;
+} t_node_arena;
+
+// rbtree_node_alloc/rbtree_node_free没有上下文参数，内存池只能是全局的
+static t_node_arena g_node_arena;
+
+// 映射一块按2MB对齐的匿名内存：多映射2MB，再把前后多余的部分还给内核
+static void *__arena_map_aligned(size_t length) {
+    size_t reserve = length + NODE_ARENA_HUGE_PAGE_SIZE;
+    char *raw = (char *)mmap(nullptr, reserve, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+        return nullptr;
+
+    uintptr_t aligned = ((uintptr_t)raw + NODE_ARENA_HUGE_PAGE_SIZE - 1) & ~(NODE_ARENA_HUGE_PAGE_SIZE - 1);
+    size_t head = aligned - (uintptr_t)raw;
+    size_t tail = reserve - head - length;
+    if (head) {
+        munmap(raw, head);
+    }
+    if (tail) {
+        munmap((char *)aligned + length, tail);
+    }
+
+    return (void *)aligned;
+}
+
+static int __arena_add_slab(t_node_arena *arena) {
+    t_node_arena_slab slab = {nullptr, NODE_ARENA_SLAB_SIZE, NODE_ARENA_BACKING_4K};
+
+    if (arena->page_mode == NODE_ARENA_PAGE_HUGE) {
+        void *base = mmap(nullptr, slab.length, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base != MAP_FAILED) {
+            slab.base = base;
+            slab.backing = NODE_ARENA_BACKING_HUGETLB;
+        }
+    }
+
+    if (slab.base == nullptr) {
+        slab.base = __arena_map_aligned(slab.length);
+        if (slab.base == nullptr)
+            return -1;
+
+        if (arena->page_mode == NODE_ARENA_PAGE_HUGE) {
+            // 内核不支持THP时madvise会失败，此时退化为4K页，不影响正确性
+            if (madvise(slab.base, slab.length, MADV_HUGEPAGE) == 0) {
+                slab.backing = NODE_ARENA_BACKING_THP;
+            }
+        } else {
+            madvise(slab.base, slab.length, MADV_NOHUGEPAGE);
+        }
+    }
+
+    arena->slabs.push_back(slab);
+    arena->cursor = (char *)slab.base;
+    arena->limit = arena->cursor + slab.length;
+    return 0;
+}
+
+void node_arena_init(t_node_arena *arena, int page_mode) {
+    arena->page_mode = page_mode;
+    arena->slabs.clear();
+    arena->cursor = arena->limit = nullptr;
+    arena->free_list = nullptr;
+}
+
+// 内存池向内核申请的总字节数。释放的节点留在空闲链表中，不会还给内核，所以它不小于树的rbtree_memory_usage
+size_t node_arena_memory_usage(t_node_arena *arena) {
+    size_t bytes = 0;
+    for (auto& slab : arena->slabs) {
+        bytes += slab.length;
+    }
+    return bytes;
+}
+
+// 释放内存池中的所有slab，调用之后之前分配的所有节点都失效
+void node_arena_destroy(t_node_arena *arena) {
+    for (auto& slab : arena->slabs) {
+        munmap(slab.base, slab.length);
+    }
+    node_arena_init(arena, arena->page_mode);
+}
+
+t_rbtree_node *node_arena_alloc() {
+    t_node_arena *arena = &g_node_arena;
+    if (arena->free_list) {
+        t_node_arena_free *node = arena->free_list;
+        arena->free_list = node->next;
+        return (t_rbtree_node *)node;
+    }
+
+    if (arena->cursor + sizeof(t_rbtree_node) > arena->limit && __arena_add_slab(arena) != 0)
+        return nullptr;
+
+    t_rbtree_node *node = (t_rbtree_node *)arena->cursor;
+    arena->cursor += sizeof(t_rbtree_node);
+    return node;
+}
+
+void node_arena_free(t_rbtree_node *node) {
+    t_node_arena_free *entry = (t_node_arena_free *)node;
+    entry->next = g_node_arena.free_list;
+    g_node_arena.free_list = entry;
+}
+
+// 其他文件可以直接#include本文件来复用节点内存池，此时先定义RBTREE_HUGEPAGE_NO_MAIN去掉下面的示例
+#ifndef RBTREE_HUGEPAGE_NO_MAIN
+static const char *node_arena_backing_names[] = {"4K", "THP", "hugetlb"};
+
+// 读取/proc/self/smaps_rollup中由透明大页支撑的匿名内存大小，单位KB，读取失败返回-1
+static long long anon_huge_pages_kb() {
+    FILE *fp = std::fopen("/proc/self/smaps_rollup", "r");
+    if (fp == nullptr)
+        return -1;
+
+    char line[256];
+    long long kb = -1;
+    while (std::fgets(line, sizeof(line), fp)) {
+        if (std::sscanf(line, "AnonHugePages: %lld kB", &kb) == 1)
+            break;
+    }
+    std::fclose(fp);
+
+    return kb;
+}
+
+int main(int argc, char *argv[]) {
+    long long count = argc > 1 ? std::atoll(argv[1]) : (1LL << 22);
+    long long lookups = argc > 2 ? std::atoll(argv[2]) : (1LL << 22);
+
+    rbtree_node_alloc = node_arena_alloc;
+    rbtree_node_free = node_arena_free;
+    rbtree_node_footprint = NODE_ARENA_FOOTPRINT;
+
+    std::mt19937_64 rng(20260417);
+    vector<int> keys(count);
+    for (long long i = 0; i < count; ++i) {
+        keys[i] = (int)(i * 2);
+    }
+    std::shuffle(keys.begin(), keys.end(), rng);
+
+    vector<int> workload(lookups);
+    for (long long i = 0; i < lookups; ++i) {
+        workload[i] = keys[rng() % count];
+    }
+
+    std::printf("%lld nodes (%zu bytes each), %lld random lookups\n", count, sizeof(t_rbtree_node), lookups);
+    std::printf("%8s %10s %14s %16s %10s %10s\n", "mode", "backing", "ns/lookup", "AnonHugePages", "tree MB", "arena MB");
+    int modes[] = {NODE_ARENA_PAGE_4K, NODE_ARENA_PAGE_HUGE};
+    for (auto mode : modes) {
+        node_arena_init(&g_node_arena, mode);
+        t_rbtree tree = {};
+        rbtree_init(&tree);
+        int oom = 0;
+        for (auto key : keys) {
+            if (rbtree_insert(&tree, key) == -2) {
+                oom = 1;
+                break;
+            }
+        }
+        if (oom) {
+            std::printf("%8s: node arena out of memory after %lld nodes\n",
+                        mode == NODE_ARENA_PAGE_4K ? "4K" : "2M", rbtree_size(&tree));
+            node_arena_destroy(&g_node_arena);
+            continue;
+        }
+
+        long long hits = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (auto key : workload) {
+            hits += rbtree_find(&tree, key) != nullptr;
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if (hits != lookups) {
+            std::printf("unexpected misses: %lld\n", lookups - hits);
+        }
+
+        std::printf("%8s %10s %14.1f %13lld kB %10.1f %10.1f\n",
+                    mode == NODE_ARENA_PAGE_4K ? "4K" : "2M",
+                    node_arena_backing_names[g_node_arena.slabs.empty() ? 0 : g_node_arena.slabs[0].backing],
+                    ns / lookups, anon_huge_pages_kb(), rbtree_memory_usage(&tree) / 1048576.0,
+                    node_arena_memory_usage(&g_node_arena) / 1048576.0);
+
+        // 所有节点都在内存池中，直接整体释放，不需要逐个delete
+        node_arena_destroy(&g_node_arena);
+    }
+
+    return 0;
+}
+#endif
@@ -0,0 +1,509 @@
+/**
+ * @file red_black_tree_merkle.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 带子树哈希的红黑树：两个副本只交换O(d log n)个哈希就能找出不一致的key区间
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using std::vector;
+
+typedef int USER_KEY_TYPE;
+
+#define RBTREE_CLR_RED 0
+#define RBTREE_CLR_BLK 1
+#define RBTREE_CLR_DBL 2
+
+/*
+    反熵（anti-entropy）同步：两个副本的数据大部分相同，只有d个key不一致，要找出这些key而不传输整棵树。
+
+    1. 子树哈希：经典的Merkle树对子树的形状敏感，而两个副本插入删除的顺序不同，同样的key集合得到的红黑树形状也不同，
+       子树哈希无法直接比较。这里使用与形状无关的哈希：子树哈希 = 子树中所有key的H(key)之和（模2^64），再加上子树的
+       节点个数。求和满足交换律和结合律，同样的key集合无论树长什么样，哈希都相同；旋转只是重新分组，旋转后重新计算
+       上下两个节点即可，与size域的维护方式完全一样。
+    2. 区间哈希：有了子树和，任意区间[lo, hi)内的key的哈希和个数都可以像区间求和一样，用两次从根到叶子的查找在
+       O(log n)内算出来，不要求两个副本的树形状相同。
+    3. 对比：本地先比较整个key空间的区间哈希，相同就结束；不同时按本地区间内的中位数（通过size做O(log n)的按排名查找）
+       把区间一分为二，分别递归。某一侧区间内的key足够少时，不再细分，直接把这个区间报告为不一致的区间，由调用者交换
+       区间内的key。每个不一致的key最多让O(log n)层的区间哈希不同，因此总共交换O(d log n)个哈希。
+
+    对比算法只依赖“对端某个区间的哈希”这一个查询，对端可以是本地的另一棵树，也可以是通过Unix socket连接的另一个进程。
+*/
+
+typedef struct rbtree_node {
+    USER_KEY_TYPE key;
+    int color;
+    struct rbtree_node *left;
+    struct rbtree_node *right;
+    uint32_t size;          // 子树中的节点个数
+    uint64_t hash;          // 子树中所有key的H(key)之和
+} t_rbtree_node;
+
+typedef struct rbtree {
+    t_rbtree_node *root;
+} t_rbtree;
+
+// 区间[lo, hi)的摘要，key是int，区间端点用long long才能表示INT_MAX + 1
+typedef struct merkle_summary {
+    uint64_t hash;
+    uint32_t count;
+} t_merkle_summary;
+
+typedef struct merkle_range {
+    long long lo;
+    long long hi;
+} t_merkle_range;
+
+#define MERKLE_KEY_MIN ((long long)INT_MIN)
+#define MERKLE_KEY_END ((long long)INT_MAX + 1)
+
+t_rbtree_node __nil_node;
+
+#define nil_node (&__nil_node)
+
+__attribute__((constructor))
+void init_nil_node() {
+     __nil_node.key = 0;
+     __nil_node.color = RBTREE_CLR_BLK;
+     __nil_node.left = __nil_node.right = nil_node;
+     __nil_node.size = 0;
+     __nil_node.hash = 0;
+}
+
+// splitmix64的终结函数，把相邻的key打散到整个64位空间
+static uint64_t merkle_key_hash(USER_KEY_TYPE key) {
+    uint64_t x = (uint64_t)(uint32_t)key + 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// 根据两个孩子重新计算节点的size和hash
+static void __merkle_update(t_rbtree_node *node) {
+    node->size = node->left->size + node->right->size + 1;
+    node->hash = node->left->hash + node->right->hash + merkle_key_hash(node->key);
+}
+
+t_rbtree_node *rbtree_create_node(USER_KEY_TYPE key) {
+    t_rbtree_node *node = new t_rbtree_node;
+    node->key = key;
+    node->color = RBTREE_CLR_RED;
+    node->left = node->right = nil_node;
+    __merkle_update(node);
+
+    return node;
+}
+
+void __rbtree_destroy(t_rbtree_node *root) {
+    if (root == nil_node)
+        return;
+
+    __rbtree_destroy(root->left);
+    __rbtree_destroy(root->right);
+    delete root;
+}
+
+void rbtree_destroy(t_rbtree *tree) {
+    if (tree == nullptr)
+        return;
+
+    __rbtree_destroy(tree->root);
+    tree->root = nil_node;
+}
+
+// 旋转和插入、删除调整来自red_black_tree_augmented.cpp，旋转之后用__merkle_update重新计算子树的size和hash
+#define RBTREE_AUGMENT_UPDATE(node) __merkle_update(node)
+#include "red_black_tree_augmented.cpp"
+
+t_rbtree_node *__rbtree_insert(t_rbtree_node *root, USER_KEY_TYPE key) {
+    if (root == nil_node)
+        return rbtree_create_node(key);
+
+    if (root->key == key)
+        return root;
+
+    if (key < root->key) {
+        root->left = __rbtree_insert(root->left, key);
+    } else {
+        root->right = __rbtree_insert(root->right, key);
+    }
+
+    // 孩子的子树变了，先更新当前节点，再做插入调整
+    __merkle_update(root);
+    return rbtree_insert_maintian(root);
+}
+
+void rbtree_insert(t_rbtree *tree, USER_KEY_TYPE key) {
+    if (tree == nullptr)
+        return;
+
+    tree->root = __rbtree_insert(tree->root, key);
+    tree->root->color = RBTREE_CLR_BLK;
+}
+
+t_rbtree_node *__rbtree_erase(t_rbtree_node *root, USER_KEY_TYPE key) {
+    if (root == nil_node)
+        return nil_node;
+
+    if (key < root->key) {
+        root->left = __rbtree_erase(root->left, key);
+    } else if (key > root->key) {
+        root->right = __rbtree_erase(root->right, key);
+    } else {
+        if (root->left == nil_node || root->right == nil_node) {
+            t_rbtree_node *child = (root->left != nil_node ? root->left : root->right);
+            child->color += root->color;
+            delete root;
+
+            return child;
+        }
+
+        t_rbtree_node *prev_node = root->left;
+        while (prev_node->right != nil_node) {
+            prev_node = prev_node->right;
+        }
+        root->key = prev_node->key;
+        root->left = __rbtree_erase(root->left, prev_node->key);
+    }
+
+    __merkle_update(root);
+    return __rbtree_erase_maintain(root);
+}
+
+void rbtree_erase(t_rbtree *tree, USER_KEY_TYPE key) {
+    if (tree == nullptr)
+        return;
+
+    tree->root = __rbtree_erase(tree->root, key);
+    tree->root->color = RBTREE_CLR_BLK;
+}
+
+/* ------------------------------ 区间哈希与对比 ------------------------------ */
+
+// 所有小于bound的key的摘要
+static t_merkle_summary __merkle_prefix(t_rbtree_node *root, long long bound) {
+    t_merkle_summary summary = {0, 0};
+    while (root != nil_node) {
+        if (root->key < bound) {
+            summary.hash += root->left->hash + merkle_key_hash(root->key);
+            summary.count += root->left->size + 1;
+            root = root->right;
+        } else {
+            root = root->left;
+        }
+    }
+
+    return summary;
+}
+
+// 区间[lo, hi)内所有key的摘要，O(log n)
+t_merkle_summary merkle_range_summary(t_rbtree *tree, long long lo, long long hi) {
+    t_merkle_summary high = __merkle_prefix(tree->root, hi);
+    t_merkle_summary low = __merkle_prefix(tree->root, lo);
+    return {high.hash - low.hash, high.count - low.count};
+}
+
+// 按排名查找：返回中序遍历中下标为rank（从0开始）的key，调用者保证rank小于树的节点数
+static USER_KEY_TYPE __merkle_select(t_rbtree_node *root, uint32_t rank) {
+    while (root->left->size != rank) {
+        if (rank < root->left->size) {
+            root = root->left;
+        } else {
+            rank -= root->left->size + 1;
+            root = root->right;
+        }
+    }
+
+    return root->key;
+}
+
+// 把区间[lo, hi)内的key按顺序追加到result中
+void merkle_range_keys(t_rbtree_node *root, long long lo, long long hi, vector<int>& result) {
+    if (root == nil_node)
+        return;
+
+    if (lo < root->key) {
+        merkle_range_keys(root->left, lo, hi, result);
+    }
+    if (lo <= root->key && root->key < hi) {
+        result.push_back(root->key);
+    }
+    if (root->key + 1LL < hi) {
+        merkle_range_keys(root->right, lo, hi, result);
+    }
+}
+
+// 对端：给出区间，把对端树中该区间的摘要写到summary中，成功返回0，与对端通信失败返回-1
+typedef struct merkle_peer {
+    int (*summary)(void *ctx, long long lo, long long hi, t_merkle_summary *summary);
+    void *ctx;
+    long long exchanged;    // 向对端查询的区间哈希个数
+} t_merkle_peer;
+
+// 区间内key的个数不超过该值时不再细分
+#define MERKLE_LEAF_KEYS 16
+
+// 与对端通信失败时返回-1，不再继续细分
+static int __merkle_diff(t_rbtree *local, t_merkle_peer *peer, long long lo, long long hi,
+                         vector<t_merkle_range>& ranges) {
+    t_merkle_summary mine = merkle_range_summary(local, lo, hi);
+    t_merkle_summary theirs;
+    if (peer->summary(peer->ctx, lo, hi, &theirs) != 0)
+        return -1;
+
+    peer->exchanged++;
+    if (mine.hash == theirs.hash && mine.count == theirs.count)
+        return 0;
+
+    if (mine.count <= MERKLE_LEAF_KEYS || theirs.count <= MERKLE_LEAF_KEYS) {
+        // 相邻的不一致区间合并成一个
+        if (!ranges.empty() && ranges.back().hi == lo) {
+            ranges.back().hi = hi;
+        } else {
+            ranges.push_back({lo, hi});
+        }
+        return 0;
+    }
+
+    // 按本地区间内的中位数切分，两半各有本地一半的key，递归深度为O(log n)
+    uint32_t rank = __merkle_prefix(local->root, lo).count + mine.count / 2;
+    long long middle = __merkle_select(local->root, rank);
+    if (__merkle_diff(local, peer, lo, middle, ranges) != 0)
+        return -1;
+
+    return __merkle_diff(local, peer, middle, hi, ranges);
+}
+
+/*
+    找出本地树与对端树中key集合不同的区间，按key的顺序输出到ranges中。两棵树在ranges以外的区间中key完全相同。
+    返回与对端交换的区间哈希个数，与对端通信失败返回-2，此时ranges不完整。
+*/
+long long merkle_diff(t_rbtree *local, t_merkle_peer *peer, vector<t_merkle_range>& ranges) {
+    if (local == nullptr || peer == nullptr)
+        return -1;
+
+    peer->exchanged = 0;
+    if (__merkle_diff(local, peer, MERKLE_KEY_MIN, MERKLE_KEY_END, ranges) != 0)
+        return -2;
+
+    return peer->exchanged;
+}
+
+// 对端就是本地的另一棵树
+static int local_peer_summary(void *ctx, long long lo, long long hi, t_merkle_summary *summary) {
+    *summary = merkle_range_summary((t_rbtree *)ctx, lo, hi);
+    return 0;
+}
+
+/* ------------------------- 通过Unix socket同步两个进程 ------------------------- */
+
+#define MERKLE_REQ_SUMMARY 1
+#define MERKLE_REQ_KEYS    2
+#define MERKLE_REQ_QUIT    3
+
+typedef struct merkle_request {
+    int type;
+    long long lo;
+    long long hi;
+} t_merkle_request;
+
+static int read_full(int fd, void *buf, size_t len) {
+    char *p = (char *)buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n <= 0)
+            return -1;
+
+        p += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+// 对端关闭了连接时不能被SIGPIPE杀掉，而是返回-1
+static int write_full(int fd, const void *buf, size_t len) {
+    const char *p = (const char *)buf;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0)
+            return -1;
+
+        p += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+// 服务端进程：回答对端的区间哈希和区间key的查询，直到收到QUIT或连接断开
+static void merkle_serve(t_rbtree *tree, int fd) {
+    t_merkle_request request;
+    vector<int> keys;
+    while (read_full(fd, &request, sizeof(request)) == 0 && request.type != MERKLE_REQ_QUIT) {
+        int ret = 0;
+        if (request.type == MERKLE_REQ_SUMMARY) {
+            t_merkle_summary summary = merkle_range_summary(tree, request.lo, request.hi);
+            ret = write_full(fd, &summary, sizeof(summary));
+        } else if (request.type == MERKLE_REQ_KEYS) {
+            keys.clear();
+            merkle_range_keys(tree->root, request.lo, request.hi, keys);
+            uint32_t count = keys.size();
+            ret = write_full(fd, &count, sizeof(count));
+            if (ret == 0) {
+                ret = write_full(fd, keys.data(), count * sizeof(int));
+            }
+        }
+
+        if (ret != 0)
+            return;
+    }
+}
+
+static int remote_peer_summary(void *ctx, long long lo, long long hi, t_merkle_summary *summary) {
+    int fd = *(int *)ctx;
+    t_merkle_request request = {MERKLE_REQ_SUMMARY, lo, hi};
+    if (write_full(fd, &request, sizeof(request)) != 0 || read_full(fd, summary, sizeof(*summary)) != 0)
+        return -1;
+
+    return 0;
+}
+
+static int remote_range_keys(int fd, long long lo, long long hi, vector<int>& keys) {
+    t_merkle_request request = {MERKLE_REQ_KEYS, lo, hi};
+    uint32_t count = 0;
+    if (write_full(fd, &request, sizeof(request)) != 0 || read_full(fd, &count, sizeof(count)) != 0)
+        return -1;
+
+    keys.resize(count);
+    return read_full(fd, keys.data(), count * sizeof(int));
+}
+
+/*
+    让本地树与对端一致：先对比找出不一致的区间，再逐个区间取回对端的key，与本地的key做归并，插入本地缺少的，删除
+本地多出来的。返回传输的key的个数，失败返回-1。
+*/
+long long merkle_sync(t_rbtree *local, int fd, long long *exchanged, long long *range_count) {
+    t_merkle_peer peer = {remote_peer_summary, &fd, 0};
+    vector<t_merkle_range> ranges;
+    *exchanged = merkle_diff(local, &peer, ranges);
+    *range_count = ranges.size();
+    if (*exchanged < 0)
+        return -1;
+
+    long long shipped = 0;
+    vector<int> theirs, mine;
+    for (auto& range : ranges) {
+        if (remote_range_keys(fd, range.lo, range.hi, theirs) != 0)
+            return -1;
+
+        shipped += theirs.size();
+        mine.clear();
+        merkle_range_keys(local->root, range.lo, range.hi, mine);
+
+        size_t i = 0, j = 0;
+        while (i < mine.size() || j < theirs.size()) {
+            if (j == theirs.size() || (i < mine.size() && mine[i] < theirs[j])) {
+                rbtree_erase(local, mine[i++]);
+            } else if (i == mine.size() || theirs[j] < mine[i]) {
+                rbtree_insert(local, theirs[j++]);
+            } else {
+                ++i, ++j;
+            }
+        }
+    }
+
+    return shipped;
+}
+
+int main(int argc, char *argv[]) {
+    long long count = argc > 1 ? std::atoll(argv[1]) : 1000000;
+    int diffs[] = {0, 1, 10, 100, 1000};
+
+    // 两个副本：插入顺序不同，树的形状也不同
+    std::mt19937 rng(20260417);
+    vector<int> keys(count);
+    for (long long i = 0; i < count; ++i) {
+        keys[i] = (int)(rng() & 0x7fffffff);
+    }
+
+    std::printf("%lld keys per replica\n", count);
+    std::printf("%8s %12s %10s %12s %12s %10s %8s\n",
+                "diffs", "local xchg", "ranges", "remote xchg", "keys shipped", "sync ms", "equal");
+    for (auto diff : diffs) {
+        t_rbtree primary = {nil_node}, replica = {nil_node};
+        for (auto key : keys) {
+            rbtree_insert(&primary, key);
+        }
+        for (long long i = count - 1; i >= 0; --i) {
+            rbtree_insert(&replica, keys[i]);
+        }
+
+        // 副本上有一半的不一致是缺少key，一半是多出key
+        for (int i = 0; i < diff; ++i) {
+            if (i & 1) {
+                rbtree_erase(&replica, keys[rng() % count]);
+            } else {
+                rbtree_insert(&replica, (int)(rng() & 0x7fffffff));
+            }
+        }
+
+        // 先在本地对比一次
+        t_merkle_peer local_peer = {local_peer_summary, &primary, 0};
+        vector<t_merkle_range> ranges;
+        long long local_exchanged = merkle_diff(&replica, &local_peer, ranges);
+
+        // 再让子进程持有primary，通过Unix socket同步
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            std::perror("socketpair");
+            return 1;
+        }
+
+        std::fflush(nullptr);
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            merkle_serve(&primary, fds[1]);
+            _exit(0);
+        }
+        close(fds[1]);
+
+        long long exchanged = 0, range_count = 0;
+        auto start = std::chrono::steady_clock::now();
+        long long shipped = merkle_sync(&replica, fds[0], &exchanged, &range_count);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (shipped < 0) {
+            std::printf("sync with peer failed\n");
+        }
+
+        t_merkle_request quit = {MERKLE_REQ_QUIT, 0, 0};
+        write_full(fds[0], &quit, sizeof(quit));
+        close(fds[0]);
+        waitpid(pid, nullptr, 0);
+
+        t_merkle_summary a = merkle_range_summary(&primary, MERKLE_KEY_MIN, MERKLE_KEY_END);
+        t_merkle_summary b = merkle_range_summary(&replica, MERKLE_KEY_MIN, MERKLE_KEY_END);
+        std::printf("%8d %12lld %10zu %12lld %12lld %10.2f %8s\n",
+                    diff, local_exchanged, ranges.size(), exchanged, shipped, ms,
+                    (a.hash == b.hash && a.count == b.count) ? "yes" : "no");
+
+        rbtree_destroy(&primary);
+        rbtree_destroy(&replica);
+    }
+
+    return 0;
+}
@@ -0,0 +1,715 @@
+/**
+ * @file red_black_tree_mvcc.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 多版本红黑树（MVCC）：读者按时间戳读到一致的快照，不加锁，后台清理旧版本
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using std::vector;
+
+typedef int USER_KEY_TYPE;
+typedef int USER_VALUE_TYPE;
+
+#define RBTREE_CLR_RED 0
+#define RBTREE_CLR_BLK 1
+#define RBTREE_CLR_DBL 2
+
+/*
+    长时间运行的分析扫描要和高频的更新同时进行，扫描看到的必须是某一个时间点上一致的数据，又不能因为加锁而阻塞更新。
+
+    1. 版本链：每个key对应一个记录（record），记录中保存一条按提交时间戳从新到旧排列的版本链，每个版本带有值和提交
+       时间戳，删除也是追加一个“墓碑”版本。读者开始读时取当前已提交的时间戳作为快照时间戳，沿版本链找到第一个提交
+       时间戳不大于快照时间戳的版本，就是它应该看到的值。一个事务中的所有版本使用同一个时间戳，提交时才把全局时钟
+       推进到这个时间戳，所以读者要么看到整个事务，要么完全看不到。
+    2. 树结构：更新已有的key只是在版本链头部原子地插入一个新版本，不修改树的结构。只有新增key和清理时摘除key才会
+       修改树的结构，这时使用路径复制（copy-on-write）：被修改的节点都先复制一份再改，最后原子地发布新的根节点。
+       已经发布的节点永远不会再被修改，读者拿到某个根节点后，可以不加任何锁地遍历它。复制出来的节点和原节点指向
+       同一个记录，因此新旧两棵树看到的版本链是同一条。
+    3. 清理（vacuum）：所有读者中最老的快照时间戳记为oldest。每条版本链只需要保留第一个提交时间戳不大于oldest的版本，
+       比它更旧的版本不会再被任何读者访问到，可以直接释放；如果保留下来的是墓碑，整个key都可以从树中摘除。
+       路径复制替换下来的旧节点、被摘除的记录，只有在所有可能持有旧根节点的读者都结束以后才能释放，因此它们记录下
+       被替换时的提交时间戳，等到oldest不小于这个时间戳时再释放。
+
+    写者之间使用一把互斥锁串行执行，读者始终不加锁。
+*/
+
+typedef struct rbtree_version {
+    USER_VALUE_TYPE value;
+    int deleted;                        // 墓碑
+    uint64_t commit_ts;
+    struct rbtree_version *next;        // 更旧的版本
+} t_rbtree_version;
+
+typedef struct rbtree_record {
+    std::atomic<t_rbtree_version *> head;
+} t_rbtree_record;
+
+typedef struct rbtree_node {
+    USER_KEY_TYPE key;
+    int color;
+    struct rbtree_node *left;
+    struct rbtree_node *right;
+    t_rbtree_record *record;
+    uint64_t gen;                       // 创建该节点的结构修改的编号，见__mvcc_clone
+} t_rbtree_node;
+
+// 等待释放的对象
+typedef struct rbtree_garbage {
+    uint64_t retire_ts;
+    t_rbtree_node *node;
+    t_rbtree_record *record;
+} t_rbtree_garbage;
+
+#define MVCC_MAX_READERS 64
+#define MVCC_SLOT_FREE   UINT64_MAX
+
+typedef struct mvcc_rbtree {
+    std::atomic<t_rbtree_node *> root;
+    std::atomic<uint64_t> clock;        // 最近一次提交的时间戳
+    std::atomic<uint64_t> readers[MVCC_MAX_READERS];
+
+    // 以下字段只有持有write_lock的写者访问
+    std::mutex write_lock;
+    uint64_t txn_ts;                    // 当前事务的提交时间戳
+    uint64_t gen;
+    vector<t_rbtree_node *> replaced;   // 当前事务中被路径复制替换下来的节点
+    vector<t_rbtree_record *> dropped;  // 当前事务中被摘除的记录
+    vector<t_rbtree_garbage> garbage;
+
+    // 统计信息
+    long long versions_pruned;
+    long long nodes_freed;
+} t_mvcc_rbtree;
+
+// 读者持有的快照
+typedef struct mvcc_snapshot {
+    t_mvcc_rbtree *tree;
+    int slot;
+    uint64_t ts;
+    t_rbtree_node *root;
+} t_mvcc_snapshot;
+
+t_rbtree_node __nil_node;
+
+#define nil_node (&__nil_node)
+
+__attribute__((constructor))
+void init_nil_node() {
+     __nil_node.key = 0;
+     __nil_node.color = RBTREE_CLR_BLK;
+     __nil_node.left = __nil_node.right = nil_node;
+     __nil_node.record = nullptr;
+}
+
+void mvcc_rbtree_init(t_mvcc_rbtree *tree) {
+    tree->root.store(nil_node);
+    tree->clock.store(0);
+    for (int i = 0; i < MVCC_MAX_READERS; ++i) {
+        tree->readers[i].store(MVCC_SLOT_FREE);
+    }
+    tree->txn_ts = 0;
+    tree->gen = 0;
+    tree->versions_pruned = tree->nodes_freed = 0;
+}
+
+/* ------------------------------------ 读者 ----------------------------------- */
+
+/*
+    登记快照时间戳：先占一个槽位写入当前时钟，再重新读一遍时钟，直到两次一致为止。这样清理线程在扫描槽位之前读到
+的时钟，一定不大于任何它没扫描到的读者最终使用的时间戳，不会把读者还需要的版本清理掉。
+*/
+int mvcc_snapshot_begin(t_mvcc_rbtree *tree, t_mvcc_snapshot *snapshot) {
+    if (tree == nullptr || snapshot == nullptr)
+        return -1;
+
+    uint64_t ts = tree->clock.load();
+    int slot = -1;
+    for (int i = 0; i < MVCC_MAX_READERS && slot < 0; ++i) {
+        uint64_t expected = MVCC_SLOT_FREE;
+        if (tree->readers[i].compare_exchange_strong(expected, ts)) {
+            slot = i;
+        }
+    }
+    if (slot < 0)
+        return -2;
+
+    uint64_t now;
+    while ((now = tree->clock.load()) != ts) {
+        ts = now;
+        tree->readers[slot].store(ts);
+    }
+
+    snapshot->tree = tree;
+    snapshot->slot = slot;
+    snapshot->ts = ts;
+    snapshot->root = tree->root.load(std::memory_order_acquire);
+    return 0;
+}
+
+void mvcc_snapshot_end(t_mvcc_snapshot *snapshot) {
+    if (snapshot == nullptr || snapshot->slot < 0)
+        return;
+
+    snapshot->tree->readers[snapshot->slot].store(MVCC_SLOT_FREE);
+    snapshot->slot = -1;
+}
+
+// 返回记录在快照时间戳下可见的版本，不可见或已删除时返回nullptr
+static const t_rbtree_version *__mvcc_visible(const t_rbtree_record *record, uint64_t ts) {
+    const t_rbtree_version *version = record->head.load(std::memory_order_acquire);
+    while (version && version->commit_ts > ts) {
+        version = version->next;
+    }
+
+    return (version && !version->deleted) ? version : nullptr;
+}
+
+// 在快照中查找key，找到返回0并通过value返回值，不存在返回1
+int mvcc_get(const t_mvcc_snapshot *snapshot, USER_KEY_TYPE key, USER_VALUE_TYPE *value) {
+    if (snapshot == nullptr)
+        return -1;
+
+    t_rbtree_node *cursor = snapshot->root;
+    while (cursor != nil_node) {
+        if (key == cursor->key) {
+            const t_rbtree_version *version = __mvcc_visible(cursor->record, snapshot->ts);
+            if (version == nullptr)
+                return 1;
+
+            if (value) {
+                *value = version->value;
+            }
+            return 0;
+        }
+
+        cursor = (key < cursor->key ? cursor->left : cursor->right);
+    }
+
+    return 1;
+}
+
+static void __mvcc_scan(t_rbtree_node *root, uint64_t ts, USER_KEY_TYPE lo, USER_KEY_TYPE hi,
+                        vector<std::pair<USER_KEY_TYPE, USER_VALUE_TYPE>>& result) {
+    if (root == nil_node)
+        return;
+
+    if (lo < root->key) {
+        __mvcc_scan(root->left, ts, lo, hi, result);
+    }
+    if (lo <= root->key && root->key < hi) {
+        const t_rbtree_version *version = __mvcc_visible(root->record, ts);
+        if (version) {
+            result.emplace_back(root->key, version->value);
+        }
+    }
+    if (root->key < hi) {
+        __mvcc_scan(root->right, ts, lo, hi, result);
+    }
+}
+
+// 按key的顺序返回快照中[lo, hi)范围内所有可见的键值对
+int mvcc_scan(const t_mvcc_snapshot *snapshot, USER_KEY_TYPE lo, USER_KEY_TYPE hi,
+              vector<std::pair<USER_KEY_TYPE, USER_VALUE_TYPE>>& result) {
+    if (snapshot == nullptr)
+        return -1;
+
+    __mvcc_scan(snapshot->root, snapshot->ts, lo, hi, result);
+    return 0;
+}
+
+/* ----------------------------- 写者：路径复制 ----------------------------- */
+
+/*
+    每次结构修改（一次插入或一次删除）开始时把gen加一。节点的gen等于当前的gen，说明它是这次修改中新复制出来的、
+还没有被发布过，可以直接修改；否则它可能正在被读者访问，必须先复制一份。被复制的原节点记录下来，事务提交时统一
+交给垃圾链表延迟释放。
+*/
+static t_rbtree_node *__mvcc_clone(t_mvcc_rbtree *tree, t_rbtree_node *node) {
+    if (node == nil_node || node->gen == tree->gen)
+        return node;
+
+    t_rbtree_node *copy = new t_rbtree_node(*node);
+    copy->gen = tree->gen;
+    tree->replaced.push_back(node);
+    return copy;
+}
+
+static int has_red_child_node(t_rbtree_node *node) {
+    return node->left->color == RBTREE_CLR_RED || node->right->color == RBTREE_CLR_RED;
+}
+
+// 旋转只修改up和down两个节点，调用者需要保证它们都已经复制过
+static t_rbtree_node *rbtree_left_rotate(t_rbtree_node *up) {
+    t_rbtree_node *down = up->right;
+    up->right = down->left;
+    down->left = up;
+
+    return down;
+}
+
+static t_rbtree_node *rbtree_right_rotate(t_rbtree_node *up) {
+    t_rbtree_node *down = up->left;
+    up->left = down->right;
+    down->right = up;
+
+    return down;
+}
+
+#define RBTREE_INSERT_CLT_NONE  0
+#define RBTREE_INSERT_CLT_LEFT  1
+#define RBTREE_INSERT_CLT_RIGHT 2
+// 插入调整的逻辑与red_black_tree_recursion.cpp相同。root已经复制过，插入路径上的孩子也是新复制的，
+// 需要额外复制的只有可能被改色的兄弟节点，被旋转的节点都在插入路径上
+static t_rbtree_node *rbtree_insert_maintian(t_mvcc_rbtree *tree, t_rbtree_node *root) {
+    if (!has_red_child_node(root))
+        return root;
+
+    root->left = __mvcc_clone(tree, root->left);
+    root->right = __mvcc_clone(tree, root->right);
+    if (root->left->color == RBTREE_CLR_RED && root->right->color == RBTREE_CLR_RED) {
+        root->color = RBTREE_CLR_RED;
+        root->left->color = root->right->color = RBTREE_CLR_BLK;
+
+        return root;
+    }
+
+    int has_red_conflict = RBTREE_INSERT_CLT_NONE;
+    if (root->left->color == RBTREE_CLR_RED && has_red_child_node(root->left)) {
+        has_red_conflict = RBTREE_INSERT_CLT_LEFT;
+    } else if (root->right->color == RBTREE_CLR_RED && has_red_child_node(root->right)) {
+        has_red_conflict = RBTREE_INSERT_CLT_RIGHT;
+    }
+
+    if (!has_red_conflict)
+        return root;
+
+    if (has_red_conflict == RBTREE_INSERT_CLT_LEFT) {
+        if (root->left->right->color == RBTREE_CLR_RED) {
+            root->left = rbtree_left_rotate(root->left);
+        }
+        root = rbtree_right_rotate(root);
+    } else {
+        if (root->right->left->color == RBTREE_CLR_RED) {
+            root->right = rbtree_right_rotate(root->right);
+        }
+        root = rbtree_left_rotate(root);
+    }
+
+    root->color = RBTREE_CLR_RED;
+    root->left->color = root->right->color = RBTREE_CLR_BLK;
+    return root;
+}
+
+static t_rbtree_node *__mvcc_insert(t_mvcc_rbtree *tree, t_rbtree_node *root, USER_KEY_TYPE key, t_rbtree_record *record) {
+    if (root == nil_node) {
+        t_rbtree_node *node = new t_rbtree_node;
+        node->key = key;
+        node->color = RBTREE_CLR_RED;
+        node->left = node->right = nil_node;
+        node->record = record;
+        node->gen = tree->gen;
+        return node;
+    }
+
+    root = __mvcc_clone(tree, root);
+    if (key < root->key) {
+        root->left = __mvcc_insert(tree, root->left, key, record);
+    } else {
+        root->right = __mvcc_insert(tree, root->right, key, record);
+    }
+
+    return rbtree_insert_maintian(tree, root);
+}
+
+#define RBTREE_ERASE_CLT_NONE  0
+#define RBTREE_ERASE_CLT_LEFT  1
+#define RBTREE_ERASE_CLT_RIGHT 2
+// 删除调整的逻辑与red_black_tree_recursion.cpp相同，开始调整前先复制兄弟节点和两个侄子节点
+static t_rbtree_node *__mvcc_erase_maintain(t_mvcc_rbtree *tree, t_rbtree_node *root) {
+    if (root->left->color != RBTREE_CLR_DBL && root->right->color != RBTREE_CLR_DBL) {
+        return root;
+    }
+
+    t_rbtree_node *sibling = __mvcc_clone(tree, root->left->color == RBTREE_CLR_DBL ? root->right : root->left);
+    sibling->left = __mvcc_clone(tree, sibling->left);
+    sibling->right = __mvcc_clone(tree, sibling->right);
+    if (root->left->color == RBTREE_CLR_DBL) {
+        root->right = sibling;
+    } else {
+        root->left = sibling;
+    }
+
+    if (has_red_child_node(root)) {
+        int has_red_conflict = RBTREE_ERASE_CLT_NONE;
+        root->color = RBTREE_CLR_RED;
+        if (root->left->color == RBTREE_CLR_RED) {
+            root = rbtree_right_rotate(root);
+            has_red_conflict = RBTREE_ERASE_CLT_LEFT;
+        } else {
+            root = rbtree_left_rotate(root);
+            has_red_conflict = RBTREE_ERASE_CLT_RIGHT;
+        }
+        root->color = RBTREE_CLR_BLK;
+
+        if (has_red_conflict == RBTREE_ERASE_CLT_LEFT) {
+            root->right = __mvcc_erase_maintain(tree, root->right);
+        } else {
+            root->left = __mvcc_erase_maintain(tree, root->left);
+        }
+
+        return root;
+    }
+
+    if ((root->left->color == RBTREE_CLR_DBL && !has_red_child_node(root->right)) ||
+        (root->right->color == RBTREE_CLR_DBL && !has_red_child_node(root->left))) {
+
+        root->left->color -= RBTREE_CLR_BLK;
+        root->right->color -= RBTREE_CLR_BLK;
+
+        root->color += RBTREE_CLR_BLK;
+        return root;
+    }
+
+    if (root->left->color == RBTREE_CLR_DBL) {
+        if (root->right->left->color == RBTREE_CLR_RED) {
+            root->right->color = RBTREE_CLR_RED;
+            root->right = rbtree_right_rotate(root->right);
+            root->right->color = RBTREE_CLR_BLK;
+        }
+
+        root->left->color -= RBTREE_CLR_BLK;
+        root = rbtree_left_rotate(root);
+        root->color = root->left->color;
+    } else {
+        if (root->left->right->color == RBTREE_CLR_RED) {
+            root->left->color = RBTREE_CLR_RED;
+            root->left = rbtree_left_rotate(root->left);
+            root->left->color = RBTREE_CLR_BLK;
+        }
+
+        root->right->color -= RBTREE_CLR_BLK;
+        root = rbtree_right_rotate(root);
+        root->color = root->right->color;
+    }
+
+    root->left->color = root->right->color = RBTREE_CLR_BLK;
+
+    return root;
+}
+
+static t_rbtree_node *__mvcc_erase(t_mvcc_rbtree *tree, t_rbtree_node *root, USER_KEY_TYPE key) {
+    if (root == nil_node)
+        return nil_node;
+
+    root = __mvcc_clone(tree, root);
+    if (key < root->key) {
+        root->left = __mvcc_erase(tree, root->left, key);
+    } else if (key > root->key) {
+        root->right = __mvcc_erase(tree, root->right, key);
+    } else {
+        if (root->left == nil_node || root->right == nil_node) {
+            t_rbtree_node *child = __mvcc_clone(tree, root->left != nil_node ? root->left : root->right);
+            child->color += root->color;
+            // root是本次复制出来的，还没有发布，可以直接释放；它的原节点已经在replaced中了
+            delete root;
+
+            return child;
+        }
+
+        t_rbtree_node *prev_node = root->left;
+        while (prev_node->right != nil_node) {
+            prev_node = prev_node->right;
+        }
+        root->key = prev_node->key;
+        root->record = prev_node->record;
+        root->left = __mvcc_erase(tree, root->left, prev_node->key);
+    }
+
+    return __mvcc_erase_maintain(tree, root);
+}
+
+static t_rbtree_node *__mvcc_find_node(t_rbtree_node *cursor, USER_KEY_TYPE key) {
+    while (cursor != nil_node) {
+        if (key == cursor->key)
+            return cursor;
+
+        cursor = (key < cursor->key ? cursor->left : cursor->right);
+    }
+
+    return nullptr;
+}
+
+/* ------------------------------- 写者：事务 ------------------------------- */
+
+static void __mvcc_free_record(t_rbtree_record *record) {
+    t_rbtree_version *version = record->head.load();
+    while (version) {
+        t_rbtree_version *next = version->next;
+        delete version;
+        version = next;
+    }
+    delete record;
+}
+
+// 所有读者中最老的快照时间戳，没有读者时就是当前时钟
+static uint64_t __mvcc_oldest_reader(t_mvcc_rbtree *tree) {
+    uint64_t oldest = tree->clock.load();
+    for (int i = 0; i < MVCC_MAX_READERS; ++i) {
+        uint64_t ts = tree->readers[i].load();
+        if (ts < oldest) {
+            oldest = ts;
+        }
+    }
+
+    return oldest;
+}
+
+// 释放所有已经没有读者能访问到的旧节点和记录
+static void __mvcc_collect_garbage(t_mvcc_rbtree *tree) {
+    uint64_t oldest = __mvcc_oldest_reader(tree);
+    size_t kept = 0;
+    for (auto& item : tree->garbage) {
+        if (item.retire_ts > oldest) {
+            tree->garbage[kept++] = item;
+            continue;
+        }
+
+        if (item.node) {
+            delete item.node;
+            tree->nodes_freed++;
+        }
+        if (item.record) {
+            __mvcc_free_record(item.record);
+        }
+    }
+    tree->garbage.resize(kept);
+}
+
+// 开始一个写事务，事务中的所有修改使用同一个提交时间戳
+void mvcc_txn_begin(t_mvcc_rbtree *tree) {
+    tree->write_lock.lock();
+    tree->txn_ts = tree->clock.load() + 1;
+}
+
+// 在事务中写入key的新值
+void mvcc_txn_put(t_mvcc_rbtree *tree, USER_KEY_TYPE key, USER_VALUE_TYPE value) {
+    t_rbtree_version *version = new t_rbtree_version{value, 0, tree->txn_ts, nullptr};
+    t_rbtree_node *node = __mvcc_find_node(tree->root.load(), key);
+    if (node) {
+        version->next = node->record->head.load();
+        node->record->head.store(version, std::memory_order_release);
+        return;
+    }
+
+    // 新的key需要修改树的结构
+    t_rbtree_record *record = new t_rbtree_record;
+    record->head.store(version);
+    tree->gen++;
+    t_rbtree_node *root = __mvcc_insert(tree, tree->root.load(), key, record);
+    root = __mvcc_clone(tree, root);
+    root->color = RBTREE_CLR_BLK;
+    tree->root.store(root, std::memory_order_release);
+}
+
+// 在事务中删除key，成功返回0，key不存在返回1
+int mvcc_txn_erase(t_mvcc_rbtree *tree, USER_KEY_TYPE key) {
+    t_rbtree_node *node = __mvcc_find_node(tree->root.load(), key);
+    if (node == nullptr)
+        return 1;
+
+    t_rbtree_version *head = node->record->head.load();
+    if (head->deleted)
+        return 1;
+
+    node->record->head.store(new t_rbtree_version{0, 1, tree->txn_ts, head}, std::memory_order_release);
+    return 0;
+}
+
+// 提交事务：推进时钟后，读者才能看到本事务的修改
+void mvcc_txn_commit(t_mvcc_rbtree *tree) {
+    tree->clock.store(tree->txn_ts, std::memory_order_release);
+
+    for (auto node : tree->replaced) {
+        tree->garbage.push_back({tree->txn_ts, node, nullptr});
+    }
+    for (auto record : tree->dropped) {
+        tree->garbage.push_back({tree->txn_ts, nullptr, record});
+    }
+    tree->replaced.clear();
+    tree->dropped.clear();
+    __mvcc_collect_garbage(tree);
+
+    tree->write_lock.unlock();
+}
+
+/*
+    清理旧版本：对每条版本链，保留第一个提交时间戳不大于oldest的版本，截掉更旧的部分。正在读的读者的快照时间戳都
+不小于oldest，它们沿版本链最多走到这个保留的版本就会停下，不会访问到被截掉的部分，所以被截掉的版本可以立即释放。
+保留下来的版本是墓碑时，整个key对所有读者都不可见了，从树中摘除。清理本身也作为一个事务执行。
+*/
+static void __mvcc_prune(t_mvcc_rbtree *tree, t_rbtree_node *root, uint64_t oldest, vector<USER_KEY_TYPE>& dead) {
+    if (root == nil_node)
+        return;
+
+    t_rbtree_version *version = root->record->head.load();
+    while (version && version->commit_ts > oldest) {
+        version = version->next;
+    }
+    if (version) {
+        t_rbtree_version *old = version->next;
+        version->next = nullptr;
+        while (old) {
+            t_rbtree_version *next = old->next;
+            delete old;
+            tree->versions_pruned++;
+            old = next;
+        }
+
+        if (version->deleted && root->record->head.load() == version) {
+            dead.push_back(root->key);
+        }
+    }
+
+    __mvcc_prune(tree, root->left, oldest, dead);
+    __mvcc_prune(tree, root->right, oldest, dead);
+}
+
+void mvcc_vacuum(t_mvcc_rbtree *tree) {
+    mvcc_txn_begin(tree);
+
+    vector<USER_KEY_TYPE> dead;
+    __mvcc_prune(tree, tree->root.load(), __mvcc_oldest_reader(tree), dead);
+    for (auto key : dead) {
+        t_rbtree_node *node = __mvcc_find_node(tree->root.load(), key);
+        tree->dropped.push_back(node->record);
+
+        tree->gen++;
+        t_rbtree_node *root = __mvcc_erase(tree, tree->root.load(), key);
+        root = __mvcc_clone(tree, root);
+        root->color = RBTREE_CLR_BLK;
+        tree->root.store(root, std::memory_order_release);
+    }
+
+    mvcc_txn_commit(tree);
+}
+
+static void __mvcc_destroy(t_rbtree_node *root) {
+    if (root == nil_node)
+        return;
+
+    __mvcc_destroy(root->left);
+    __mvcc_destroy(root->right);
+    __mvcc_free_record(root->record);
+    delete root;
+}
+
+// 销毁整棵树，调用时不能再有读者和写者
+void mvcc_rbtree_destroy(t_mvcc_rbtree *tree) {
+    if (tree == nullptr)
+        return;
+
+    for (auto& item : tree->garbage) {
+        delete item.node;
+        if (item.record) {
+            __mvcc_free_record(item.record);
+        }
+    }
+    tree->garbage.clear();
+    __mvcc_destroy(tree->root.load());
+    tree->root.store(nil_node);
+}
+
+#define DEMO_ACCOUNTS  1000
+#define DEMO_BALANCE   100
+#define DEMO_TRANSFERS 200000
+
+int main() {
+    t_mvcc_rbtree tree;
+    mvcc_rbtree_init(&tree);
+
+    // 1000个账户，每个账户100元，转账不改变总额
+    mvcc_txn_begin(&tree);
+    for (int i = 0; i < DEMO_ACCOUNTS; ++i) {
+        mvcc_txn_put(&tree, i, DEMO_BALANCE);
+    }
+    mvcc_txn_commit(&tree);
+
+    std::atomic<int> running(1);
+    long long scans = 0, inconsistent = 0;
+
+    // 分析线程：反复扫描全表求和，每次都应该得到相同的总额
+    std::thread analyst([&]() {
+        while (running.load()) {
+            t_mvcc_snapshot snapshot;
+            if (mvcc_snapshot_begin(&tree, &snapshot) != 0)
+                continue;
+
+            vector<std::pair<USER_KEY_TYPE, USER_VALUE_TYPE>> rows;
+            mvcc_scan(&snapshot, 0, DEMO_ACCOUNTS * 2, rows);
+            long long sum = 0;
+            for (auto& row : rows) {
+                sum += row.second;
+            }
+            inconsistent += (sum != (long long)DEMO_ACCOUNTS * DEMO_BALANCE);
+            ++scans;
+            mvcc_snapshot_end(&snapshot);
+        }
+    });
+
+    // 后台清理线程
+    std::thread vacuum([&]() {
+        while (running.load()) {
+            mvcc_vacuum(&tree);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    // 写线程：随机转账，偶尔新建并删除余额为0的临时账户，触发树结构的修改
+    unsigned seed = 12345;
+    for (int i = 0; i < DEMO_TRANSFERS; ++i) {
+        seed = seed * 1103515245 + 12345;
+        int from = (seed >> 8) % DEMO_ACCOUNTS;
+        int to = (seed >> 18) % DEMO_ACCOUNTS;
+
+        mvcc_txn_begin(&tree);
+        t_mvcc_snapshot self;
+        mvcc_snapshot_begin(&tree, &self);
+        USER_VALUE_TYPE a = 0, b = 0;
+        mvcc_get(&self, from, &a);
+        mvcc_get(&self, to, &b);
+        mvcc_snapshot_end(&self);
+        if (from != to && a > 0) {
+            mvcc_txn_put(&tree, from, a - 1);
+            mvcc_txn_put(&tree, to, b + 1);
+        }
+        if (i % 16 == 0) {
+            mvcc_txn_put(&tree, DEMO_ACCOUNTS + (i / 16) % DEMO_ACCOUNTS, 0);
+        } else if (i % 16 == 8) {
+            mvcc_txn_erase(&tree, DEMO_ACCOUNTS + (i / 16) % DEMO_ACCOUNTS);
+        }
+        mvcc_txn_commit(&tree);
+    }
+
+    running.store(0);
+    analyst.join();
+    vacuum.join();
+
+    std::printf("scans: %lld, inconsistent: %lld, versions pruned: %lld, nodes freed: %lld\n",
+                scans, inconsistent, tree.versions_pruned, tree.nodes_freed);
+
+    mvcc_rbtree_destroy(&tree);
+    return 0;
+}
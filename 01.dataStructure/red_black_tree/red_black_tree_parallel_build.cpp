@@ -0,0 +1,290 @@
+/**
+ * @file red_black_tree_parallel_build.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 多线程批量构建红黑树：并行样本排序 + 并行构建子树
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+
+#define RBTREE_NO_MAIN
+#include "red_black_tree_recursion.cpp"
+
+#define WS_SCHEDULER_NO_MAIN
+#include "work_stealing_scheduler.cpp"
+
+using std::vector;
+
+/*
+    逐个调用rbtree_insert构建n个key的树是O(n log n)的，而且每次插入都是一串随机访存，只能用一个核。批量构建分为两步：
+
+    1. 并行排序（样本排序）：从输入中随机抽样，排序后选出B-1个分割点，把值域分成B个桶。输入被切成B块，每块由一个任务
+       统计各个桶的元素个数，前缀和之后每块知道自己的元素应该写到每个桶的哪个位置，再各自把元素分发过去；然后每个桶
+       独立排序并去重。桶之间按值域有序，所以“合并”各个有序的桶只是按前缀和把去重后的结果依次拼接起来，也可以并行。
+    2. 并行构建：与adaptive_tree.cpp中的rbtree_build_from_sorted相同，取中点为根递归构建，得到一棵除最后一层外全满的
+       树。节点的颜色只取决于它在整棵树中的深度（最后一层染红，其余染黑），与由哪个线程构建无关，所以上层节点创建好
+       之后，左右子树可以作为独立的任务并行构建，构建完成时直接挂在父节点上就是一棵合法的红黑树，不需要额外的拼接和
+       调整。
+
+    任务调度使用work_stealing_scheduler.cpp中的fork-join调度器：每个核一个工作线程，每个线程一个Chase-Lev双端队列，
+等待一组任务完成的线程一边等一边执行任务，嵌套的fork-join不会死锁。销毁整棵树同样可以按子树拆成任务并行释放。
+*/
+
+/* ---------------------------------- 并行排序 --------------------------------- */
+
+/*
+    对keys做并行样本排序并去重，结果写入sorted。buckets是桶的个数，一般取线程数的若干倍，桶越多负载越均衡。
+*/
+void parallel_sort_unique(t_ws_pool *pool, const vector<USER_KEY_TYPE>& keys, vector<USER_KEY_TYPE>& sorted, int buckets) {
+    long long n = keys.size();
+    sorted.clear();
+    if (n == 0)
+        return;
+
+    // 1. 抽样选分割点
+    std::mt19937_64 rng(n);
+    vector<USER_KEY_TYPE> samples(buckets * 32);
+    for (auto& sample : samples) {
+        sample = keys[rng() % n];
+    }
+    std::sort(samples.begin(), samples.end());
+    vector<USER_KEY_TYPE> splitters;
+    for (int i = 1; i < buckets; ++i) {
+        splitters.push_back(samples[i * 32]);
+    }
+
+    // 相同的key一定落在同一个桶里，去重只需要在桶内进行
+    auto bucket_of = [&splitters](USER_KEY_TYPE key) {
+        return (int)(std::upper_bound(splitters.begin(), splitters.end(), key) - splitters.begin());
+    };
+
+    // 2. 每块统计各个桶的元素个数
+    int chunks = buckets;
+    long long chunk_size = (n + chunks - 1) / chunks;
+    vector<long long> counts((size_t)chunks * buckets, 0);
+    ws_parallel_for(pool, chunks, chunks, [&](long long begin, long long end) {
+        for (long long c = begin; c < end; ++c) {
+            long long *row = &counts[c * buckets];
+            for (long long i = c * chunk_size; i < std::min(n, (c + 1) * chunk_size); ++i) {
+                row[bucket_of(keys[i])]++;
+            }
+        }
+    });
+
+    // 3. 前缀和：桶优先，同一个桶中按块的顺序排列
+    vector<long long> offsets((size_t)chunks * buckets);
+    vector<long long> bucket_begin(buckets + 1, 0);
+    long long position = 0;
+    for (int b = 0; b < buckets; ++b) {
+        bucket_begin[b] = position;
+        for (int c = 0; c < chunks; ++c) {
+            offsets[(size_t)c * buckets + b] = position;
+            position += counts[(size_t)c * buckets + b];
+        }
+    }
+    bucket_begin[buckets] = position;
+
+    // 4. 分发
+    vector<USER_KEY_TYPE> scratch(n);
+    ws_parallel_for(pool, chunks, chunks, [&](long long begin, long long end) {
+        for (long long c = begin; c < end; ++c) {
+            long long *cursor = &offsets[c * buckets];
+            for (long long i = c * chunk_size; i < std::min(n, (c + 1) * chunk_size); ++i) {
+                scratch[cursor[bucket_of(keys[i])]++] = keys[i];
+            }
+        }
+    });
+
+    // 5. 每个桶排序去重
+    vector<long long> unique_count(buckets);
+    ws_parallel_for(pool, buckets, buckets, [&](long long begin, long long end) {
+        for (long long b = begin; b < end; ++b) {
+            auto first = scratch.begin() + bucket_begin[b];
+            auto last = scratch.begin() + bucket_begin[b + 1];
+            std::sort(first, last);
+            unique_count[b] = std::unique(first, last) - first;
+        }
+    });
+
+    // 6. 按桶的顺序拼接
+    vector<long long> output_begin(buckets + 1, 0);
+    for (int b = 0; b < buckets; ++b) {
+        output_begin[b + 1] = output_begin[b] + unique_count[b];
+    }
+    sorted.resize(output_begin[buckets]);
+    ws_parallel_for(pool, buckets, buckets, [&](long long begin, long long end) {
+        for (long long b = begin; b < end; ++b) {
+            std::copy(scratch.begin() + bucket_begin[b], scratch.begin() + bucket_begin[b] + unique_count[b],
+                      sorted.begin() + output_begin[b]);
+        }
+    });
+}
+
+/* ---------------------------------- 并行构建 --------------------------------- */
+
+// 子树中的key个数不超过该值时，不再拆分成新的任务
+#define PARALLEL_BUILD_GRAIN (1 << 16)
+
+static t_rbtree_node *__rbtree_build(const USER_KEY_TYPE *keys, long long lo, long long hi, int depth, int full_levels) {
+    if (lo >= hi)
+        return nil_node;
+
+    long long mid = lo + (hi - lo) / 2;
+    t_rbtree_node *node = rbtree_create_node(keys[mid]);
+    node->color = (depth >= full_levels ? RBTREE_CLR_RED : RBTREE_CLR_BLK);
+    node->left = __rbtree_build(keys, lo, mid, depth + 1, full_levels);
+    node->right = __rbtree_build(keys, mid + 1, hi, depth + 1, full_levels);
+
+    return node;
+}
+
+// 构建[lo, hi)对应的子树，结果写入*slot；子树足够大时左右子树作为两个任务并行构建
+static void __rbtree_parallel_build(t_ws_pool *pool, t_ws_group *group, const USER_KEY_TYPE *keys,
+                                    long long lo, long long hi, int depth, int full_levels, t_rbtree_node **slot) {
+    if (hi - lo <= PARALLEL_BUILD_GRAIN) {
+        *slot = __rbtree_build(keys, lo, hi, depth, full_levels);
+        return;
+    }
+
+    long long mid = lo + (hi - lo) / 2;
+    t_rbtree_node *node = rbtree_create_node(keys[mid]);
+    node->color = (depth >= full_levels ? RBTREE_CLR_RED : RBTREE_CLR_BLK);
+    *slot = node;
+
+    ws_spawn(pool, group, [=]() {
+        __rbtree_parallel_build(pool, group, keys, lo, mid, depth + 1, full_levels, &node->left);
+    });
+    __rbtree_parallel_build(pool, group, keys, mid + 1, hi, depth + 1, full_levels, &node->right);
+}
+
+// 由有序且不重复的keys并行构建红黑树，树原有的内容会被丢弃（调用者负责先销毁）
+void rbtree_parallel_build_from_sorted(t_ws_pool *pool, t_rbtree *tree, const USER_KEY_TYPE *keys, long long count) {
+    int full_levels = 0;
+    while ((1LL << (full_levels + 1)) - 1 <= count) {
+        ++full_levels;
+    }
+
+    t_ws_group group = {{0}};
+    __rbtree_parallel_build(pool, &group, keys, 0, count, 0, full_levels, &tree->root);
+    ws_wait(pool, &group);
+    tree->size = count;
+}
+
+// 由任意顺序、可能重复的keys并行构建红黑树
+void rbtree_parallel_bulk_load(t_ws_pool *pool, t_rbtree *tree, const vector<USER_KEY_TYPE>& keys) {
+    vector<USER_KEY_TYPE> sorted;
+    parallel_sort_unique(pool, keys, sorted, std::max(1, pool->workers) * 8);
+    rbtree_parallel_build_from_sorted(pool, tree, sorted.data(), sorted.size());
+}
+
+// 释放以root为根的子树，子树足够大时左右子树作为两个任务并行释放
+static void __rbtree_parallel_destroy(t_ws_pool *pool, t_rbtree_node *root, int depth) {
+    if (root == nil_node)
+        return;
+
+    // 红黑树近似平衡，深度超过log2(PARALLEL_BUILD_GRAIN)之后子树已经足够小
+    if ((1LL << depth) >= PARALLEL_BUILD_GRAIN || depth > 48) {
+        __rbtree_destroy(root);
+        return;
+    }
+
+    t_rbtree_node *left = root->left, *right = root->right;
+    ws_invoke(pool, [=]() { __rbtree_parallel_destroy(pool, left, depth + 1); },
+              [=]() { __rbtree_parallel_destroy(pool, right, depth + 1); });
+    SAFE_DELETE_NODE(root);
+}
+
+// 并行销毁整棵树，要求rbtree_node_free是线程安全的（默认的delete是）
+void rbtree_parallel_destroy(t_ws_pool *pool, t_rbtree *tree) {
+    if (tree == nullptr)
+        return;
+
+    __rbtree_parallel_destroy(pool, tree->root, 0);
+    rbtree_init(tree);
+}
+
+// 检查红黑树的性质，返回黑高，不合法时返回-1
+static int __rbtree_check(t_rbtree_node *root) {
+    if (root == nil_node)
+        return 1;
+
+    if (root->color == RBTREE_CLR_RED &&
+        (root->left->color == RBTREE_CLR_RED || root->right->color == RBTREE_CLR_RED))
+        return -1;
+    if ((root->left != nil_node && root->left->key >= root->key) ||
+        (root->right != nil_node && root->right->key <= root->key))
+        return -1;
+
+    int left = __rbtree_check(root->left);
+    int right = __rbtree_check(root->right);
+    if (left < 0 || left != right)
+        return -1;
+
+    return left + (root->color == RBTREE_CLR_BLK);
+}
+
+// 其他文件可以直接#include本文件来复用线程池和并行构建，此时先定义RBTREE_PARALLEL_BUILD_NO_MAIN去掉下面的示例
+#ifndef RBTREE_PARALLEL_BUILD_NO_MAIN
+int main(int argc, char *argv[]) {
+    long long count = argc > 1 ? std::atoll(argv[1]) : 10000000;
+    int max_threads = argc > 2 ? std::atoi(argv[2]) : (int)std::thread::hardware_concurrency();
+
+    std::mt19937 rng(20260417);
+    vector<USER_KEY_TYPE> keys(count);
+    for (auto& key : keys) {
+        key = (USER_KEY_TYPE)(rng() & 0x7fffffff);
+    }
+
+    // 逐个插入作为基准，只插入前1/10，按比例估算
+    long long sample = count / 10;
+    t_rbtree tree = {};
+    rbtree_init(&tree);
+    auto start = std::chrono::steady_clock::now();
+    for (long long i = 0; i < sample; ++i) {
+        rbtree_insert(&tree, keys[i]);
+    }
+    double insert_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    rbtree_destroy(&tree);
+    std::printf("%lld keys, %u hardware threads\n", count, std::thread::hardware_concurrency());
+    std::printf("rbtree_insert loop (extrapolated from %lld keys): %.0f ms\n", sample, insert_ms * count / sample);
+
+    std::printf("%8s %10s %10s %10s %8s %11s\n", "threads", "sort ms", "build ms", "total ms", "valid", "destroy ms");
+    for (int threads = 1; threads <= std::max(1, max_threads); threads *= 2) {
+        t_ws_pool pool;
+        ws_pool_init(&pool, threads);
+
+        start = std::chrono::steady_clock::now();
+        vector<USER_KEY_TYPE> sorted;
+        parallel_sort_unique(&pool, keys, sorted, threads * 8);
+        auto middle = std::chrono::steady_clock::now();
+        rbtree_init(&tree);
+        rbtree_parallel_build_from_sorted(&pool, &tree, sorted.data(), sorted.size());
+        auto end = std::chrono::steady_clock::now();
+
+        int valid = tree.root->color == RBTREE_CLR_BLK && __rbtree_check(tree.root) > 0;
+        double sort_ms = std::chrono::duration<double, std::milli>(middle - start).count();
+        double build_ms = std::chrono::duration<double, std::milli>(end - middle).count();
+
+        start = std::chrono::steady_clock::now();
+        rbtree_parallel_destroy(&pool, &tree);
+        double destroy_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::printf("%8d %10.0f %10.0f %10.0f %8s %11.0f\n", threads, sort_ms, build_ms, sort_ms + build_ms,
+                    valid ? "yes" : "no", destroy_ms);
+        ws_pool_destroy(&pool);
+    }
+
+    return 0;
+}
+#endif
@@ -0,0 +1,231 @@
+/**
+ * @file red_black_tree_parallel_traversal.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 红黑树的并行中序遍历与并行聚合：按顶部几层把树拆成独立的子树，交给工作窃取线程池处理
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// 复用并行构建（以及其中的工作窃取调度器），同时用它快速构建测试用的大树
+#define RBTREE_PARALLEL_BUILD_NO_MAIN
+#include "red_black_tree_parallel_build.cpp"
+
+using std::vector;
+
+/*
+    inorder_traversal是单线程遍历，几亿个key的导出和全表聚合只能用一个核。红黑树的任意子树之间互不相交，而且
+按中序排列时，一棵子树的所有key连续地出现在结果中，所以可以把树在顶部几层切开：
+    1. 中序地遍历前split_depth层，深度小于split_depth的节点本身作为一个“单key片段”，深度恰好为split_depth的节点
+       作为一个“子树片段”，得到一个按中序排列的片段序列；红黑树的高度不超过2log(n+1)，各片段的大小虽然不完全相同，
+       但片段数远多于线程数时，工作窃取会把负载摊平；
+    2. 每个子树片段作为一个任务，各自把key写到自己的局部数组中（或者在局部做聚合）；
+    3. 有序导出：按片段的顺序对局部数组的长度求前缀和，得到每个片段在结果中的起始位置，再并行拷贝；
+       聚合：按片段的顺序合并各个局部结果，因此合并操作只需要满足结合律，不要求满足交换律。
+*/
+
+#define PARALLEL_PIECE_KEY     0
+#define PARALLEL_PIECE_SUBTREE 1
+
+typedef struct traversal_piece {
+    int type;
+    t_rbtree_node *node;
+} t_traversal_piece;
+
+static void __collect_pieces(t_rbtree_node *root, int depth, int split_depth, vector<t_traversal_piece>& pieces) {
+    if (root == nil_node)
+        return;
+
+    if (depth == split_depth) {
+        pieces.push_back({PARALLEL_PIECE_SUBTREE, root});
+        return;
+    }
+
+    __collect_pieces(root->left, depth + 1, split_depth, pieces);
+    pieces.push_back({PARALLEL_PIECE_KEY, root});
+    __collect_pieces(root->right, depth + 1, split_depth, pieces);
+}
+
+// 按线程数决定切分的深度，让片段数至少是线程数的8倍
+static void __split_tree(t_ws_pool *pool, t_rbtree *tree, vector<t_traversal_piece>& pieces) {
+    int split_depth = 0;
+    while ((1 << split_depth) < std::max(1, pool->workers) * 8) {
+        ++split_depth;
+    }
+
+    pieces.clear();
+    __collect_pieces(tree->root, 0, split_depth, pieces);
+}
+
+// 并行中序遍历，结果与inorder_traversal相同
+int rbtree_parallel_inorder(t_ws_pool *pool, t_rbtree *tree, vector<int>& result) {
+    if (pool == nullptr || tree == nullptr)
+        return -1;
+
+    vector<t_traversal_piece> pieces;
+    __split_tree(pool, tree, pieces);
+
+    vector<vector<int>> locals(pieces.size());
+    t_ws_group group = {{0}};
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        if (pieces[i].type == PARALLEL_PIECE_KEY) {
+            locals[i].push_back(pieces[i].node->key);
+            continue;
+        }
+
+        ws_spawn(pool, &group, [&locals, &pieces, i]() {
+            __rbtree_inorder_walk(pieces[i].node, [&](USER_KEY_TYPE key) {
+                locals[i].push_back(key);
+                return 0;
+            });
+        });
+    }
+    ws_wait(pool, &group);
+
+    vector<size_t> offsets(pieces.size() + 1, 0);
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        offsets[i + 1] = offsets[i] + locals[i].size();
+    }
+
+    size_t base = result.size();
+    result.resize(base + offsets.back());
+    ws_parallel_for(pool, pieces.size(), pool->workers * 4, [&](long long begin, long long end) {
+        for (long long i = begin; i < end; ++i) {
+            std::copy(locals[i].begin(), locals[i].end(), result.begin() + base + offsets[i]);
+            vector<int>().swap(locals[i]);
+        }
+    });
+
+    return 0;
+}
+
+/*
+    并行聚合：每个key先经过map变成T，再用combine按中序合并，identity是combine的单位元。
+    combine需要满足结合律：combine(combine(a, b), c) == combine(a, combine(b, c))。
+*/
+template <typename T, typename Map, typename Combine>
+T rbtree_parallel_reduce(t_ws_pool *pool, t_rbtree *tree, T identity, Map map, Combine combine) {
+    vector<t_traversal_piece> pieces;
+    __split_tree(pool, tree, pieces);
+
+    vector<T> partial(pieces.size(), identity);
+    t_ws_group group = {{0}};
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        if (pieces[i].type == PARALLEL_PIECE_KEY) {
+            partial[i] = map(pieces[i].node->key);
+            continue;
+        }
+
+        ws_spawn(pool, &group, [&, i]() {
+            T local = identity;
+            __rbtree_inorder_walk(pieces[i].node, [&](USER_KEY_TYPE key) {
+                local = combine(local, map(key));
+                return 0;
+            });
+            partial[i] = local;
+        });
+    }
+    ws_wait(pool, &group);
+
+    T result = identity;
+    for (auto& value : partial) {
+        result = combine(result, value);
+    }
+    return result;
+}
+
+// 演示用的聚合结果：个数、求和、最大的相邻间隔（依赖中序，体现了合并不需要交换律）
+typedef struct key_stats {
+    long long count;
+    long long sum;
+    long long first;
+    long long last;
+    long long max_gap;
+} t_key_stats;
+
+static t_key_stats stats_of(USER_KEY_TYPE key) {
+    return {1, key, key, key, 0};
+}
+
+static t_key_stats stats_combine(const t_key_stats& a, const t_key_stats& b) {
+    if (a.count == 0)
+        return b;
+    if (b.count == 0)
+        return a;
+
+    return {a.count + b.count, a.sum + b.sum, a.first, b.last,
+            std::max(std::max(a.max_gap, b.max_gap), b.first - a.last)};
+}
+
+int main(int argc, char *argv[]) {
+    long long count = argc > 1 ? std::atoll(argv[1]) : 20000000;
+    int max_threads = argc > 2 ? std::atoi(argv[2]) : (int)std::thread::hardware_concurrency();
+
+    vector<USER_KEY_TYPE> keys(count);
+    for (long long i = 0; i < count; ++i) {
+        keys[i] = (USER_KEY_TYPE)(i * 3 + (i % 7));
+    }
+
+    t_ws_pool builder;
+    ws_pool_init(&builder, std::max(1, max_threads));
+    t_rbtree tree = {};
+    rbtree_parallel_build_from_sorted(&builder, &tree, keys.data(), count);
+    ws_pool_destroy(&builder);
+    vector<USER_KEY_TYPE>().swap(keys);
+
+    // 单线程基准：不预留空间时vector在遍历中反复扩容，对比按tree.size一次分配好的缓冲区
+    vector<int> grown;
+    auto start = std::chrono::steady_clock::now();
+    rbtree_inorder_output(&tree, std::back_inserter(grown));
+    double grow_export = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    vector<int>().swap(grown);
+
+    start = std::chrono::steady_clock::now();
+    vector<int> expected(tree.size);
+    rbtree_inorder_copy(&tree, expected.data(), tree.size);
+    double serial_export = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    t_key_stats serial = {0, 0, 0, 0, 0};
+    __rbtree_inorder_walk(tree.root, [&](USER_KEY_TYPE key) {
+        serial = stats_combine(serial, stats_of(key));
+        return 0;
+    });
+    double serial_reduce = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("%lld keys, %u hardware threads\n", count, std::thread::hardware_concurrency());
+    std::printf("serial: export %.0f ms (growing vector %.0f ms), aggregate %.0f ms (sum %lld, max gap %lld)\n",
+                serial_export, grow_export, serial_reduce, serial.sum, serial.max_gap);
+    std::printf("%8s %12s %14s %8s\n", "threads", "export ms", "aggregate ms", "match");
+    for (int threads = 1; threads <= std::max(1, max_threads); threads *= 2) {
+        t_ws_pool pool;
+        ws_pool_init(&pool, threads);
+
+        vector<int> result;
+        start = std::chrono::steady_clock::now();
+        rbtree_parallel_inorder(&pool, &tree, result);
+        double export_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        t_key_stats stats = rbtree_parallel_reduce(&pool, &tree, t_key_stats{0, 0, 0, 0, 0}, stats_of, stats_combine);
+        double reduce_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        int match = result == expected && stats.count == serial.count && stats.sum == serial.sum &&
+                    stats.max_gap == serial.max_gap;
+        std::printf("%8d %12.0f %14.0f %8s\n", threads, export_ms, reduce_ms, match ? "yes" : "no");
+        ws_pool_destroy(&pool);
+    }
+
+    rbtree_destroy(&tree);
+    return 0;
+}
@@ -0,0 +1,384 @@
+/**
+ * @file red_black_tree_quantile.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 滑动窗口上的流式分位数：带子树权重的红黑树，插入、过期和按分位数查询都是O(log n)
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <random>
+#include <vector>
+
+using std::vector;
+
+typedef double USER_KEY_TYPE;       // 样本的取值，比如请求的延迟
+
+#define RBTREE_CLR_RED 0
+#define RBTREE_CLR_BLK 1
+#define RBTREE_CLR_DBL 2
+
+/*
+    对几千条序列分别计算最近N个样本（或最近T秒）的p50/p99。每次查询都把窗口拷出来排序是O(n log n)的，窗口一大就
+承受不了。
+
+    1. 顺序统计：每个节点记录子树的权重，即子树中所有样本的个数。从根往下走，比较目标排名和左子树的权重，就能在
+       O(log n)内找到排名第k的样本。权重与merkle树中的size一样，旋转之后先更新下沉的节点，再更新上浮的节点。
+    2. 重复的样本：延迟之类的指标取值大量重复，相同的取值只占一个节点，节点上记录出现的次数。插入已有的取值只是
+       次数加一，过期时次数减一，减到0才真正删除节点，树的大小是窗口中不同取值的个数，而不是样本数。
+    3. 滑动窗口：样本按到达顺序放在FIFO队列中，插入新样本之前先把超出窗口的旧样本从队首弹出并从树中扣掉。窗口可以
+       按个数（最近max_samples个）限制，也可以按时间（时间戳不早于now - max_age）限制，或者同时限制。
+    4. 分位数采用nearest-rank的定义：q分位数是排名为ceil(q * n)的样本（排名从1开始），q为0时取最小值。
+*/
+
+typedef struct rbtree_node {
+    USER_KEY_TYPE key;
+    int color;
+    struct rbtree_node *left;
+    struct rbtree_node *right;
+    long long count;            // 该取值出现的次数
+    long long weight;           // 子树中所有节点的count之和
+} t_rbtree_node;
+
+typedef struct rbtree {
+    t_rbtree_node *root;
+} t_rbtree;
+
+typedef struct quantile_sample {
+    USER_KEY_TYPE value;
+    int64_t ts;
+} t_quantile_sample;
+
+typedef struct quantile_window {
+    t_rbtree tree;
+    std::deque<t_quantile_sample> samples;      // 窗口中的样本，按到达顺序排列
+    long long max_samples;                      // 窗口中最多的样本数，0表示不限制
+    int64_t max_age;                            // 样本的最长保留时间，与时间戳同一单位，0表示不限制
+} t_quantile_window;
+
+t_rbtree_node __nil_node;
+
+#define nil_node (&__nil_node)
+
+__attribute__((constructor))
+void init_nil_node() {
+     __nil_node.key = 0;
+     __nil_node.color = RBTREE_CLR_BLK;
+     __nil_node.left = __nil_node.right = nil_node;
+     __nil_node.count = 0;
+     __nil_node.weight = 0;
+}
+
+// 根据两个孩子重新计算子树权重
+static void __quantile_update(t_rbtree_node *node) {
+    node->weight = node->left->weight + node->right->weight + node->count;
+}
+
+t_rbtree_node *rbtree_create_node(USER_KEY_TYPE key) {
+    t_rbtree_node *node = new t_rbtree_node;
+    node->key = key;
+    node->color = RBTREE_CLR_RED;
+    node->left = node->right = nil_node;
+    node->count = 1;
+    __quantile_update(node);
+
+    return node;
+}
+
+void __rbtree_destroy(t_rbtree_node *root) {
+    if (root == nil_node)
+        return;
+
+    __rbtree_destroy(root->left);
+    __rbtree_destroy(root->right);
+    delete root;
+}
+
+// 旋转和插入、删除调整来自red_black_tree_augmented.cpp，旋转之后用__quantile_update重新计算子树权重
+#define RBTREE_AUGMENT_UPDATE(node) __quantile_update(node)
+#include "red_black_tree_augmented.cpp"
+
+// 取值已存在时只增加次数
+t_rbtree_node *__rbtree_insert(t_rbtree_node *root, USER_KEY_TYPE key) {
+    if (root == nil_node)
+        return rbtree_create_node(key);
+
+    if (key == root->key) {
+        root->count++;
+    } else if (key < root->key) {
+        root->left = __rbtree_insert(root->left, key);
+    } else {
+        root->right = __rbtree_insert(root->right, key);
+    }
+
+    __quantile_update(root);
+    return rbtree_insert_maintian(root);
+}
+
+void rbtree_insert(t_rbtree *tree, USER_KEY_TYPE key) {
+    if (tree == nullptr)
+        return;
+
+    tree->root = __rbtree_insert(tree->root, key);
+    tree->root->color = RBTREE_CLR_BLK;
+}
+
+// 把key的次数减一，减到0时删除节点；whole_node为1时不管次数直接删除节点。key不存在时不做任何事
+t_rbtree_node *__rbtree_erase(t_rbtree_node *root, USER_KEY_TYPE key, int whole_node) {
+    if (root == nil_node)
+        return nil_node;
+
+    if (key < root->key) {
+        root->left = __rbtree_erase(root->left, key, whole_node);
+    } else if (key > root->key) {
+        root->right = __rbtree_erase(root->right, key, whole_node);
+    } else if (!whole_node && root->count > 1) {
+        root->count--;
+    } else {
+        if (root->left == nil_node || root->right == nil_node) {
+            t_rbtree_node *child = (root->left != nil_node ? root->left : root->right);
+            child->color += root->color;
+            delete root;
+
+            return child;
+        }
+
+        // 前驱节点连同它的次数一起搬上来，再把前驱节点整个删掉
+        t_rbtree_node *prev_node = root->left;
+        while (prev_node->right != nil_node) {
+            prev_node = prev_node->right;
+        }
+        root->key = prev_node->key;
+        root->count = prev_node->count;
+        root->left = __rbtree_erase(root->left, prev_node->key, 1);
+    }
+
+    __quantile_update(root);
+    return __rbtree_erase_maintain(root);
+}
+
+void rbtree_erase(t_rbtree *tree, USER_KEY_TYPE key) {
+    if (tree == nullptr)
+        return;
+
+    tree->root = __rbtree_erase(tree->root, key, 0);
+    tree->root->color = RBTREE_CLR_BLK;
+}
+
+// 返回排名为rank的样本（从1开始），调用者保证1 <= rank <= 样本总数
+static USER_KEY_TYPE __rbtree_select(t_rbtree_node *root, long long rank) {
+    while (true) {
+        if (rank <= root->left->weight) {
+            root = root->left;
+        } else if (rank <= root->left->weight + root->count) {
+            return root->key;
+        } else {
+            rank -= root->left->weight + root->count;
+            root = root->right;
+        }
+    }
+}
+
+/* ---------------------------------- 滑动窗口 --------------------------------- */
+
+void quantile_window_init(t_quantile_window *window, long long max_samples, int64_t max_age) {
+    window->tree.root = nil_node;
+    window->samples.clear();
+    window->max_samples = max_samples;
+    window->max_age = max_age;
+}
+
+void quantile_window_destroy(t_quantile_window *window) {
+    if (window == nullptr)
+        return;
+
+    __rbtree_destroy(window->tree.root);
+    quantile_window_init(window, window->max_samples, window->max_age);
+}
+
+static void __quantile_pop(t_quantile_window *window) {
+    rbtree_erase(&window->tree, window->samples.front().value);
+    window->samples.pop_front();
+}
+
+// 弹出时间戳早于now - max_age的样本，返回弹出的个数
+long long quantile_expire(t_quantile_window *window, int64_t now) {
+    if (window == nullptr || window->max_age <= 0)
+        return 0;
+
+    long long expired = 0;
+    while (!window->samples.empty() && window->samples.front().ts < now - window->max_age) {
+        __quantile_pop(window);
+        ++expired;
+    }
+    return expired;
+}
+
+/*
+    加入一个样本，ts应当单调不减；先按时间和个数把过期的样本弹出。成功返回0。
+    NaN与任何值比较都是false，插入时会被当成一个新的节点挂在最右侧，过期时却永远找不到它，树的权重就会和窗口中的
+样本数对不上，因此NaN直接拒绝，返回-1。
+*/
+int quantile_insert(t_quantile_window *window, USER_KEY_TYPE value, int64_t ts) {
+    if (window == nullptr || std::isnan(value))
+        return -1;
+
+    quantile_expire(window, ts);
+    if (window->max_samples > 0 && (long long)window->samples.size() >= window->max_samples) {
+        __quantile_pop(window);
+    }
+
+    rbtree_insert(&window->tree, value);
+    window->samples.push_back({value, ts});
+    return 0;
+}
+
+// 窗口中的样本数
+long long quantile_count(t_quantile_window *window) {
+    return window == nullptr ? 0 : window->tree.root->weight;
+}
+
+// q分位数（0 <= q <= 1），窗口为空时返回NAN
+USER_KEY_TYPE quantile_query(t_quantile_window *window, double q) {
+    long long total = quantile_count(window);
+    if (total == 0)
+        return NAN;
+
+    long long rank = (long long)std::ceil(q * total);
+    rank = std::min(std::max(rank, 1LL), total);
+    return __rbtree_select(window->tree.root, rank);
+}
+
+// 检查红黑树的性质和子树权重，返回黑高，不合法时返回-1
+static int __quantile_check(t_rbtree_node *root) {
+    if (root == nil_node)
+        return 1;
+    if (root->count <= 0 || root->weight != root->left->weight + root->right->weight + root->count)
+        return -1;
+    if (root->color == RBTREE_CLR_RED && has_red_child_node(root))
+        return -1;
+    if ((root->left != nil_node && root->left->key >= root->key) ||
+        (root->right != nil_node && root->right->key <= root->key))
+        return -1;
+
+    int left = __quantile_check(root->left);
+    int right = __quantile_check(root->right);
+    if (left < 0 || left != right)
+        return -1;
+
+    return left + (root->color == RBTREE_CLR_BLK);
+}
+
+/* ---------------------------------- 性能对比 --------------------------------- */
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 对照组：把窗口拷出来，用nth_element选出nearest-rank的分位数
+static USER_KEY_TYPE copy_select_quantile(const std::deque<t_quantile_sample>& samples, double q,
+                                          vector<USER_KEY_TYPE>& buffer) {
+    buffer.clear();
+    for (auto& sample : samples) {
+        buffer.push_back(sample.value);
+    }
+    long long total = buffer.size();
+    long long rank = std::min(std::max((long long)std::ceil(q * total), 1LL), total);
+    std::nth_element(buffer.begin(), buffer.begin() + (rank - 1), buffer.end());
+    return buffer[rank - 1];
+}
+
+int main(int argc, char *argv[]) {
+    int series = argc > 1 ? std::atoi(argv[1]) : 2000;
+    long long window_size = argc > 2 ? std::atoll(argv[2]) : 10000;
+    long long rounds = argc > 3 ? std::atoll(argv[3]) : 20000;
+
+    // 每条序列保留最近window_size个样本，同时不超过60秒；每轮给随机一条序列写入一个样本，每写入16个样本查询一次
+    // p50和p99。延迟按0.1ms取整，服从对数正态分布，取值大量重复
+    const int64_t max_age = 60 * 1000;
+    std::mt19937_64 rng(20260417);
+    std::lognormal_distribution<double> latency(1.0, 0.8);
+    vector<t_quantile_window> windows(series);
+    for (auto& window : windows) {
+        quantile_window_init(&window, window_size, max_age);
+    }
+
+    // 先把每条序列的窗口填满
+    int64_t now = 0;
+    for (int s = 0; s < series; ++s) {
+        for (long long i = 0; i < window_size; ++i) {
+            quantile_insert(&windows[s], std::round(latency(rng) * 10) / 10, now);
+        }
+    }
+
+    vector<int> targets(rounds);
+    vector<USER_KEY_TYPE> values(rounds);
+    for (long long i = 0; i < rounds; ++i) {
+        targets[i] = rng() % series;
+        values[i] = std::round(latency(rng) * 10) / 10;
+    }
+
+    long long queries = 0, mismatches = 0;
+    double tree_ms = 0, copy_ms = 0;
+    vector<USER_KEY_TYPE> buffer;
+    for (long long i = 0; i < rounds; ++i) {
+        t_quantile_window *window = &windows[targets[i]];
+        now += 3;
+
+        auto start = std::chrono::steady_clock::now();
+        quantile_insert(window, values[i], now);
+        USER_KEY_TYPE p50 = 0, p99 = 0;
+        if (i % 16 == 0) {
+            p50 = quantile_query(window, 0.5);
+            p99 = quantile_query(window, 0.99);
+        }
+        tree_ms += elapsed_ms(start);
+
+        if (i % 16 == 0) {
+            start = std::chrono::steady_clock::now();
+            USER_KEY_TYPE expected50 = copy_select_quantile(window->samples, 0.5, buffer);
+            USER_KEY_TYPE expected99 = copy_select_quantile(window->samples, 0.99, buffer);
+            copy_ms += elapsed_ms(start);
+
+            mismatches += (p50 != expected50) + (p99 != expected99);
+            queries += 2;
+        }
+    }
+
+    long long distinct = 0, samples = 0, broken = 0;
+    for (auto& window : windows) {
+        samples += quantile_count(&window);
+        broken += window.tree.root->color != RBTREE_CLR_BLK || __quantile_check(window.tree.root) < 0;
+        vector<t_rbtree_node *> stack = {window.tree.root};
+        while (!stack.empty()) {
+            t_rbtree_node *node = stack.back();
+            stack.pop_back();
+            if (node == nil_node)
+                continue;
+            ++distinct;
+            stack.push_back(node->left);
+            stack.push_back(node->right);
+        }
+    }
+
+    std::printf("%d series x %lld samples, %lld samples in windows, %.1f samples per tree node\n", series, window_size,
+                samples, (double)samples / std::max(1LL, distinct));
+    std::printf("%lld inserts, %lld quantile queries, %lld mismatches, %lld broken trees\n", rounds, queries, mismatches,
+                broken);
+    std::printf("order-statistic tree: %.2f us per insert+query round\n", tree_ms * 1e3 / rounds);
+    std::printf("copy + nth_element:   %.2f us per query\n", copy_ms * 1e3 / std::max(1LL, queries));
+
+    for (auto& window : windows) {
+        quantile_window_destroy(&window);
+    }
+    return 0;
+}
@@ -10,6 +10,7 @@
  */
 
 #include <cstdio>
+#include <malloc.h>
 #include <vector>
 
 using std::vector;
@@ -29,13 +30,51 @@ typedef struct rbtree_node {
 
 typedef struct rbtree {
     t_rbtree_node *root;
+    long long size;         // 节点个数，由插入、删除维护；直接构建树的代码（比如批量构建）需要自己设置
 } t_rbtree;
 
 t_rbtree_node __nil_node;
 
 #define nil_node (&__nil_node)
 
-#define SAFE_DELETE_NODE(node) {if (node) { delete node; node = nullptr; }}
+// 节点的分配和释放函数，默认直接使用new/delete；其他文件可以把它们替换成自己的内存池，必须在创建任何节点之前替换
+t_rbtree_node *rbtree_default_node_alloc() { return new t_rbtree_node; }
+void rbtree_default_node_free(t_rbtree_node *node) { delete node; }
+
+t_rbtree_node *(*rbtree_node_alloc)() = rbtree_default_node_alloc;
+void (*rbtree_node_free)(t_rbtree_node *node) = rbtree_default_node_free;
+
+/*
+    每个节点实际占用的字节数：节点本身加上分配器的额外开销，rbtree_memory_usage按它计算整棵树的内存。
+    默认值是按glibc malloc的布局估算的：malloc_usable_size是块中可用的字节数，已经包含了对齐填充，再加上glibc在
+每个块前放的8字节块头，24字节的节点按16字节对齐后实际占用32字节。这只是估计值，jemalloc、tcmalloc等分配器的块头
+和大小分级都不同，换用它们时结果会有偏差。
+    替换rbtree_node_alloc时应当一并设置，比如从内存池中连续切分节点时就是sizeof(t_rbtree_node)。
+*/
+size_t rbtree_default_node_footprint() {
+    t_rbtree_node *node = rbtree_default_node_alloc();
+    size_t footprint = malloc_usable_size(node) + sizeof(size_t);
+    rbtree_default_node_free(node);
+    return footprint;
+}
+
+size_t rbtree_node_footprint = rbtree_default_node_footprint();
+
+#define SAFE_DELETE_NODE(node) {if (node) { rbtree_node_free(node); node = nullptr; }}
+
+// 包含本文件之前定义RBTREE_COUNT_FIXUPS，可以统计插入和删除调整中旋转、变色和双黑上移的次数；默认不统计，没有额外开销
+#ifdef RBTREE_COUNT_FIXUPS
+typedef struct rbtree_fixup_stats {
+    long long rotations;
+    long long recolors;         // 不伴随旋转的变色：插入时的红色上浮，删除时兄弟变红、父节点加一重黑
+    long long dbl_pushups;      // 双黑节点向上移动的层数
+} t_rbtree_fixup_stats;
+
+t_rbtree_fixup_stats rbtree_fixup_stats;
+#define RBTREE_COUNT_FIXUP(field) (++rbtree_fixup_stats.field)
+#else
+#define RBTREE_COUNT_FIXUP(field) ((void)0)
+#endif
 
 __attribute__((constructor))
 void init_nil_node() {
@@ -45,7 +84,39 @@ void init_nil_node() {
 }
 
 t_rbtree_node *rbtree_create_node(USER_KEY_TYPE key) {
-    t_rbtree_node *node = new t_rbtree_node;
+    t_rbtree_node *node = rbtree_node_alloc();
+    if (node == nullptr) {
+        return nullptr;
+    }
+
+    node->key = key;
+    node->color = RBTREE_CLR_RED;
+    node->left = node->right = nil_node;
+
+    return node;
+}
+
+/*
+    线程局部、按树区分的节点来源：当前线程设置了它，并且正在插入删除的正是它指定的树时，__rbtree_insert和
+__rbtree_erase从它分配和回收节点；其他线程、其他树仍然使用rbtree_node_alloc/rbtree_node_free。需要临时接管某一棵树
+的节点（比如事务提交时从事务预留的节点中分配）时用它，不要替换全局的函数指针。
+*/
+typedef struct rbtree_node_source {
+    t_rbtree *tree;
+    void *context;
+    t_rbtree_node *(*alloc)(void *context);
+    void (*free)(void *context, t_rbtree_node *node);
+} t_rbtree_node_source;
+
+thread_local t_rbtree_node_source *rbtree_node_source = nullptr;
+
+// 为指定的树创建节点，优先使用当前线程为这棵树设置的节点来源
+t_rbtree_node *__rbtree_create_node(t_rbtree *tree, USER_KEY_TYPE key) {
+    t_rbtree_node_source *source = rbtree_node_source;
+    if (source == nullptr || source->tree != tree)
+        return rbtree_create_node(key);
+
+    t_rbtree_node *node = source->alloc(source->context);
     if (node == nullptr) {
         return nullptr;
     }
@@ -57,6 +128,16 @@ t_rbtree_node *rbtree_create_node(USER_KEY_TYPE key) {
     return node;
 }
 
+// 释放指定树中的节点，与__rbtree_create_node对应
+void __rbtree_free_node(t_rbtree *tree, t_rbtree_node *node) {
+    t_rbtree_node_source *source = rbtree_node_source;
+    if (source == nullptr || source->tree != tree) {
+        rbtree_node_free(node);
+    } else {
+        source->free(source->context, node);
+    }
+}
+
 // 销毁以指定节点为根节点的子树
 void __rbtree_destroy(t_rbtree_node *root) {
     if (root == nil_node) 
@@ -67,12 +148,32 @@ void __rbtree_destroy(t_rbtree_node *root) {
     SAFE_DELETE_NODE(root);
 }
 
-// 销毁整棵树
+// 初始化为空树
+void rbtree_init(t_rbtree *tree) {
+    tree->root = nil_node;
+    tree->size = 0;
+}
+
+// 销毁整棵树，之后tree是一棵空树，可以继续使用
 void rbtree_destroy(t_rbtree *tree) {
     if (tree == nullptr) 
         return;
 
     __rbtree_destroy(tree->root);
+    rbtree_init(tree);
+}
+
+// 节点个数，O(1)
+long long rbtree_size(t_rbtree *tree) {
+    return tree == nullptr ? 0 : tree->size;
+}
+
+// 整棵树占用的内存字节数（树本身加上所有节点），O(1)
+size_t rbtree_memory_usage(t_rbtree *tree) {
+    if (tree == nullptr)
+        return 0;
+
+    return sizeof(t_rbtree) + tree->size * rbtree_node_footprint;
 }
 
 int has_red_child_node(t_rbtree_node *node) {
@@ -88,6 +189,7 @@ t_rbtree_node *rbtree_left_rotate(t_rbtree_node *up) {
     t_rbtree_node *down = up->right;
     up->right = down->left;
     down->left = up;
+    RBTREE_COUNT_FIXUP(rotations);
 
     return down;
 }
@@ -97,6 +199,7 @@ t_rbtree_node *rbtree_right_rotate(t_rbtree_node *up) {
     t_rbtree_node *down = up->left;
     up->left = down->right;
     down->right = up;
+    RBTREE_COUNT_FIXUP(rotations);
 
     return down;
 }
@@ -115,6 +218,7 @@ t_rbtree_node *rbtree_insert_maintian(t_rbtree_node *root) {
     if (root->left->color == RBTREE_CLR_RED && root->right->color == RBTREE_CLR_RED) {
         root->color = RBTREE_CLR_RED;
         root->left->color = root->right->color = RBTREE_CLR_BLK;
+        RBTREE_COUNT_FIXUP(recolors);
 
         return root;
     }
@@ -151,32 +255,63 @@ t_rbtree_node *rbtree_insert_maintian(t_rbtree_node *root) {
     return root;
 }
 
-// 插入新节点，返回根节点
-t_rbtree_node *__rbtree_insert(t_rbtree_node *root, USER_KEY_TYPE key) {
-    if (root == nil_node)
-        return rbtree_create_node(key);
+// 插入新节点，返回根节点。key已存在时*ret置为1；分配节点失败时返回原来的nil，子树不变，*ret置为-2
+t_rbtree_node *__rbtree_insert(t_rbtree *tree, t_rbtree_node *root, USER_KEY_TYPE key, int *ret) {
+    if (root == nil_node) {
+        t_rbtree_node *node = __rbtree_create_node(tree, key);
+        if (node == nullptr) {
+            *ret = -2;
+            return nil_node;
+        }
+
+        ++tree->size;
+        return node;
+    }
 
     // 插入的点有重复，不进行重复插入
-    if (root->key == key) 
+    if (root->key == key) {
+        *ret = 1;
         return root;
+    }
 
     if (key < root->key) {
-        root->left = __rbtree_insert(root->left, key);
+        root->left = __rbtree_insert(tree, root->left, key, ret);
     } else {
-        root->right = __rbtree_insert(root->right, key);
+        root->right = __rbtree_insert(tree, root->right, key, ret);
     }
 
     // 插入调整应该发生在回溯的过程中
     return rbtree_insert_maintian(root);
 }
 
-// 向树中插入新节点
-void rbtree_insert(t_rbtree *tree, USER_KEY_TYPE key) {
+/*
+    向树中插入新节点，返回值与insert_node_to_bstree相同：成功返回0，key已存在返回1，tree为空返回-1，分配节点失败
+返回-2。rbtree_node_alloc可以被替换成会失败的内存池，失败时树保持原样，回溯路径上的调整不会破坏红黑树的性质。
+*/
+int rbtree_insert(t_rbtree *tree, USER_KEY_TYPE key) {
     if (tree == nullptr) 
-        return;
+        return -1;
     
-    tree->root = __rbtree_insert(tree->root, key);
+    int ret = 0;
+    tree->root = __rbtree_insert(tree, tree->root, key, &ret);
     tree->root->color = RBTREE_CLR_BLK;
+    return ret;
+}
+
+// 查找指定key的节点，找不到时返回nullptr
+t_rbtree_node *rbtree_find(t_rbtree *tree, USER_KEY_TYPE key) {
+    if (tree == nullptr)
+        return nullptr;
+
+    t_rbtree_node *cursor = tree->root;
+    while (cursor != nil_node) {
+        if (key == cursor->key)
+            return cursor;
+
+        cursor = (key < cursor->key ? cursor->left : cursor->right);
+    }
+
+    return nullptr;
 }
 
 // 返回指定节点的前驱节点
@@ -274,6 +409,10 @@ t_rbtree_node *__rbtree_erase_maintain(t_rbtree_node *root) {
         root->right->color -= RBTREE_CLR_BLK;
 
         root->color += RBTREE_CLR_BLK;
+        RBTREE_COUNT_FIXUP(recolors);
+        if (root->color == RBTREE_CLR_DBL) {
+            RBTREE_COUNT_FIXUP(dbl_pushups);
+        }
         
         // 注意删除调整时站在父节点上看，此时虽然当前的root是双重黑节点了，但是它自己处理不了，需要让他的父节点进行处理
         // 因此直接返回当前的根节点位置即可，如果此时已经是整棵树的全局根节点了，也没事儿，最外层会强制把根节点变为一重黑
@@ -317,14 +456,14 @@ t_rbtree_node *__rbtree_erase_maintain(t_rbtree_node *root) {
 }
 
 // 给定树的根节点，删除指定key的节点，并返回指向当前根节点的指针
-t_rbtree_node *__rbtree_erase(t_rbtree_node *root, USER_KEY_TYPE key) {
+t_rbtree_node *__rbtree_erase(t_rbtree *tree, t_rbtree_node *root, USER_KEY_TYPE key) {
     if (root == nil_node) // 如果为空节点，则当前没有想要删除的节点的值
         return nil_node;
     
     if (key < root->key) {
-        root->left = __rbtree_erase(root->left, key);
+        root->left = __rbtree_erase(tree, root->left, key);
     } else if (key > root->key) {
-        root->right = __rbtree_erase(root->right, key);
+        root->right = __rbtree_erase(tree, root->right, key);
     } else {
         // 存在要删除的节点，且当前节点即为要删除的节点 
         // 先处理度为0或者度为1的节点
@@ -343,7 +482,8 @@ t_rbtree_node *__rbtree_erase(t_rbtree_node *root, USER_KEY_TYPE key) {
             //             child                   child
             //             /   \                    /   \
             //            n1   n2                  n1   n2
-            SAFE_DELETE_NODE(root);
+            __rbtree_free_node(tree, root);
+            --tree->size;
 
             // 删除当前节点root后，child变为了树的根节点了
             return child;
@@ -355,7 +495,7 @@ t_rbtree_node *__rbtree_erase(t_rbtree_node *root, USER_KEY_TYPE key) {
         root->key = prev_node->key;
         
         // 由于前驱节点在当前节点的左子树中，所以流程转为在当前节点的左子树中删除值为key的节点
-        root->left = __rbtree_erase(root->left, prev_node->key);
+        root->left = __rbtree_erase(tree, root->left, prev_node->key);
     }
 
     // 维护红黑树是在回溯期间发生的
@@ -367,36 +507,95 @@ void rbtree_erase(t_rbtree *tree, USER_KEY_TYPE key) {
     if (tree == nullptr) 
         return;
 
-    tree->root = __rbtree_erase(tree->root, key);
+    tree->root = __rbtree_erase(tree, tree->root, key);
     tree->root->color = RBTREE_CLR_BLK;
 }
 
-// 中序遍历的内部封装函数
-void __inorder_traversal(t_rbtree_node *root, vector<int>& result) {
-    if (root == nil_node) {
-        return;
+/*
+    中序遍历的输出方式：
+    1. rbtree_inorder_copy：写入调用者提供的缓冲区，按tree->size分配缓冲区就能放下所有的key，遍历过程中不会分配内存；
+    2. rbtree_inorder_output：写入任意的输出迭代器，比如指向预先分配好的数组，或者写文件的迭代器；
+    3. rbtree_inorder_visit：流式回调，每个key调用一次，回调返回非0时提前结束，适合边遍历边发送/写盘，不需要缓冲全部结果；
+    4. inorder_traversal：追加到vector中，先按tree->size一次性reserve，不会在遍历中反复扩容和拷贝。
+    遍历使用显式栈，而不是递归。红黑树的高度不超过2log(n+1)，128层的栈足够任何规模的树使用。
+*/
+#define RBTREE_MAX_HEIGHT 128
+
+// 中序遍历以root为根的子树，对每个key调用visit(key)，visit返回非0时停止；返回访问过的key的个数
+template <typename Visit>
+long long __rbtree_inorder_walk(t_rbtree_node *root, Visit&& visit) {
+    t_rbtree_node *stack[RBTREE_MAX_HEIGHT];
+    int top = 0;
+    long long visited = 0;
+    t_rbtree_node *cursor = root;
+    while (cursor != nil_node || top > 0) {
+        while (cursor != nil_node) {
+            stack[top++] = cursor;
+            cursor = cursor->left;
+        }
+
+        cursor = stack[--top];
+        ++visited;
+        if (visit(cursor->key))
+            break;
+        cursor = cursor->right;
     }
 
-    __inorder_traversal(root->left, result);
-    result.emplace_back(root->key);
-    __inorder_traversal(root->right, result);
+    return visited;
+}
+
+// 把最多capacity个key按序写入out，返回写入的个数
+long long rbtree_inorder_copy(t_rbtree *tree, USER_KEY_TYPE *out, long long capacity) {
+    if (nullptr == tree || capacity <= 0)
+        return 0;
+
+    long long written = 0;
+    __rbtree_inorder_walk(tree->root, [&](USER_KEY_TYPE key) {
+        out[written++] = key;
+        return written == capacity;
+    });
+    return written;
+}
+
+// 按序写入输出迭代器，返回写完之后的迭代器
+template <typename OutputIt>
+OutputIt rbtree_inorder_output(t_rbtree *tree, OutputIt out) {
+    if (nullptr == tree)
+        return out;
+
+    __rbtree_inorder_walk(tree->root, [&](USER_KEY_TYPE key) {
+        *out++ = key;
+        return 0;
+    });
+    return out;
+}
+
+// 对每个key调用visit(key, ctx)，visit返回非0时提前结束；返回回调的次数
+long long rbtree_inorder_visit(t_rbtree *tree, int (*visit)(USER_KEY_TYPE key, void *ctx), void *ctx) {
+    if (nullptr == tree || nullptr == visit)
+        return 0;
+
+    return __rbtree_inorder_walk(tree->root, [&](USER_KEY_TYPE key) { return visit(key, ctx); });
 }
 
 int inorder_traversal(t_rbtree *tree, vector<int>& result) {
     if (nullptr == tree)
         return -1;
     
-    __inorder_traversal(tree->root, result);
+    result.reserve(result.size() + tree->size);
+    rbtree_inorder_output(tree, std::back_inserter(result));
     return 0;
 }
 
+// 其他文件可以直接#include本文件来复用红黑树的实现，此时先定义RBTREE_NO_MAIN去掉下面的示例
+#ifndef RBTREE_NO_MAIN
 int main() {
     // 因为有重复的，所以只保存一遍，共10个不重复元素
     int nums[] = {12,31,24,5,12,5,34,9,2985,324,5,69,8};
     int len = sizeof(nums) / sizeof(int);
 
-    t_rbtree tree = {0};
-    tree.root = nil_node;
+    t_rbtree tree = {};
+    rbtree_init(&tree);
 
     for (int i = 0; i < len; ++i) {
         rbtree_insert(&tree, nums[i]);
@@ -422,6 +621,11 @@ int main() {
         std::printf("%d ", key);
     }
     std::printf("\n");
+    std::printf("size %lld, %zu bytes (%zu bytes per node)\n", rbtree_size(&tree), rbtree_memory_usage(&tree),
+                rbtree_node_footprint);
+
+    rbtree_destroy(&tree);
 
     return 0;
-}
\ No newline at end of file
+}
+#endif
@@ -0,0 +1,353 @@
+/**
+ * @file red_black_tree_replication.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 红黑树的本机复制：主进程把每次插入删除记成二进制日志，通过Unix域套接字推送给只读副本进程
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <random>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#define RBTREE_NO_MAIN
+#include "red_black_tree_recursion.cpp"
+
+using std::vector;
+
+/*
+    同一台机器上开几个只读副本分担查找，每个副本都从完整的dump重建代价太大。主进程（leader）改为记录操作日志：
+    1. 每次rbtree_insert/rbtree_erase都追加一条5字节的记录（1字节操作类型 + 4字节key）到内存中的日志里，日志中
+       第i条记录的序号就是i；
+    2. 副本（follower）连接到leader的Unix域套接字后，先告诉leader自己已经应用到了哪个序号，leader从这个位置开始
+       推送日志；副本断线重连时不需要从头来过。这8字节同样用非阻塞的read接收，可能分几次才收齐，收齐之前连接只处于
+       握手状态，不会收到日志；
+    3. leader用非阻塞的send推送，每个副本记录自己已经发送到日志的哪个字节，慢的副本不会阻塞leader，只是落后；
+       send可能只发出半条记录，副本按5字节重新拼接；
+    4. 副本每次尽量多读，读到的所有完整记录作为一批一起应用，批与批之间处理自己的查找请求。
+    日志保存在leader的内存中，副本落后再多也能追上；实际使用时可以在所有副本都确认之后截断日志的前缀。
+*/
+
+#define REPL_OP_INSERT 1
+#define REPL_OP_ERASE  2
+
+typedef struct __attribute__((packed)) repl_record {
+    uint8_t op;
+    int32_t key;
+} t_repl_record;
+
+typedef struct repl_follower_conn {
+    int fd;
+    size_t sent;            // 已经发送到日志的第几个字节
+} t_repl_follower_conn;
+
+// 还没有收齐起始序号的连接
+typedef struct repl_handshake {
+    int fd;
+    uint64_t start_seq;
+    size_t received;        // 已经收到起始序号的几个字节
+} t_repl_handshake;
+
+typedef struct repl_leader {
+    t_rbtree tree;
+    int listen_fd;
+    vector<char> log;
+    vector<t_repl_handshake> handshakes;
+    vector<t_repl_follower_conn> followers;
+} t_repl_leader;
+
+// 在path上监听，成功返回0
+int repl_leader_init(t_repl_leader *leader, const char *path) {
+    rbtree_init(&leader->tree);
+    leader->log.clear();
+    leader->handshakes.clear();
+    leader->followers.clear();
+
+    leader->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (leader->listen_fd < 0)
+        return -1;
+
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    unlink(path);
+    if (bind(leader->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(leader->listen_fd, 16) != 0) {
+        close(leader->listen_fd);
+        return -2;
+    }
+
+    return 0;
+}
+
+static void __repl_append(t_repl_leader *leader, uint8_t op, USER_KEY_TYPE key) {
+    t_repl_record record = {op, key};
+    const char *bytes = (const char *)&record;
+    leader->log.insert(leader->log.end(), bytes, bytes + sizeof(record));
+}
+
+void repl_insert(t_repl_leader *leader, USER_KEY_TYPE key) {
+    rbtree_insert(&leader->tree, key);
+    __repl_append(leader, REPL_OP_INSERT, key);
+}
+
+void repl_erase(t_repl_leader *leader, USER_KEY_TYPE key) {
+    rbtree_erase(&leader->tree, key);
+    __repl_append(leader, REPL_OP_ERASE, key);
+}
+
+/*
+    接收新连接的副本，副本连接后首先发送8字节的起始序号。accept出来的套接字不会继承监听套接字的O_NONBLOCK，
+这里用accept4直接设置，再用非阻塞的read在多次flush之间拼接这8个字节，收齐并校验通过后才加入followers。
+*/
+static void __repl_accept(t_repl_leader *leader) {
+    int fd;
+    while ((fd = accept4(leader->listen_fd, nullptr, nullptr, SOCK_NONBLOCK)) >= 0) {
+        leader->handshakes.push_back({fd, 0, 0});
+    }
+
+    for (size_t i = 0; i < leader->handshakes.size();) {
+        t_repl_handshake *handshake = &leader->handshakes[i];
+        ssize_t n = read(handshake->fd, (char *)&handshake->start_seq + handshake->received,
+                         sizeof(handshake->start_seq) - handshake->received);
+        if (n > 0) {
+            handshake->received += n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            ++i;
+            continue;
+        }
+
+        // 对端关闭、出错，或者起始序号超出了日志的范围
+        if (n <= 0 || (handshake->received == sizeof(handshake->start_seq) &&
+                       handshake->start_seq > leader->log.size() / sizeof(t_repl_record))) {
+            close(handshake->fd);
+            leader->handshakes.erase(leader->handshakes.begin() + i);
+            continue;
+        }
+
+        if (handshake->received == sizeof(handshake->start_seq)) {
+            leader->followers.push_back({handshake->fd, handshake->start_seq * sizeof(t_repl_record)});
+            leader->handshakes.erase(leader->handshakes.begin() + i);
+            continue;
+        }
+    }
+}
+
+/*
+    接收新的副本，并把日志中还没有发送的部分推送给每个副本，不会阻塞。
+    返回还有多少字节没有发出去（所有副本之和），出错的副本会被断开。
+*/
+size_t repl_leader_flush(t_repl_leader *leader) {
+    __repl_accept(leader);
+
+    size_t pending = 0;
+    for (size_t i = 0; i < leader->followers.size();) {
+        t_repl_follower_conn *conn = &leader->followers[i];
+        while (conn->sent < leader->log.size()) {
+            ssize_t n = send(conn->fd, leader->log.data() + conn->sent, leader->log.size() - conn->sent,
+                             MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (n <= 0)
+                break;
+
+            conn->sent += n;
+        }
+
+        if (conn->sent < leader->log.size() && errno != EAGAIN && errno != EWOULDBLOCK) {
+            close(conn->fd);
+            leader->followers.erase(leader->followers.begin() + i);
+            continue;
+        }
+
+        pending += leader->log.size() - conn->sent;
+        ++i;
+    }
+
+    return pending;
+}
+
+/* ---------------------------------- 副本 ---------------------------------- */
+
+typedef struct repl_follower {
+    t_rbtree tree;
+    int fd;
+    uint64_t applied;       // 已经应用的记录个数，也就是下一条记录的序号
+    long long batches;
+    char buffer[64 * 1024];
+    size_t buffered;        // buffer中还没凑够一条记录的字节数
+} t_repl_follower;
+
+// 连接leader，并从序号applied开始接收日志，成功返回0
+int repl_follower_connect(t_repl_follower *follower, const char *path) {
+    follower->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (follower->fd < 0)
+        return -1;
+
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    if (connect(follower->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        write(follower->fd, &follower->applied, sizeof(follower->applied)) != sizeof(follower->applied)) {
+        close(follower->fd);
+        return -2;
+    }
+
+    follower->buffered = 0;
+    return 0;
+}
+
+/*
+    读一次套接字，把读到的所有完整记录作为一批应用到副本的树上。
+    返回本批应用的记录数；leader关闭连接返回-1。
+*/
+long long repl_follower_poll(t_repl_follower *follower) {
+    ssize_t n = read(follower->fd, follower->buffer + follower->buffered, sizeof(follower->buffer) - follower->buffered);
+    if (n <= 0)
+        return -1;
+
+    size_t total = follower->buffered + n;
+    size_t count = total / sizeof(t_repl_record);
+    for (size_t i = 0; i < count; ++i) {
+        t_repl_record record;
+        std::memcpy(&record, follower->buffer + i * sizeof(t_repl_record), sizeof(record));
+        if (record.op == REPL_OP_INSERT) {
+            rbtree_insert(&follower->tree, record.key);
+        } else {
+            rbtree_erase(&follower->tree, record.key);
+        }
+    }
+
+    // 剩下的半条记录移到缓冲区开头
+    follower->buffered = total - count * sizeof(t_repl_record);
+    std::memmove(follower->buffer, follower->buffer + count * sizeof(t_repl_record), follower->buffered);
+    follower->applied += count;
+    follower->batches++;
+    return count;
+}
+
+// 树中所有key的校验和，用于比较leader和副本是否一致
+static uint64_t rbtree_checksum(t_rbtree *tree) {
+    vector<int> keys;
+    inorder_traversal(tree, keys);
+
+    uint64_t sum = keys.size();
+    for (auto key : keys) {
+        sum = sum * 1000003 + (uint32_t)key;
+    }
+    return sum;
+}
+
+#define DEMO_FOLLOWERS 3
+#define DEMO_OPS       2000000
+#define DEMO_KEY_RANGE 200000
+
+int main(int argc, char *argv[]) {
+    const char *path = argc > 1 ? argv[1] : "/tmp/rbtree_repl.sock";
+
+    t_repl_leader leader;
+    if (repl_leader_init(&leader, path) != 0) {
+        std::perror("listen");
+        return 1;
+    }
+
+    // 先写入一部分数据，副本连接后从头追赶
+    std::mt19937 rng(20260417);
+    for (int i = 0; i < DEMO_KEY_RANGE / 2; ++i) {
+        repl_insert(&leader, (int)(rng() % DEMO_KEY_RANGE));
+    }
+
+    std::fflush(nullptr);
+    pid_t pids[DEMO_FOLLOWERS];
+    for (int i = 0; i < DEMO_FOLLOWERS; ++i) {
+        pids[i] = fork();
+        if (pids[i] != 0)
+            continue;
+
+        // 副本进程：应用日志，批与批之间做查找，直到leader关闭写端，最后把校验和发回leader
+        close(leader.listen_fd);
+        t_repl_follower *follower = new t_repl_follower;
+        rbtree_init(&follower->tree);
+        follower->applied = 0;
+        follower->batches = 0;
+        if (repl_follower_connect(follower, path) != 0)
+            _exit(1);
+
+        std::mt19937 local_rng(i);
+        long long lookups = 0, hits = 0;
+        while (repl_follower_poll(follower) >= 0) {
+            for (int j = 0; j < 64; ++j, ++lookups) {
+                hits += rbtree_find(&follower->tree, (int)(local_rng() % DEMO_KEY_RANGE)) != nullptr;
+            }
+        }
+
+        uint64_t result[3] = {rbtree_checksum(&follower->tree), follower->applied, (uint64_t)follower->batches};
+        write(follower->fd, result, sizeof(result));
+        std::printf("follower %d: applied %llu records in %lld batches, served %lld lookups (%lld hits)\n",
+                    i, (unsigned long long)follower->applied, follower->batches, lookups, hits);
+        std::fflush(stdout);
+        _exit(0);
+    }
+
+    // leader：随机插入删除，每1024次操作推送一次
+    auto start = std::chrono::steady_clock::now();
+    size_t max_pending = 0;
+    for (int i = 0; i < DEMO_OPS; ++i) {
+        int key = (int)(rng() % DEMO_KEY_RANGE);
+        if (rng() & 1) {
+            repl_insert(&leader, key);
+        } else {
+            repl_erase(&leader, key);
+        }
+
+        if ((i & 1023) == 0) {
+            size_t pending = repl_leader_flush(&leader);
+            max_pending = pending > max_pending ? pending : max_pending;
+        }
+    }
+    double write_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // 等所有副本都连上并收完日志
+    while (leader.followers.size() < DEMO_FOLLOWERS || repl_leader_flush(&leader) > 0) {
+        usleep(100);
+    }
+    double drain_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t expected = rbtree_checksum(&leader.tree);
+    std::printf("leader: %zu records (%zu bytes), writes %.1f ms, all followers caught up at %.1f ms, max backlog %zu bytes\n",
+                leader.log.size() / sizeof(t_repl_record), leader.log.size(), write_ms, drain_ms, max_pending);
+    std::fflush(stdout);
+
+    for (auto& conn : leader.followers) {
+        shutdown(conn.fd, SHUT_WR);
+    }
+    for (auto& conn : leader.followers) {
+        fcntl(conn.fd, F_SETFL, fcntl(conn.fd, F_GETFL) & ~O_NONBLOCK);
+        uint64_t result[3] = {0};
+        int ok = read(conn.fd, result, sizeof(result)) == sizeof(result) && result[0] == expected;
+        std::printf("follower consistent with leader: %s\n", ok ? "yes" : "no");
+        close(conn.fd);
+    }
+    for (int i = 0; i < DEMO_FOLLOWERS; ++i) {
+        waitpid(pids[i], nullptr, 0);
+    }
+
+    for (auto& handshake : leader.handshakes) {
+        close(handshake.fd);
+    }
+    close(leader.listen_fd);
+    unlink(path);
+    rbtree_destroy(&leader.tree);
+    return 0;
+}
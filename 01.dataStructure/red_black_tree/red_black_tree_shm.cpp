@@ -0,0 +1,697 @@
+/**
+ * @file red_black_tree_shm.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 放在POSIX共享内存中、可以被多个进程同时访问的红黑树
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using std::vector;
+
+typedef int USER_KEY_TYPE;
+
+#define RBTREE_CLR_RED 0
+#define RBTREE_CLR_BLK 1
+#define RBTREE_CLR_DBL 2
+
+/*
+    同一台机器上的多个worker进程各自构建一份相同的索引，既浪费内存，也拖慢每个进程的启动。把红黑树放到POSIX共享内存
+（shm_open + mmap）中，所有进程映射同一个段即可共享一份索引。
+
+    1. 同一个段在不同进程中被映射到的地址一般不同，节点之间不能再用裸指针互相引用。这里所有节点都放在段内的一个
+       节点数组中，left/right保存的是节点在数组中的下标（相对偏移），下标0固定是nil节点，取代red_black_tree_recursion.cpp
+       中的全局__nil_node。下标只有4字节，节点也从24字节缩小到16字节。
+    2. 写者之间用一把进程间共享的健壮互斥锁（PTHREAD_PROCESS_SHARED + PTHREAD_MUTEX_ROBUST）互斥。持锁的进程如果中途
+       崩溃，下一个加锁的进程会得到EOWNERDEAD，而不是永远阻塞。
+    3. 读者不加锁，使用顺序锁（seqlock）：写者修改前后各把序号加一，修改期间序号为奇数；读者在读之前和读之后各读一次
+       序号，两次相等且为偶数，说明读的过程中没有写者修改过，结果有效，否则重试。读者可能读到修改了一半的树，因此
+       读的过程中要防御性地检查下标是否越界、深度是否异常，遇到异常直接重试，不能信任读到的任何数据。
+    4. 如果写者在修改了一半的时候崩溃（序号停在奇数），树可能已经被破坏了，此时把段标记为损坏，所有操作都返回错误，
+       由使用者重新构建。如果写者在开始修改之前就崩溃了（序号仍是偶数），树是完好的，恢复锁之后可以继续使用。
+       读者也不能无限等待一个奇数的序号：等待超过SHM_READ_SPIN_LIMIT次以后，用trylock探测写锁，得到EOWNERDEAD（或者
+       锁是空闲的而序号仍为奇数）说明写者已经死在修改的中途，标记段损坏；写者还活着则返回-EBUSY，由调用者决定是否重试。
+*/
+
+typedef uint32_t t_shm_off;
+
+typedef struct shm_rbtree_node {
+    USER_KEY_TYPE key;
+    int color;
+    t_shm_off left;
+    t_shm_off right;
+} t_shm_rbtree_node;
+
+#define SHM_RBTREE_MAGIC 0x52425348u // "RBSH"
+#define SHM_NIL          0
+
+// 段的开头是头部，之后紧跟着节点数组
+typedef struct shm_rbtree_header {
+    uint32_t magic;
+    uint32_t capacity;          // 节点数组的长度，包括nil节点
+    pthread_mutex_t write_lock;
+    std::atomic<uint64_t> seq;
+    int broken;
+    t_shm_off root;
+    t_shm_off free_list;        // 释放的节点通过left串成链表
+    t_shm_off next_unused;      // 从未使用过的第一个节点
+    long long size;
+} t_shm_rbtree_header;
+
+// 每个进程各自持有的句柄
+typedef struct shm_rbtree {
+    t_shm_rbtree_header *header;
+    t_shm_rbtree_node *nodes;
+    size_t length;
+    long long read_retries;     // 本进程读者重试的次数
+} t_shm_rbtree;
+
+// 合法红黑树的高度不超过2log(n+1)，读到超过这个深度的路径，说明读到了正在修改的数据
+#define SHM_RBTREE_MAX_DEPTH 96
+
+#define SHM_NODE(off) (&tree->nodes[(off)])
+
+static size_t __shm_rbtree_length(uint32_t capacity) {
+    return sizeof(t_shm_rbtree_header) + (size_t)capacity * sizeof(t_shm_rbtree_node);
+}
+
+static int __shm_rbtree_map(t_shm_rbtree *tree, int fd, size_t length) {
+    void *base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+        return -1;
+
+    tree->header = (t_shm_rbtree_header *)base;
+    tree->nodes = (t_shm_rbtree_node *)((char *)base + sizeof(t_shm_rbtree_header));
+    tree->length = length;
+    tree->read_retries = 0;
+    return 0;
+}
+
+// 创建新的共享内存段，capacity为最多能容纳的节点数
+int shm_rbtree_create(t_shm_rbtree *tree, const char *name, uint32_t capacity) {
+    if (tree == nullptr || name == nullptr)
+        return -1;
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        return -2;
+
+    capacity += 1; // nil节点
+    size_t length = __shm_rbtree_length(capacity);
+    if (ftruncate(fd, length) != 0 || __shm_rbtree_map(tree, fd, length) != 0) {
+        close(fd);
+        shm_unlink(name);
+        return -2;
+    }
+    close(fd);
+
+    t_shm_rbtree_header *header = tree->header;
+    header->capacity = capacity;
+    header->broken = 0;
+    header->root = SHM_NIL;
+    header->free_list = SHM_NIL;
+    header->next_unused = 1;
+    header->size = 0;
+    new (&header->seq) std::atomic<uint64_t>(0);
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&header->write_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    t_shm_rbtree_node *nil = SHM_NODE(SHM_NIL);
+    nil->key = 0;
+    nil->color = RBTREE_CLR_BLK;
+    nil->left = nil->right = SHM_NIL;
+
+    // 最后写magic，其他进程看到magic时头部一定已经初始化好了
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SHM_RBTREE_MAGIC;
+    return 0;
+}
+
+// 打开其他进程已经创建好的段
+int shm_rbtree_open(t_shm_rbtree *tree, const char *name) {
+    if (tree == nullptr || name == nullptr)
+        return -1;
+
+    int fd = shm_open(name, O_RDWR, 0600);
+    if (fd < 0)
+        return -2;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(t_shm_rbtree_header) ||
+        __shm_rbtree_map(tree, fd, st.st_size) != 0) {
+        close(fd);
+        return -2;
+    }
+    close(fd);
+
+    if (tree->header->magic != SHM_RBTREE_MAGIC || __shm_rbtree_length(tree->header->capacity) > tree->length) {
+        munmap(tree->header, tree->length);
+        return -3;
+    }
+
+    return 0;
+}
+
+void shm_rbtree_close(t_shm_rbtree *tree) {
+    if (tree == nullptr || tree->header == nullptr)
+        return;
+
+    munmap(tree->header, tree->length);
+    tree->header = nullptr;
+    tree->nodes = nullptr;
+}
+
+/* ------------------------------ 写者的加锁与解锁 ------------------------------ */
+
+// 加写锁并进入修改状态，成功返回0，段已损坏返回-3
+static int __shm_rbtree_write_begin(t_shm_rbtree *tree) {
+    t_shm_rbtree_header *header = tree->header;
+    int ret = pthread_mutex_lock(&header->write_lock);
+    if (ret == EOWNERDEAD) {
+        // 上一个持锁的进程崩溃了，序号为奇数说明它死在修改的中途
+        if (header->seq.load() & 1) {
+            header->broken = 1;
+        }
+        pthread_mutex_consistent(&header->write_lock);
+    } else if (ret != 0) {
+        return -2;
+    }
+
+    if (header->broken) {
+        pthread_mutex_unlock(&header->write_lock);
+        return -3;
+    }
+
+    header->seq.store(header->seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return 0;
+}
+
+static void __shm_rbtree_write_end(t_shm_rbtree *tree) {
+    t_shm_rbtree_header *header = tree->header;
+    header->seq.store(header->seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    pthread_mutex_unlock(&header->write_lock);
+}
+
+/* -------------------------------- 红黑树操作 -------------------------------- */
+
+static t_shm_off shm_rbtree_create_node(t_shm_rbtree *tree, USER_KEY_TYPE key) {
+    t_shm_rbtree_header *header = tree->header;
+    t_shm_off off = header->free_list;
+    if (off != SHM_NIL) {
+        header->free_list = SHM_NODE(off)->left;
+    } else if (header->next_unused < header->capacity) {
+        off = header->next_unused++;
+    } else {
+        return SHM_NIL;
+    }
+
+    t_shm_rbtree_node *node = SHM_NODE(off);
+    node->key = key;
+    node->color = RBTREE_CLR_RED;
+    node->left = node->right = SHM_NIL;
+    header->size++;
+
+    return off;
+}
+
+static void shm_rbtree_free_node(t_shm_rbtree *tree, t_shm_off off) {
+    SHM_NODE(off)->left = tree->header->free_list;
+    tree->header->free_list = off;
+    tree->header->size--;
+}
+
+static int has_red_child_node(t_shm_rbtree *tree, t_shm_off off) {
+    return SHM_NODE(SHM_NODE(off)->left)->color == RBTREE_CLR_RED ||
+           SHM_NODE(SHM_NODE(off)->right)->color == RBTREE_CLR_RED;
+}
+
+static t_shm_off rbtree_left_rotate(t_shm_rbtree *tree, t_shm_off up) {
+    t_shm_off down = SHM_NODE(up)->right;
+    SHM_NODE(up)->right = SHM_NODE(down)->left;
+    SHM_NODE(down)->left = up;
+
+    return down;
+}
+
+static t_shm_off rbtree_right_rotate(t_shm_rbtree *tree, t_shm_off up) {
+    t_shm_off down = SHM_NODE(up)->left;
+    SHM_NODE(up)->left = SHM_NODE(down)->right;
+    SHM_NODE(down)->right = up;
+
+    return down;
+}
+
+// 插入调整，与red_black_tree_recursion.cpp中的逻辑相同，只是把指针换成了下标
+#define RBTREE_INSERT_CLT_NONE  0
+#define RBTREE_INSERT_CLT_LEFT  1
+#define RBTREE_INSERT_CLT_RIGHT 2
+static t_shm_off rbtree_insert_maintian(t_shm_rbtree *tree, t_shm_off root) {
+    if (!has_red_child_node(tree, root))
+        return root;
+
+    t_shm_rbtree_node *node = SHM_NODE(root);
+    if (SHM_NODE(node->left)->color == RBTREE_CLR_RED && SHM_NODE(node->right)->color == RBTREE_CLR_RED) {
+        node->color = RBTREE_CLR_RED;
+        SHM_NODE(node->left)->color = SHM_NODE(node->right)->color = RBTREE_CLR_BLK;
+
+        return root;
+    }
+
+    int has_red_conflict = RBTREE_INSERT_CLT_NONE;
+    if (SHM_NODE(node->left)->color == RBTREE_CLR_RED && has_red_child_node(tree, node->left)) {
+        has_red_conflict = RBTREE_INSERT_CLT_LEFT;
+    } else if (SHM_NODE(node->right)->color == RBTREE_CLR_RED && has_red_child_node(tree, node->right)) {
+        has_red_conflict = RBTREE_INSERT_CLT_RIGHT;
+    }
+
+    if (!has_red_conflict)
+        return root;
+
+    if (has_red_conflict == RBTREE_INSERT_CLT_LEFT) {
+        if (SHM_NODE(SHM_NODE(node->left)->right)->color == RBTREE_CLR_RED) {
+            node->left = rbtree_left_rotate(tree, node->left);
+        }
+        root = rbtree_right_rotate(tree, root);
+    } else {
+        if (SHM_NODE(SHM_NODE(node->right)->left)->color == RBTREE_CLR_RED) {
+            node->right = rbtree_right_rotate(tree, node->right);
+        }
+        root = rbtree_left_rotate(tree, root);
+    }
+
+    node = SHM_NODE(root);
+    node->color = RBTREE_CLR_RED;
+    SHM_NODE(node->left)->color = SHM_NODE(node->right)->color = RBTREE_CLR_BLK;
+    return root;
+}
+
+// 插入新节点，返回根节点；ret返回0表示插入成功，1表示已存在，-2表示段已满
+static t_shm_off __shm_rbtree_insert(t_shm_rbtree *tree, t_shm_off root, USER_KEY_TYPE key, int *ret) {
+    if (root == SHM_NIL) {
+        t_shm_off off = shm_rbtree_create_node(tree, key);
+        *ret = (off == SHM_NIL ? -2 : 0);
+        return off;
+    }
+
+    t_shm_rbtree_node *node = SHM_NODE(root);
+    if (node->key == key) {
+        *ret = 1;
+        return root;
+    }
+
+    if (key < node->key) {
+        node->left = __shm_rbtree_insert(tree, node->left, key, ret);
+    } else {
+        node->right = __shm_rbtree_insert(tree, node->right, key, ret);
+    }
+
+    return rbtree_insert_maintian(tree, root);
+}
+
+// 插入key，成功返回0，已存在返回1，段已满返回-2，段已损坏返回-3
+int shm_rbtree_insert(t_shm_rbtree *tree, USER_KEY_TYPE key) {
+    if (tree == nullptr || tree->header == nullptr)
+        return -1;
+
+    int ret = __shm_rbtree_write_begin(tree);
+    if (ret != 0)
+        return ret;
+
+    t_shm_rbtree_header *header = tree->header;
+    header->root = __shm_rbtree_insert(tree, header->root, key, &ret);
+    SHM_NODE(header->root)->color = RBTREE_CLR_BLK;
+    __shm_rbtree_write_end(tree);
+
+    return ret;
+}
+
+#define RBTREE_ERASE_CLT_NONE  0
+#define RBTREE_ERASE_CLT_LEFT  1
+#define RBTREE_ERASE_CLT_RIGHT 2
+// 删除调整，逻辑与red_black_tree_recursion.cpp中的__rbtree_erase_maintain相同
+static t_shm_off __shm_rbtree_erase_maintain(t_shm_rbtree *tree, t_shm_off root) {
+    t_shm_rbtree_node *node = SHM_NODE(root);
+    if (SHM_NODE(node->left)->color != RBTREE_CLR_DBL && SHM_NODE(node->right)->color != RBTREE_CLR_DBL) {
+        return root;
+    }
+
+    if (has_red_child_node(tree, root)) {
+        int has_red_conflict = RBTREE_ERASE_CLT_NONE;
+        node->color = RBTREE_CLR_RED;
+        if (SHM_NODE(node->left)->color == RBTREE_CLR_RED) {
+            root = rbtree_right_rotate(tree, root);
+            has_red_conflict = RBTREE_ERASE_CLT_LEFT;
+        } else {
+            root = rbtree_left_rotate(tree, root);
+            has_red_conflict = RBTREE_ERASE_CLT_RIGHT;
+        }
+        node = SHM_NODE(root);
+        node->color = RBTREE_CLR_BLK;
+
+        if (has_red_conflict == RBTREE_ERASE_CLT_LEFT) {
+            node->right = __shm_rbtree_erase_maintain(tree, node->right);
+        } else {
+            node->left = __shm_rbtree_erase_maintain(tree, node->left);
+        }
+
+        return root;
+    }
+
+    t_shm_rbtree_node *left = SHM_NODE(node->left);
+    t_shm_rbtree_node *right = SHM_NODE(node->right);
+    if ((left->color == RBTREE_CLR_DBL && !has_red_child_node(tree, node->right)) ||
+        (right->color == RBTREE_CLR_DBL && !has_red_child_node(tree, node->left))) {
+
+        left->color -= RBTREE_CLR_BLK;
+        right->color -= RBTREE_CLR_BLK;
+
+        node->color += RBTREE_CLR_BLK;
+        return root;
+    }
+
+    if (left->color == RBTREE_CLR_DBL) {
+        if (SHM_NODE(right->left)->color == RBTREE_CLR_RED) {
+            right->color = RBTREE_CLR_RED;
+            node->right = rbtree_right_rotate(tree, node->right);
+            SHM_NODE(node->right)->color = RBTREE_CLR_BLK;
+        }
+
+        left->color -= RBTREE_CLR_BLK;
+        root = rbtree_left_rotate(tree, root);
+        SHM_NODE(root)->color = SHM_NODE(SHM_NODE(root)->left)->color;
+    } else {
+        if (SHM_NODE(left->right)->color == RBTREE_CLR_RED) {
+            left->color = RBTREE_CLR_RED;
+            node->left = rbtree_left_rotate(tree, node->left);
+            SHM_NODE(node->left)->color = RBTREE_CLR_BLK;
+        }
+
+        right->color -= RBTREE_CLR_BLK;
+        root = rbtree_right_rotate(tree, root);
+        SHM_NODE(root)->color = SHM_NODE(SHM_NODE(root)->right)->color;
+    }
+
+    node = SHM_NODE(root);
+    SHM_NODE(node->left)->color = SHM_NODE(node->right)->color = RBTREE_CLR_BLK;
+
+    return root;
+}
+
+static t_shm_off __shm_rbtree_erase(t_shm_rbtree *tree, t_shm_off root, USER_KEY_TYPE key, int *ret) {
+    if (root == SHM_NIL)
+        return SHM_NIL;
+
+    t_shm_rbtree_node *node = SHM_NODE(root);
+    if (key < node->key) {
+        node->left = __shm_rbtree_erase(tree, node->left, key, ret);
+    } else if (key > node->key) {
+        node->right = __shm_rbtree_erase(tree, node->right, key, ret);
+    } else {
+        if (node->left == SHM_NIL || node->right == SHM_NIL) {
+            t_shm_off child = (node->left != SHM_NIL ? node->left : node->right);
+            SHM_NODE(child)->color += node->color;
+            shm_rbtree_free_node(tree, root);
+            *ret = 0;
+
+            return child;
+        }
+
+        t_shm_off prev = node->left;
+        while (SHM_NODE(prev)->right != SHM_NIL) {
+            prev = SHM_NODE(prev)->right;
+        }
+        node->key = SHM_NODE(prev)->key;
+        node->left = __shm_rbtree_erase(tree, node->left, node->key, ret);
+    }
+
+    return __shm_rbtree_erase_maintain(tree, root);
+}
+
+// 删除key，成功返回0，不存在返回1，段已损坏返回-3
+int shm_rbtree_erase(t_shm_rbtree *tree, USER_KEY_TYPE key) {
+    if (tree == nullptr || tree->header == nullptr)
+        return -1;
+
+    int ret = __shm_rbtree_write_begin(tree);
+    if (ret != 0)
+        return ret;
+
+    ret = 1;
+    t_shm_rbtree_header *header = tree->header;
+    header->root = __shm_rbtree_erase(tree, header->root, key, &ret);
+    SHM_NODE(header->root)->color = RBTREE_CLR_BLK;
+    __shm_rbtree_write_end(tree);
+
+    return ret;
+}
+
+/* ------------------------------------ 读者 ----------------------------------- */
+
+// 读者读的字段可能正在被写者修改，统一用原子的relaxed读，结果是否有效由序号决定
+#define SHM_READ(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+#define SHM_READ_SPIN_LIMIT (1 << 16)
+
+// 写者迟迟没有结束修改，检查它是否已经崩溃。是则标记段损坏并返回-3，否则返回-EBUSY
+static int __shm_rbtree_check_writer(t_shm_rbtree *tree) {
+    t_shm_rbtree_header *header = tree->header;
+    int ret = pthread_mutex_trylock(&header->write_lock);
+    if (ret == EBUSY)
+        return -EBUSY;
+
+    if (ret == EOWNERDEAD) {
+        pthread_mutex_consistent(&header->write_lock);
+    } else if (ret != 0) {
+        return -EBUSY;
+    }
+
+    // 持有写锁时序号仍是奇数，说明没有写者能把它改回偶数了
+    int broken = (int)(header->seq.load() & 1);
+    if (broken) {
+        __atomic_store_n(&header->broken, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&header->write_lock);
+    return broken ? -3 : 0;
+}
+
+// 成功返回0并通过seq返回序号；段已损坏返回-3；写者长时间没有结束修改返回-EBUSY
+static int __shm_rbtree_read_begin(t_shm_rbtree *tree, uint64_t *seq) {
+    int spins = 0;
+    while ((*seq = tree->header->seq.load(std::memory_order_acquire)) & 1) {
+        if (++spins < SHM_READ_SPIN_LIMIT) {
+            // 有写者正在修改，稍等一下
+            sched_yield();
+            continue;
+        }
+
+        int ret = __shm_rbtree_check_writer(tree);
+        if (ret != 0)
+            return ret;
+
+        spins = 0;
+    }
+
+    return 0;
+}
+
+static int __shm_rbtree_read_valid(t_shm_rbtree *tree, uint64_t seq) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return tree->header->seq.load(std::memory_order_relaxed) == seq;
+}
+
+// 查找key，存在返回1，不存在返回0，段已损坏返回-3，写者长时间没有结束修改返回-EBUSY
+int shm_rbtree_find(t_shm_rbtree *tree, USER_KEY_TYPE key) {
+    if (tree == nullptr || tree->header == nullptr)
+        return -1;
+
+    t_shm_rbtree_header *header = tree->header;
+    while (true) {
+        if (SHM_READ(header->broken))
+            return -3;
+
+        uint64_t seq;
+        int ret = __shm_rbtree_read_begin(tree, &seq);
+        if (ret != 0)
+            return ret;
+
+        int found = 0, depth = 0;
+        t_shm_off cursor = SHM_READ(header->root);
+        while (cursor != SHM_NIL && cursor < header->capacity && depth++ < SHM_RBTREE_MAX_DEPTH) {
+            USER_KEY_TYPE cursor_key = SHM_READ(SHM_NODE(cursor)->key);
+            if (cursor_key == key) {
+                found = 1;
+                break;
+            }
+
+            cursor = (key < cursor_key ? SHM_READ(SHM_NODE(cursor)->left) : SHM_READ(SHM_NODE(cursor)->right));
+        }
+
+        if (__shm_rbtree_read_valid(tree, seq))
+            return found;
+
+        tree->read_retries++;
+    }
+}
+
+// 中序遍历，使用显式栈，读到的下标越界或深度异常时直接放弃这一轮
+static int __shm_inorder_traversal(t_shm_rbtree *tree, vector<int>& result) {
+    t_shm_off stack[SHM_RBTREE_MAX_DEPTH];
+    int top = 0;
+    t_shm_off cursor = SHM_READ(tree->header->root);
+    size_t limit = tree->header->capacity;
+
+    while (cursor != SHM_NIL || top > 0) {
+        while (cursor != SHM_NIL) {
+            if (cursor >= limit || top == SHM_RBTREE_MAX_DEPTH || result.size() >= limit)
+                return -1;
+
+            stack[top++] = cursor;
+            cursor = SHM_READ(SHM_NODE(cursor)->left);
+        }
+
+        cursor = stack[--top];
+        result.emplace_back(SHM_READ(SHM_NODE(cursor)->key));
+        cursor = SHM_READ(SHM_NODE(cursor)->right);
+    }
+
+    return 0;
+}
+
+int inorder_traversal(t_shm_rbtree *tree, vector<int>& result) {
+    if (tree == nullptr || tree->header == nullptr)
+        return -1;
+
+    size_t origin = result.size();
+    while (true) {
+        if (SHM_READ(tree->header->broken))
+            return -3;
+
+        uint64_t seq;
+        int ret = __shm_rbtree_read_begin(tree, &seq);
+        if (ret != 0)
+            return ret;
+
+        ret = __shm_inorder_traversal(tree, result);
+        if (ret == 0 && __shm_rbtree_read_valid(tree, seq))
+            return 0;
+
+        result.resize(origin);
+        tree->read_retries++;
+    }
+}
+
+#define DEMO_SHM_NAME "/linux_cpp_learning_rbtree"
+#define DEMO_WORKERS  4
+#define DEMO_KEYS     100000
+
+int main() {
+    shm_unlink(DEMO_SHM_NAME);
+    std::setvbuf(stdout, nullptr, _IOLBF, 0);
+
+    t_shm_rbtree tree;
+    if (shm_rbtree_create(&tree, DEMO_SHM_NAME, 2 * DEMO_KEYS) != 0) {
+        std::perror("shm_rbtree_create");
+        return 1;
+    }
+
+    // 与红黑树相同的测试数据
+    int nums[] = {12,31,24,5,12,5,34,9,2985,324,5,69,8};
+    int len = sizeof(nums) / sizeof(int);
+    for (int i = 0; i < len; ++i) {
+        shm_rbtree_insert(&tree, -nums[i]);
+    }
+
+    // 先放入一半的偶数key，再启动worker进程
+    for (int i = 0; i < DEMO_KEYS; i += 2) {
+        shm_rbtree_insert(&tree, i);
+    }
+
+    for (int w = 0; w < DEMO_WORKERS; ++w) {
+        if (fork() == 0) {
+            // worker进程重新打开段，映射地址与父进程无关
+            t_shm_rbtree view;
+            if (shm_rbtree_open(&view, DEMO_SHM_NAME) != 0)
+                _exit(2);
+
+            int misses = 0;
+            for (int round = 0; round < 5; ++round) {
+                for (int i = 0; i < DEMO_KEYS; i += 2) {
+                    misses += (shm_rbtree_find(&view, i) != 1);
+                }
+            }
+            std::printf("worker %d: %d misses, %lld seqlock retries\n", w, misses, view.read_retries);
+            std::fflush(stdout);
+            shm_rbtree_close(&view);
+            _exit(misses ? 1 : 0);
+        }
+    }
+
+    // worker查找的同时，父进程写入奇数key
+    for (int i = 1; i < DEMO_KEYS; i += 2) {
+        shm_rbtree_insert(&tree, i);
+    }
+    for (int w = 0; w < DEMO_WORKERS; ++w) {
+        wait(nullptr);
+    }
+
+    // 模拟一个写者拿到锁之后崩溃，但还没有开始修改
+    if (fork() == 0) {
+        t_shm_rbtree view;
+        shm_rbtree_open(&view, DEMO_SHM_NAME);
+        __shm_rbtree_write_begin(&view);
+        view.header->seq.fetch_sub(1); // 退回修改前的状态，相当于死在修改之前
+        _exit(0);
+    }
+    wait(nullptr);
+
+    for (int i = 0; i < len; ++i) {
+        shm_rbtree_erase(&tree, -nums[i]);
+    }
+    int ret = shm_rbtree_erase(&tree, 0);
+    std::printf("after writer crash: erase ret %d, size %lld\n", ret, tree.header->size);
+
+    vector<int> result;
+    inorder_traversal(&tree, result);
+    int sorted = 1;
+    for (size_t i = 1; i < result.size(); ++i) {
+        sorted &= (result[i - 1] < result[i]);
+    }
+    std::printf("inorder: %zu keys, %s\n", result.size(), sorted ? "sorted" : "NOT SORTED");
+
+    // 模拟一个写者死在修改的中途，序号停在奇数，读者不能一直等下去
+    if (fork() == 0) {
+        t_shm_rbtree view;
+        shm_rbtree_open(&view, DEMO_SHM_NAME);
+        __shm_rbtree_write_begin(&view);
+        _exit(0);
+    }
+    wait(nullptr);
+    std::printf("after writer crash mid-update: find ret %d\n", shm_rbtree_find(&tree, 1));
+
+    shm_rbtree_close(&tree);
+    shm_unlink(DEMO_SHM_NAME);
+    return 0;
+}
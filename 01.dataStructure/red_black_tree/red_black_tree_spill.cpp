@@ -0,0 +1,749 @@
+/**
+ * @file red_black_tree_spill.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 带内存预算的红黑树：超出预算时把冷子树序列化到本地文件，访问时再换入
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <set>
+#include <unistd.h>
+#include <vector>
+
+using std::vector;
+
+typedef int USER_KEY_TYPE;
+
+#define RBTREE_CLR_RED 0
+#define RBTREE_CLR_BLK 1
+#define RBTREE_CLR_DBL 2
+
+/*
+    整体结构与red_black_tree_recursion.cpp相同，区别在于树可以设置一个内存预算（字节数）。当树中常驻内存的节点
+超出预算时，挑选最近没有被访问过的子树，把它整体序列化写到一个本地文件中，然后在原来的位置上放一个存根节点
+（stub）。存根节点只记录该子树在文件中的偏移以及子树根节点的颜色，它的左右孩子都是nil。
+
+    任何需要访问存根节点孩子的地方，都要先把它换入（fault in）：从文件中读出整棵子树重建，并替换掉存根节点。
+需要换入的地方只有以下几类：
+    1. 查找、插入、删除沿途经过的节点；
+    2. 删除时寻找前驱节点沿途经过的节点；
+    3. 删除调整时双黑节点的兄弟节点以及兄弟节点的两个孩子，因为调整时要判断兄弟节点是否有红色孩子，并且可能以
+       兄弟节点、侄子节点为轴进行旋转。
+    插入调整不需要额外换入：插入调整中被旋转的节点都在插入路径上；而对不在路径上的孩子，只会读它的颜色，或者判断
+一个红色的孩子是否有红色孩子。存根节点保存了子树根的颜色，并且它的孩子是nil，对于红色的存根节点，“没有红色孩子”
+这个结论在一棵合法的红黑树中本来就是成立的。
+    改变存根节点的颜色（例如插入调整时的变色）是允许的，换入时以存根节点上的颜色为准。
+
+    挑选换出的子树使用时钟（clock）算法，而不是每次都遍历所有常驻节点：
+    1. 每个节点记录以它为根的常驻子树的节点数（存根节点算1个），与size域一样在旋转、换入、换出之后沿路径更新；
+    2. 候选子树是常驻节点数不少于RBTREE_SPILL_MIN_NODES、但两个孩子都少于该值的子树，大小在[MIN, 2 * MIN)之间；
+    3. 时钟指针是一个key。每次从根往时钟指针的方向走，一直走到候选子树，O(log n)；然后把时钟指针移到这棵子树的
+       key上界，下次就从它右边的下一棵候选子树开始，扫到最右边后回到最左边；
+    4. 查找、插入、删除沿途经过的节点都会置位访问位。时钟指针扫到的候选子树如果访问位置位，就清掉访问位跳过它
+       （第二次机会），否则换出。
+    预算在每次操作开始时检查，操作过程中换入的节点可能让内存暂时超出预算，到下一次操作时再换出。这样rbtree_find
+返回的节点在下一次操作之前一直有效，不会在返回之前就被换出释放掉。
+
+    文件按固定大小的槽位分配，候选子树的大小有上界，一个槽位一定能放下。子树被换入后它的槽位就空闲了，新的子树
+总是写到编号最小的空闲槽位，空闲槽位位于文件末尾时直接截掉，因此文件的大小只取决于同时换出的子树个数。嵌套的
+存根节点在序列化时只记录它的偏移，它自己的槽位保持不变。
+*/
+
+typedef struct rbtree_node {
+    USER_KEY_TYPE key;
+    int color;
+    struct rbtree_node *left;
+    struct rbtree_node *right;
+    int referenced;             // 访问位，查找、插入、删除经过时置1，时钟指针扫过时清0
+    int spilled;                // 是否为存根节点
+    long long spill_offset;     // 存根节点对应的子树在文件中的偏移
+    size_t size;                // 以该节点为根的常驻子树的节点数，存根节点算1个
+} t_rbtree_node;
+
+typedef struct rbtree {
+    t_rbtree_node *root;
+    size_t budget_bytes;        // 0表示不限制
+    size_t used_bytes;          // 常驻内存的节点（包括存根节点）占用的字节数
+    long long hand_key;         // 时钟指针，下一次从这个key开始寻找可以换出的子树
+    int spill_fd;
+    long long spill_slots;      // 文件中的槽位数
+    std::set<long long> free_slots;
+
+    // 统计信息
+    long long spill_count;
+    long long fault_count;
+} t_rbtree;
+
+t_rbtree_node __nil_node;
+
+#define nil_node (&__nil_node)
+
+__attribute__((constructor))
+void init_nil_node() {
+     __nil_node.key = 0;
+     __nil_node.color = RBTREE_CLR_BLK;
+     __nil_node.left = __nil_node.right = nil_node;
+     __nil_node.spilled = 0;
+     __nil_node.size = 0;
+}
+
+// 每次换出至少这么多个节点，避免为了几个节点产生大量存根节点
+#define RBTREE_SPILL_MIN_NODES 64
+
+// 红黑树的高度不超过2log(n+1)，换出时记录路径用
+#define RBTREE_MAX_HEIGHT 128
+
+int rbtree_init(t_rbtree *tree, size_t budget_bytes, const char *spill_path) {
+    if (tree == nullptr)
+        return -1;
+
+    tree->root = nil_node;
+    tree->budget_bytes = budget_bytes;
+    tree->used_bytes = 0;
+    tree->hand_key = LLONG_MIN;
+    tree->spill_slots = 0;
+    tree->free_slots.clear();
+    tree->spill_count = tree->fault_count = 0;
+    tree->spill_fd = open(spill_path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (tree->spill_fd < 0) {
+        return -2;
+    }
+
+    return 0;
+}
+
+t_rbtree_node *rbtree_create_node(t_rbtree *tree, USER_KEY_TYPE key) {
+    t_rbtree_node *node = new t_rbtree_node;
+    if (node == nullptr) {
+        return nullptr;
+    }
+
+    node->key = key;
+    node->color = RBTREE_CLR_RED;
+    node->left = node->right = nil_node;
+    node->referenced = 1;
+    node->spilled = 0;
+    node->spill_offset = 0;
+    node->size = 1;
+    tree->used_bytes += sizeof(t_rbtree_node);
+
+    return node;
+}
+
+static void rbtree_free_node(t_rbtree *tree, t_rbtree_node *node) {
+    tree->used_bytes -= sizeof(t_rbtree_node);
+    delete node;
+}
+
+// 根据两个孩子重新计算常驻子树的节点数，存根节点的孩子都是nil，结果为1
+static void __spill_update(t_rbtree_node *node) {
+    node->size = node->left->size + node->right->size + 1;
+}
+
+/* -------------------------------- 换出与换入 -------------------------------- */
+
+#define SPILL_REC_NIL  0
+#define SPILL_REC_NODE 1
+#define SPILL_REC_STUB 2
+
+// 子树按先序序列化成定长记录，nil也占一条记录，这样不需要额外记录子树的形状
+typedef struct spill_record {
+    int kind;
+    USER_KEY_TYPE key;
+    int color;
+    int referenced;
+    long long offset;           // kind为SPILL_REC_STUB时有效
+} t_spill_record;
+
+/*
+    槽位的格式：记录条数 + 记录。候选子树最多有2 * MIN - 1个节点，先序序列化时每个节点一条记录，再加上节点数 + 1
+条nil记录，不超过4 * MIN条。
+*/
+#define RBTREE_SPILL_SLOT_RECORDS (4 * RBTREE_SPILL_MIN_NODES)
+#define RBTREE_SPILL_SLOT_BYTES   ((long long)(sizeof(long long) + RBTREE_SPILL_SLOT_RECORDS * sizeof(t_spill_record)))
+
+// 分配编号最小的空闲槽位，没有空闲槽位时在文件末尾新增一个
+static long long __spill_alloc_slot(t_rbtree *tree) {
+    if (!tree->free_slots.empty()) {
+        long long slot = *tree->free_slots.begin();
+        tree->free_slots.erase(tree->free_slots.begin());
+        return slot;
+    }
+
+    return tree->spill_slots++;
+}
+
+// 释放槽位，文件末尾连续的空闲槽位直接截掉
+static void __spill_free_slot(t_rbtree *tree, long long slot) {
+    tree->free_slots.insert(slot);
+
+    long long slots = tree->spill_slots;
+    while (slots > 0 && tree->free_slots.erase(slots - 1)) {
+        --slots;
+    }
+    if (slots != tree->spill_slots) {
+        tree->spill_slots = slots;
+        if (ftruncate(tree->spill_fd, slots * RBTREE_SPILL_SLOT_BYTES) != 0) {
+            // 截断失败不影响正确性，只是文件没有变小，之后新增的槽位会覆盖这部分空间
+        }
+    }
+}
+static void __spill_serialize(t_rbtree_node *root, vector<t_spill_record>& records) {
+    if (root == nil_node) {
+        records.push_back({SPILL_REC_NIL, 0, 0, 0, 0});
+        return;
+    }
+
+    if (root->spilled) {
+        records.push_back({SPILL_REC_STUB, root->key, root->color, root->referenced, root->spill_offset});
+        return;
+    }
+
+    records.push_back({SPILL_REC_NODE, root->key, root->color, root->referenced, 0});
+    __spill_serialize(root->left, records);
+    __spill_serialize(root->right, records);
+}
+
+static void __spill_destroy(t_rbtree *tree, t_rbtree_node *root) {
+    if (root == nil_node)
+        return;
+
+    if (!root->spilled) {
+        __spill_destroy(tree, root->left);
+        __spill_destroy(tree, root->right);
+    }
+    rbtree_free_node(tree, root);
+}
+
+static t_rbtree_node *__spill_rebuild(t_rbtree *tree, const vector<t_spill_record>& records, size_t& cursor) {
+    const t_spill_record& record = records[cursor++];
+    if (record.kind == SPILL_REC_NIL)
+        return nil_node;
+
+    t_rbtree_node *node = rbtree_create_node(tree, record.key);
+    node->color = record.color;
+    node->referenced = record.referenced;
+    if (record.kind == SPILL_REC_STUB) {
+        node->spilled = 1;
+        node->spill_offset = record.offset;
+        return node;
+    }
+
+    node->left = __spill_rebuild(tree, records, cursor);
+    node->right = __spill_rebuild(tree, records, cursor);
+    __spill_update(node);
+    return node;
+}
+
+// 把以root为根的子树写到文件中，返回替换它的存根节点
+static t_rbtree_node *__rbtree_spill(t_rbtree *tree, t_rbtree_node *root) {
+    vector<t_spill_record> records;
+    __spill_serialize(root, records);
+
+    long long count = records.size();
+    if (count > RBTREE_SPILL_SLOT_RECORDS)
+        return root;
+
+    long long slot = __spill_alloc_slot(tree);
+    long long offset = slot * RBTREE_SPILL_SLOT_BYTES;
+    if (pwrite(tree->spill_fd, &count, sizeof(count), offset) != (ssize_t)sizeof(count) ||
+        pwrite(tree->spill_fd, records.data(), count * sizeof(t_spill_record), offset + sizeof(count)) !=
+            (ssize_t)(count * sizeof(t_spill_record))) {
+        // 写失败了就不换出，宁可超出预算也不能丢数据
+        __spill_free_slot(tree, slot);
+        return root;
+    }
+
+    t_rbtree_node *stub = rbtree_create_node(tree, root->key);
+    stub->color = root->color;
+    stub->referenced = 0;
+    stub->spilled = 1;
+    stub->spill_offset = offset;
+
+    __spill_destroy(tree, root);
+    tree->spill_count++;
+    return stub;
+}
+
+// 从文件中读出存根节点对应的子树，失败时返回nullptr
+static t_rbtree_node *__spill_load(t_rbtree *tree, const t_rbtree_node *stub) {
+    long long count = 0;
+    if (pread(tree->spill_fd, &count, sizeof(count), stub->spill_offset) != (ssize_t)sizeof(count))
+        return nullptr;
+
+    vector<t_spill_record> records(count);
+    if (pread(tree->spill_fd, records.data(), count * sizeof(t_spill_record), stub->spill_offset + sizeof(count)) !=
+        (ssize_t)(count * sizeof(t_spill_record)))
+        return nullptr;
+
+    size_t cursor = 0;
+    t_rbtree_node *root = __spill_rebuild(tree, records, cursor);
+    // 存根节点的颜色可能在换出期间被修改过，以存根节点为准
+    root->color = stub->color;
+    return root;
+}
+
+// 如果node是存根节点，则把它换入，返回换入后的子树根节点；否则原样返回
+static t_rbtree_node *__rbtree_fault(t_rbtree *tree, t_rbtree_node *node) {
+    if (node == nil_node || !node->spilled)
+        return node;
+
+    t_rbtree_node *root = __spill_load(tree, node);
+    if (root == nullptr) {
+        std::fprintf(stderr, "rbtree: failed to fault in subtree at offset %lld\n", node->spill_offset);
+        std::abort();
+    }
+
+    __spill_free_slot(tree, node->spill_offset / RBTREE_SPILL_SLOT_BYTES);
+    rbtree_free_node(tree, node);
+    tree->fault_count++;
+    return root;
+}
+
+// 换入兄弟节点及其两个孩子，删除调整前调用
+static t_rbtree_node *__rbtree_fault_sibling(t_rbtree *tree, t_rbtree_node *sibling) {
+    sibling = __rbtree_fault(tree, sibling);
+    sibling->left = __rbtree_fault(tree, sibling->left);
+    sibling->right = __rbtree_fault(tree, sibling->right);
+    __spill_update(sibling);
+    return sibling;
+}
+
+// 沿着时钟指针的方向找到一棵候选子树，访问位置位时给它第二次机会，否则换出。没有可以换出的子树时返回0
+static int __rbtree_evict_one(t_rbtree *tree) {
+    if (tree->root->size < RBTREE_SPILL_MIN_NODES)
+        return 0;
+
+    t_rbtree_node **path[RBTREE_MAX_HEIGHT];
+    int depth = 0;
+    long long bound = LLONG_MAX;            // 当前子树中key的上界（不含）
+    t_rbtree_node **link = &tree->root;
+    while (true) {
+        t_rbtree_node *node = *link;
+        path[depth++] = link;
+
+        // 优先走时钟指针所在的一侧，那一侧不够大时走另一侧，两侧都不够大时node就是候选子树
+        t_rbtree_node **prefer = (tree->hand_key < node->key ? &node->left : &node->right);
+        t_rbtree_node **other = (prefer == &node->left ? &node->right : &node->left);
+        t_rbtree_node **next = ((*prefer)->size >= RBTREE_SPILL_MIN_NODES ? prefer :
+                                (*other)->size >= RBTREE_SPILL_MIN_NODES ? other : nullptr);
+        if (next == nullptr)
+            break;
+
+        if (next == &node->left) {
+            bound = node->key;
+        }
+        link = next;
+    }
+
+    // 根节点必须常驻内存
+    if (depth == 1)
+        return 0;
+
+    // 时钟指针移到这棵子树的右边，扫到最右边之后回到最左边
+    tree->hand_key = (bound == LLONG_MAX ? LLONG_MIN : bound);
+
+    t_rbtree_node *candidate = *link;
+    if (candidate->referenced) {
+        candidate->referenced = 0;
+        return 1;
+    }
+
+    *link = __rbtree_spill(tree, candidate);
+    if (*link == candidate)
+        return 0;
+
+    for (int i = depth - 2; i >= 0; --i) {
+        __spill_update(*path[i]);
+    }
+    return 1;
+}
+
+/*
+    超出预算时推进时钟指针换出子树，直到降到预算的3/4以下，留出余量避免每次操作都触发换出。每棵候选子树最多被
+跳过一次，步数的上限是候选子树个数的两倍。
+*/
+static void __rbtree_enforce_budget(t_rbtree *tree) {
+    if (tree->budget_bytes == 0 || tree->used_bytes <= tree->budget_bytes)
+        return;
+
+    size_t low_watermark = tree->budget_bytes / 4 * 3;
+    long long steps = 2 * (tree->root->size / RBTREE_SPILL_MIN_NODES + 1);
+    while (tree->used_bytes > low_watermark && steps-- > 0) {
+        if (!__rbtree_evict_one(tree))
+            break;
+    }
+}
+
+/* ------------------------------ 红黑树基本操作 ------------------------------ */
+
+// 销毁以指定节点为根节点的子树，存根节点对应的子树只需释放存根节点本身
+void __rbtree_destroy(t_rbtree *tree, t_rbtree_node *root) {
+    if (root == nil_node)
+        return;
+
+    if (!root->spilled) {
+        __rbtree_destroy(tree, root->left);
+        __rbtree_destroy(tree, root->right);
+    }
+    rbtree_free_node(tree, root);
+}
+
+// 销毁整棵树并关闭换出文件
+void rbtree_destroy(t_rbtree *tree) {
+    if (tree == nullptr)
+        return;
+
+    __rbtree_destroy(tree, tree->root);
+    tree->root = nil_node;
+    if (tree->spill_fd >= 0) {
+        close(tree->spill_fd);
+        tree->spill_fd = -1;
+    }
+    tree->spill_slots = 0;
+    tree->free_slots.clear();
+}
+
+int has_red_child_node(t_rbtree_node *node) {
+    if (nullptr == node)
+        return -1;
+
+    return node->left->color == RBTREE_CLR_RED || node->right->color == RBTREE_CLR_RED;
+}
+
+// 旋转之后先更新下沉的节点，再更新上浮的节点
+t_rbtree_node *rbtree_left_rotate(t_rbtree_node *up) {
+    t_rbtree_node *down = up->right;
+    up->right = down->left;
+    down->left = up;
+
+    __spill_update(up);
+    __spill_update(down);
+    return down;
+}
+
+t_rbtree_node *rbtree_right_rotate(t_rbtree_node *up) {
+    t_rbtree_node *down = up->left;
+    up->left = down->right;
+    down->right = up;
+
+    __spill_update(up);
+    __spill_update(down);
+    return down;
+}
+
+// 插入调整与red_black_tree_recursion.cpp完全相同，不需要换入任何节点，原因见文件开头的说明
+#define RBTREE_INSERT_CLT_NONE  0
+#define RBTREE_INSERT_CLT_LEFT  1
+#define RBTREE_INSERT_CLT_RIGHT 2
+t_rbtree_node *rbtree_insert_maintian(t_rbtree_node *root) {
+    if (!has_red_child_node(root))
+        return root;
+
+    if (root->left->color == RBTREE_CLR_RED && root->right->color == RBTREE_CLR_RED) {
+        root->color = RBTREE_CLR_RED;
+        root->left->color = root->right->color = RBTREE_CLR_BLK;
+
+        return root;
+    }
+
+    int has_red_conflict = RBTREE_INSERT_CLT_NONE;
+    if (root->left->color == RBTREE_CLR_RED && has_red_child_node(root->left)) {
+        has_red_conflict = RBTREE_INSERT_CLT_LEFT;
+    } else if (root->right->color == RBTREE_CLR_RED && has_red_child_node(root->right)) {
+        has_red_conflict = RBTREE_INSERT_CLT_RIGHT;
+    }
+
+    if (!has_red_conflict)
+        return root;
+
+    if (has_red_conflict == RBTREE_INSERT_CLT_LEFT) {
+        if (root->left->right->color == RBTREE_CLR_RED) {
+            root->left = rbtree_left_rotate(root->left);
+        }
+        root = rbtree_right_rotate(root);
+    } else if (has_red_conflict == RBTREE_INSERT_CLT_RIGHT) {
+        if (root->right->left->color == RBTREE_CLR_RED) {
+            root->right = rbtree_right_rotate(root->right);
+        }
+        root = rbtree_left_rotate(root);
+    }
+
+    root->color = RBTREE_CLR_RED;
+    root->left->color = root->right->color = RBTREE_CLR_BLK;
+    return root;
+}
+
+t_rbtree_node *__rbtree_insert(t_rbtree *tree, t_rbtree_node *root, USER_KEY_TYPE key) {
+    if (root == nil_node)
+        return rbtree_create_node(tree, key);
+
+    root = __rbtree_fault(tree, root);
+    root->referenced = 1;
+    if (root->key == key)
+        return root;
+
+    if (key < root->key) {
+        root->left = __rbtree_insert(tree, root->left, key);
+    } else {
+        root->right = __rbtree_insert(tree, root->right, key);
+    }
+
+    __spill_update(root);
+    return rbtree_insert_maintian(root);
+}
+
+void rbtree_insert(t_rbtree *tree, USER_KEY_TYPE key) {
+    if (tree == nullptr)
+        return;
+
+    __rbtree_enforce_budget(tree);
+    tree->root = __rbtree_insert(tree, tree->root, key);
+    tree->root->color = RBTREE_CLR_BLK;
+}
+
+// 查找指定key的节点，沿途换入存根节点，找不到时返回nullptr。返回的节点在下一次操作之前有效
+t_rbtree_node *rbtree_find(t_rbtree *tree, USER_KEY_TYPE key) {
+    if (tree == nullptr)
+        return nullptr;
+
+    __rbtree_enforce_budget(tree);
+
+    t_rbtree_node *result = nullptr;
+    t_rbtree_node **path[RBTREE_MAX_HEIGHT];
+    int depth = 0;
+    t_rbtree_node **link = &tree->root;
+    while (*link != nil_node) {
+        *link = __rbtree_fault(tree, *link);
+        path[depth++] = link;
+        t_rbtree_node *cursor = *link;
+        cursor->referenced = 1;
+        if (key == cursor->key) {
+            result = cursor;
+            break;
+        }
+
+        link = (key < cursor->key ? &cursor->left : &cursor->right);
+    }
+
+    // 换入改变了路径上各个子树的常驻节点数
+    for (int i = depth - 1; i >= 0; --i) {
+        __spill_update(*path[i]);
+    }
+    return result;
+}
+
+// 返回指定节点的前驱节点，沿途换入存根节点
+t_rbtree_node *__rbtree_find_predecessor(t_rbtree *tree, t_rbtree_node *node) {
+    t_rbtree_node **link = &node->left;
+    while (true) {
+        *link = __rbtree_fault(tree, *link);
+        if ((*link)->right == nil_node)
+            break;
+
+        link = &(*link)->right;
+    }
+
+    return *link;
+}
+
+// 删除调整的逻辑与red_black_tree_recursion.cpp相同，只是在开始之前先换入兄弟节点和侄子节点
+#define RBTREE_ERASE_CLT_NONE  0
+#define RBTREE_ERASE_CLT_LEFT  1
+#define RBTREE_ERASE_CLT_RIGHT 2
+t_rbtree_node *__rbtree_erase_maintain(t_rbtree *tree, t_rbtree_node *root) {
+    if (root->left->color != RBTREE_CLR_DBL && root->right->color != RBTREE_CLR_DBL) {
+        return root;
+    }
+
+    if (root->left->color == RBTREE_CLR_DBL) {
+        root->right = __rbtree_fault_sibling(tree, root->right);
+    } else {
+        root->left = __rbtree_fault_sibling(tree, root->left);
+    }
+    __spill_update(root);
+
+    // 兄弟节点是红色：旋转后双黑节点的新兄弟是原来的侄子节点，递归调用时会再换入它的孩子
+    if (has_red_child_node(root)) {
+        int has_red_conflict = RBTREE_ERASE_CLT_NONE;
+        root->color = RBTREE_CLR_RED;
+        if (root->left->color == RBTREE_CLR_RED) {
+            root = rbtree_right_rotate(root);
+            has_red_conflict = RBTREE_ERASE_CLT_LEFT;
+        } else {
+            root = rbtree_left_rotate(root);
+            has_red_conflict = RBTREE_ERASE_CLT_RIGHT;
+        }
+        root->color = RBTREE_CLR_BLK;
+
+        if (has_red_conflict == RBTREE_ERASE_CLT_LEFT) {
+            root->right = __rbtree_erase_maintain(tree, root->right);
+        } else {
+            root->left = __rbtree_erase_maintain(tree, root->left);
+        }
+        __spill_update(root);
+
+        return root;
+    }
+
+    if ((root->left->color == RBTREE_CLR_DBL && !has_red_child_node(root->right)) ||
+        (root->right->color == RBTREE_CLR_DBL && !has_red_child_node(root->left))) {
+
+        root->left->color -= RBTREE_CLR_BLK;
+        root->right->color -= RBTREE_CLR_BLK;
+
+        root->color += RBTREE_CLR_BLK;
+        return root;
+    }
+
+    if (root->left->color == RBTREE_CLR_DBL) {
+        if (root->right->left->color == RBTREE_CLR_RED) {
+            root->right->color = RBTREE_CLR_RED;
+            root->right = rbtree_right_rotate(root->right);
+            root->right->color = RBTREE_CLR_BLK;
+        }
+
+        root->left->color -= RBTREE_CLR_BLK;
+        root = rbtree_left_rotate(root);
+        root->color = root->left->color;
+    } else {
+        if (root->left->right->color == RBTREE_CLR_RED) {
+            root->left->color = RBTREE_CLR_RED;
+            root->left = rbtree_left_rotate(root->left);
+            root->left->color = RBTREE_CLR_BLK;
+        }
+
+        root->right->color -= RBTREE_CLR_BLK;
+        root = rbtree_right_rotate(root);
+        root->color = root->right->color;
+    }
+
+    root->left->color = root->right->color = RBTREE_CLR_BLK;
+
+    return root;
+}
+
+t_rbtree_node *__rbtree_erase(t_rbtree *tree, t_rbtree_node *root, USER_KEY_TYPE key) {
+    if (root == nil_node)
+        return nil_node;
+
+    root = __rbtree_fault(tree, root);
+    root->referenced = 1;
+    if (key < root->key) {
+        root->left = __rbtree_erase(tree, root->left, key);
+    } else if (key > root->key) {
+        root->right = __rbtree_erase(tree, root->right, key);
+    } else {
+        if (root->left == nil_node || root->right == nil_node) {
+            t_rbtree_node *child = (root->left != nil_node ? root->left : root->right);
+            child->color += root->color;
+            rbtree_free_node(tree, root);
+
+            return child;
+        }
+
+        t_rbtree_node *prev_node = __rbtree_find_predecessor(tree, root);
+        root->key = prev_node->key;
+        root->left = __rbtree_erase(tree, root->left, prev_node->key);
+    }
+
+    __spill_update(root);
+    return __rbtree_erase_maintain(tree, root);
+}
+
+void rbtree_erase(t_rbtree *tree, USER_KEY_TYPE key) {
+    if (tree == nullptr)
+        return;
+
+    __rbtree_enforce_budget(tree);
+    tree->root = __rbtree_erase(tree, tree->root, key);
+    tree->root->color = RBTREE_CLR_BLK;
+}
+
+/*
+    中序遍历不能把整棵树都换入内存，否则一次导出就会打破预算。遇到存根节点时把它对应的子树临时读入，遍历完就释放，
+不挂回树上。
+*/
+void __inorder_traversal(t_rbtree *tree, t_rbtree_node *root, vector<int>& result) {
+    if (root == nil_node) {
+        return;
+    }
+
+    if (root->spilled) {
+        t_rbtree_node *subtree = __spill_load(tree, root);
+        if (subtree) {
+            __inorder_traversal(tree, subtree, result);
+            __rbtree_destroy(tree, subtree);
+        }
+        return;
+    }
+
+    __inorder_traversal(tree, root->left, result);
+    result.emplace_back(root->key);
+    __inorder_traversal(tree, root->right, result);
+}
+
+int inorder_traversal(t_rbtree *tree, vector<int>& result) {
+    if (nullptr == tree)
+        return -1;
+
+    __inorder_traversal(tree, tree->root, result);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *spill_path = argc > 1 ? argv[1] : "/tmp/rbtree_spill.bin";
+
+    // 预算只够放下大约8000个节点，插入20万个随机key
+    t_rbtree tree;
+    if (rbtree_init(&tree, 8192 * sizeof(t_rbtree_node), spill_path) != 0) {
+        std::perror("rbtree_init");
+        return 1;
+    }
+
+    std::set<int> expected;
+    std::srand(20260417);
+    for (int i = 0; i < 200000; ++i) {
+        int key = std::rand() % 1000000;
+        rbtree_insert(&tree, key);
+        expected.insert(key);
+    }
+    std::printf("after insert: used %zu bytes (budget %zu), spilled %lld subtrees\n",
+                tree.used_bytes, tree.budget_bytes, tree.spill_count);
+
+    // 删除一部分，再反复访问一小段热点key
+    for (int i = 0; i < 20000; ++i) {
+        int key = std::rand() % 1000000;
+        rbtree_erase(&tree, key);
+        expected.erase(key);
+    }
+
+    long long faults = tree.fault_count;
+    int misses = 0;
+    for (int round = 0; round < 10; ++round) {
+        for (auto it = expected.lower_bound(500000); it != expected.end() && *it < 502000; ++it) {
+            misses += (rbtree_find(&tree, *it) == nullptr);
+        }
+    }
+    std::printf("hot lookups: %d misses, %lld faults, used %zu bytes\n",
+                misses, tree.fault_count - faults, tree.used_bytes);
+    std::printf("spill file: %lld slots (%lld free), %lld KB\n", tree.spill_slots,
+                (long long)tree.free_slots.size(), tree.spill_slots * RBTREE_SPILL_SLOT_BYTES / 1024);
+
+    vector<int> result;
+    inorder_traversal(&tree, result);
+    std::printf("inorder: %zu keys, %s\n", result.size(),
+                std::equal(result.begin(), result.end(), expected.begin(), expected.end()) ? "match" : "MISMATCH");
+
+    rbtree_destroy(&tree);
+    unlink(spill_path);
+    return 0;
+}
@@ -0,0 +1,548 @@
+/**
+ * @file red_black_tree_timeseries.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 时间序列索引：int64时间戳为key的带聚合红黑树，尾部追加均摊O(1)，按前缀整体删除过期数据，窗口聚合查询O(log n)
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <vector>
+
+using std::vector;
+
+typedef int64_t USER_KEY_TYPE;      // 时间戳
+typedef double USER_VALUE_TYPE;     // 指标的取值
+
+#define RBTREE_CLR_RED 0
+#define RBTREE_CLR_BLK 1
+#define RBTREE_CLR_DBL 2
+
+/*
+    指标流水线的三种操作：绝大多数写入的时间戳比已有的都大（追加）；定期删除保留期之前的所有数据；仪表盘反复查询
+[t0, t1)窗口内的count/sum/min/max。用std::map时每次查询都要把窗口内的点扫一遍。
+
+    1. 子树聚合：每个节点额外记录子树中的点数、取值之和、最小值和最大值。四个量都满足结合律和交换律，与merkle树中的
+       子树哈希一样，旋转之后只需要先更新下沉的节点，再更新上浮的节点。窗口查询沿着t0和t1两条查找路径，把路径之间
+       的整棵子树直接合并进结果，O(log n)。
+    2. 尾部追加：逐个插入时每个点都要从根走到最右侧的叶子并沿途更新聚合，是O(log n)的。这里把时间戳大于所有已有
+       数据的点先按顺序放进尾部缓冲区（O(1)），攒满TS_APPEND_BATCH个以后，由缓冲区直接构建一棵平衡的子树（与
+       adaptive_tree.cpp中的__rbtree_build相同，O(B)），再用连接操作（join）挂到树的最右侧：沿着右侧的脊往下找到
+       黑高相同的黑色节点，把子树接在这里，然后像插入一样沿着右脊向上消除红红冲突，只涉及右脊上的O(log n)个节点。
+       每个点分摊到的代价是O(1 + log n / B)，B不小于log n时就是均摊O(1)。查询时尾部缓冲区中的点单独扫描一遍，
+       最多B个。时间戳不大于已有最大值的乱序写入先把缓冲区合并进树，再走普通的递归插入，时间戳相同时覆盖取值。
+    3. 按前缀删除：保留期之前的数据是树中一个完整的前缀。沿着cutoff的查找路径向下，路径左侧的节点和它们的左子树
+       整体释放；路径右侧的节点和它们的右子树从下往上依次用join重新连接起来（即split只保留右半部分）。每次join的
+       代价是两棵树黑高的差，沿路径累加起来是O(log n)，释放节点是O(被删除的点数)，每个点只会被释放一次。
+    join需要知道两棵树的黑高，这里记录整棵树的黑高（不计nil，根是黑色），子树的黑高在递归中由父节点推出来。
+*/
+
+typedef struct rbtree_node {
+    USER_KEY_TYPE key;
+    USER_VALUE_TYPE value;
+    int color;
+    struct rbtree_node *left;
+    struct rbtree_node *right;
+    long long count;            // 子树中的点数
+    USER_VALUE_TYPE sum;        // 子树中取值之和
+    USER_VALUE_TYPE min;
+    USER_VALUE_TYPE max;
+} t_rbtree_node;
+
+typedef struct rbtree {
+    t_rbtree_node *root;
+} t_rbtree;
+
+typedef struct ts_point {
+    USER_KEY_TYPE ts;
+    USER_VALUE_TYPE value;
+} t_ts_point;
+
+// 窗口聚合的结果，没有点时count为0，min/max分别为+inf/-inf
+typedef struct ts_aggregate {
+    long long count;
+    USER_VALUE_TYPE sum;
+    USER_VALUE_TYPE min;
+    USER_VALUE_TYPE max;
+} t_ts_aggregate;
+
+// 尾部缓冲区的容量，不小于树高即可让追加均摊O(1)
+#define TS_APPEND_BATCH 64
+
+typedef struct ts_index {
+    t_rbtree tree;
+    int black_height;           // 树的黑高，不计nil，空树为0
+    USER_KEY_TYPE tree_max;     // 树中最大的key，树为空时无意义
+    vector<t_ts_point> tail;    // 时间戳严格递增且大于树中所有key的点
+    long long size;             // 树和尾部缓冲区中的总点数
+} t_ts_index;
+
+t_rbtree_node __nil_node;
+
+#define nil_node (&__nil_node)
+
+__attribute__((constructor))
+void init_nil_node() {
+     __nil_node.key = 0;
+     __nil_node.value = 0;
+     __nil_node.color = RBTREE_CLR_BLK;
+     __nil_node.left = __nil_node.right = nil_node;
+     __nil_node.count = 0;
+     __nil_node.sum = 0;
+     __nil_node.min = INFINITY;
+     __nil_node.max = -INFINITY;
+}
+
+// 根据两个孩子重新计算节点的聚合值
+static void __ts_update(t_rbtree_node *node) {
+    node->count = node->left->count + node->right->count + 1;
+    node->sum = node->left->sum + node->right->sum + node->value;
+    node->min = std::min(std::min(node->left->min, node->right->min), node->value);
+    node->max = std::max(std::max(node->left->max, node->right->max), node->value);
+}
+
+t_rbtree_node *rbtree_create_node(USER_KEY_TYPE key, USER_VALUE_TYPE value) {
+    t_rbtree_node *node = new t_rbtree_node;
+    node->key = key;
+    node->value = value;
+    node->color = RBTREE_CLR_RED;
+    node->left = node->right = nil_node;
+    __ts_update(node);
+
+    return node;
+}
+
+void __rbtree_destroy(t_rbtree_node *root) {
+    if (root == nil_node)
+        return;
+
+    __rbtree_destroy(root->left);
+    __rbtree_destroy(root->right);
+    delete root;
+}
+
+// 旋转和插入调整来自red_black_tree_augmented.cpp，旋转之后用__ts_update重新计算聚合值；join向上回溯时也用插入调整消除红红冲突
+#define RBTREE_AUGMENT_UPDATE(node) __ts_update(node)
+#include "red_black_tree_augmented.cpp"
+
+// 插入或覆盖一个点，返回根节点；inserted记录是否新增了节点
+t_rbtree_node *__rbtree_insert(t_rbtree_node *root, USER_KEY_TYPE key, USER_VALUE_TYPE value, int *inserted) {
+    if (root == nil_node) {
+        *inserted = 1;
+        return rbtree_create_node(key, value);
+    }
+
+    if (key == root->key) {
+        root->value = value;
+    } else if (key < root->key) {
+        root->left = __rbtree_insert(root->left, key, value, inserted);
+    } else {
+        root->right = __rbtree_insert(root->right, key, value, inserted);
+    }
+
+    __ts_update(root);
+    return rbtree_insert_maintian(root);
+}
+
+/* ------------------------------------ 连接 ------------------------------------ */
+
+// left的黑高不小于right：沿left的右脊找到黑高与right相同的黑色节点，用mid把两者连起来
+static t_rbtree_node *__ts_join_right(t_rbtree_node *left, int left_height, t_rbtree_node *mid, t_rbtree_node *right,
+                                      int right_height) {
+    if (left_height == right_height && left->color == RBTREE_CLR_BLK) {
+        mid->color = RBTREE_CLR_RED;
+        mid->left = left;
+        mid->right = right;
+        __ts_update(mid);
+        return mid;
+    }
+
+    left->right = __ts_join_right(left->right, left_height - (left->color == RBTREE_CLR_BLK), mid, right, right_height);
+    __ts_update(left);
+    return rbtree_insert_maintian(left);
+}
+
+// 与__ts_join_right对称，right的黑高大于left
+static t_rbtree_node *__ts_join_left(t_rbtree_node *left, int left_height, t_rbtree_node *mid, t_rbtree_node *right,
+                                     int right_height) {
+    if (left_height == right_height && right->color == RBTREE_CLR_BLK) {
+        mid->color = RBTREE_CLR_RED;
+        mid->left = left;
+        mid->right = right;
+        __ts_update(mid);
+        return mid;
+    }
+
+    right->left = __ts_join_left(left, left_height, mid, right->left, right_height - (right->color == RBTREE_CLR_BLK));
+    __ts_update(right);
+    return rbtree_insert_maintian(right);
+}
+
+/*
+    连接：left中所有的key < mid->key < right中所有的key，返回连接后的根（黑色），新的黑高写入height。
+    代价是O(|left_height - right_height| + 1)。
+*/
+static t_rbtree_node *__ts_join(t_rbtree_node *left, int left_height, t_rbtree_node *mid, t_rbtree_node *right,
+                                int right_height, int *height) {
+    // 两边的根先染黑，避免红色的根接到红色的mid下面
+    if (left->color == RBTREE_CLR_RED) {
+        left->color = RBTREE_CLR_BLK;
+        ++left_height;
+    }
+    if (right->color == RBTREE_CLR_RED) {
+        right->color = RBTREE_CLR_BLK;
+        ++right_height;
+    }
+
+    t_rbtree_node *root;
+    if (left_height >= right_height) {
+        root = __ts_join_right(left, left_height, mid, right, right_height);
+    } else {
+        root = __ts_join_left(left, left_height, mid, right, right_height);
+    }
+
+    *height = std::max(left_height, right_height);
+    if (root->color == RBTREE_CLR_RED) {
+        root->color = RBTREE_CLR_BLK;
+        ++*height;
+    }
+    return root;
+}
+
+// 由有序的点构建平衡的子树，最后一层染红，与adaptive_tree.cpp中的__rbtree_build相同
+static t_rbtree_node *__ts_build(const t_ts_point *points, long long lo, long long hi, int depth, int full_levels) {
+    if (lo >= hi)
+        return nil_node;
+
+    long long mid = lo + (hi - lo) / 2;
+    t_rbtree_node *node = rbtree_create_node(points[mid].ts, points[mid].value);
+    node->color = (depth >= full_levels ? RBTREE_CLR_RED : RBTREE_CLR_BLK);
+    node->left = __ts_build(points, lo, mid, depth + 1, full_levels);
+    node->right = __ts_build(points, mid + 1, hi, depth + 1, full_levels);
+    __ts_update(node);
+
+    return node;
+}
+
+/*
+    删除以root为根、黑高为height的子树中所有key < cutoff的点，返回剩下的子树（根为黑色），新的黑高写入new_height，
+    删除的点数累加到dropped。
+*/
+static t_rbtree_node *__ts_drop_before(t_rbtree_node *root, int height, USER_KEY_TYPE cutoff, int *new_height,
+                                       long long *dropped) {
+    // 路径左侧的节点连同左子树整体释放，继续在右子树中删除
+    while (root != nil_node && root->key < cutoff) {
+        int child_height = height - (root->color == RBTREE_CLR_BLK);
+        t_rbtree_node *right = root->right;
+        *dropped += root->left->count + 1;
+        __rbtree_destroy(root->left);
+        delete root;
+
+        root = right;
+        height = child_height;
+    }
+
+    if (root == nil_node) {
+        *new_height = 0;
+        return nil_node;
+    }
+
+    // root要保留：先处理左子树，再以root为中间节点把剩下的左半部分和右子树连起来
+    int child_height = height - (root->color == RBTREE_CLR_BLK);
+    int left_height;
+    t_rbtree_node *left = __ts_drop_before(root->left, child_height, cutoff, &left_height, dropped);
+    return __ts_join(left, left_height, root, root->right, child_height, new_height);
+}
+
+/* ---------------------------------- 时间序列索引 --------------------------------- */
+
+void ts_index_init(t_ts_index *index) {
+    index->tree.root = nil_node;
+    index->black_height = 0;
+    index->tree_max = 0;
+    index->tail.clear();
+    index->tail.reserve(TS_APPEND_BATCH);
+    index->size = 0;
+}
+
+void ts_index_destroy(t_ts_index *index) {
+    if (index == nullptr)
+        return;
+
+    __rbtree_destroy(index->tree.root);
+    ts_index_init(index);
+}
+
+// 把尾部缓冲区合并进树：第一个点作为中间节点，其余的点构建成子树，连接到树的右侧
+static void __ts_flush_tail(t_ts_index *index) {
+    if (index->tail.empty())
+        return;
+
+    long long count = index->tail.size() - 1;
+    int full_levels = 0;
+    while ((1LL << (full_levels + 1)) - 1 <= count) {
+        ++full_levels;
+    }
+
+    t_rbtree_node *mid = rbtree_create_node(index->tail[0].ts, index->tail[0].value);
+    t_rbtree_node *right = __ts_build(index->tail.data(), 1, count + 1, 0, full_levels);
+    index->tree.root = __ts_join(index->tree.root, index->black_height, mid, right, full_levels, &index->black_height);
+    index->tree_max = index->tail.back().ts;
+    index->tail.clear();
+}
+
+// 写入一个点：时间戳大于已有的所有点时均摊O(1)，否则O(log n)；时间戳已存在时覆盖取值
+void ts_index_insert(t_ts_index *index, USER_KEY_TYPE ts, USER_VALUE_TYPE value) {
+    if (index == nullptr)
+        return;
+
+    // 尾部追加：比缓冲区中最后一个点（缓冲区为空时是树中的最大值）更新
+    if (index->tail.empty() ? (index->tree.root == nil_node || ts > index->tree_max) : ts > index->tail.back().ts) {
+        index->tail.push_back({ts, value});
+        ++index->size;
+        if (index->tail.size() == TS_APPEND_BATCH) {
+            __ts_flush_tail(index);
+        }
+        return;
+    }
+
+    if (!index->tail.empty() && ts == index->tail.back().ts) {
+        index->tail.back().value = value;
+        return;
+    }
+
+    // 乱序写入
+    __ts_flush_tail(index);
+    int inserted = 0;
+    if (index->tree.root == nil_node || ts > index->tree_max) {
+        index->tree_max = ts;
+    }
+    index->tree.root = __rbtree_insert(index->tree.root, ts, value, &inserted);
+    if (index->tree.root->color == RBTREE_CLR_RED) {
+        index->tree.root->color = RBTREE_CLR_BLK;
+        ++index->black_height;
+    }
+    index->size += inserted;
+}
+
+// 删除所有时间戳小于cutoff的点，返回删除的点数
+long long ts_index_drop_before(t_ts_index *index, USER_KEY_TYPE cutoff) {
+    if (index == nullptr)
+        return 0;
+
+    long long dropped = 0;
+    index->tree.root = __ts_drop_before(index->tree.root, index->black_height, cutoff, &index->black_height, &dropped);
+
+    // 缓冲区中的点都比树中的新，只有树被删空时才可能涉及
+    auto keep = std::lower_bound(index->tail.begin(), index->tail.end(), cutoff,
+                                 [](const t_ts_point& point, USER_KEY_TYPE ts) { return point.ts < ts; });
+    dropped += keep - index->tail.begin();
+    index->tail.erase(index->tail.begin(), keep);
+
+    index->size -= dropped;
+    return dropped;
+}
+
+static void __ts_merge(t_ts_aggregate *result, long long count, USER_VALUE_TYPE sum, USER_VALUE_TYPE min,
+                       USER_VALUE_TYPE max) {
+    result->count += count;
+    result->sum += sum;
+    result->min = std::min(result->min, min);
+    result->max = std::max(result->max, max);
+}
+
+// 合并整棵子树
+static void __ts_merge_subtree(t_ts_aggregate *result, t_rbtree_node *root) {
+    __ts_merge(result, root->count, root->sum, root->min, root->max);
+}
+
+static void __ts_merge_node(t_ts_aggregate *result, t_rbtree_node *node) {
+    __ts_merge(result, 1, node->value, node->value, node->value);
+}
+
+// 窗口[t0, t1)内的count/sum/min/max，O(log n + TS_APPEND_BATCH)
+t_ts_aggregate ts_index_query(t_ts_index *index, USER_KEY_TYPE t0, USER_KEY_TYPE t1) {
+    t_ts_aggregate result = {0, 0, INFINITY, -INFINITY};
+    if (index == nullptr || t0 >= t1)
+        return result;
+
+    // 先找到第一个落在窗口中的节点，它是t0和t1两条查找路径分叉的地方
+    t_rbtree_node *root = index->tree.root;
+    while (root != nil_node && (root->key < t0 || root->key >= t1)) {
+        root = (root->key < t0 ? root->right : root->left);
+    }
+
+    if (root != nil_node) {
+        __ts_merge_node(&result, root);
+
+        // 左子树中 >= t0 的部分：节点在窗口中时，它的右子树整体都在窗口中
+        for (t_rbtree_node *cursor = root->left; cursor != nil_node;) {
+            if (cursor->key >= t0) {
+                __ts_merge_node(&result, cursor);
+                __ts_merge_subtree(&result, cursor->right);
+                cursor = cursor->left;
+            } else {
+                cursor = cursor->right;
+            }
+        }
+
+        // 右子树中 < t1 的部分，与上面对称
+        for (t_rbtree_node *cursor = root->right; cursor != nil_node;) {
+            if (cursor->key < t1) {
+                __ts_merge_node(&result, cursor);
+                __ts_merge_subtree(&result, cursor->left);
+                cursor = cursor->right;
+            } else {
+                cursor = cursor->left;
+            }
+        }
+    }
+
+    for (auto& point : index->tail) {
+        if (point.ts >= t0 && point.ts < t1) {
+            __ts_merge(&result, 1, point.value, point.value, point.value);
+        }
+    }
+
+    return result;
+}
+
+// 检查红黑树的性质和聚合值，返回黑高（不计nil），不合法时返回-1
+static int __ts_check(t_rbtree_node *root, long long lo, long long hi) {
+    if (root == nil_node)
+        return 0;
+    if (root->key <= lo || root->key >= hi)
+        return -1;
+    if (root->color == RBTREE_CLR_RED && has_red_child_node(root))
+        return -1;
+    if (root->count != root->left->count + root->right->count + 1)
+        return -1;
+
+    int left = __ts_check(root->left, lo, root->key);
+    int right = __ts_check(root->right, root->key, hi);
+    if (left < 0 || left != right)
+        return -1;
+
+    return left + (root->color == RBTREE_CLR_BLK);
+}
+
+int ts_index_check(t_ts_index *index) {
+    if (index->tree.root->color != RBTREE_CLR_BLK)
+        return -1;
+
+    int height = __ts_check(index->tree.root, INT64_MIN, INT64_MAX);
+    if (height != index->black_height)
+        return -1;
+    if (index->tree.root->count + (long long)index->tail.size() != index->size)
+        return -1;
+
+    return 0;
+}
+
+/* ---------------------------------- 性能对比 --------------------------------- */
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 对照组：std::map，每次查询扫描窗口内的所有点
+static t_ts_aggregate map_query(const std::map<USER_KEY_TYPE, USER_VALUE_TYPE>& points, USER_KEY_TYPE t0,
+                                USER_KEY_TYPE t1) {
+    t_ts_aggregate result = {0, 0, INFINITY, -INFINITY};
+    for (auto it = points.lower_bound(t0); it != points.end() && it->first < t1; ++it) {
+        __ts_merge(&result, 1, it->second, it->second, it->second);
+    }
+    return result;
+}
+
+static int same_aggregate(const t_ts_aggregate& a, const t_ts_aggregate& b) {
+    // 求和的顺序不同，浮点误差允许有一点差别
+    return a.count == b.count && a.min == b.min && a.max == b.max &&
+           std::fabs(a.sum - b.sum) <= 1e-9 * std::max(1.0, std::fabs(a.sum));
+}
+
+int main(int argc, char *argv[]) {
+    long long count = argc > 1 ? std::atoll(argv[1]) : 5000000;
+    long long queries = argc > 2 ? std::atoll(argv[2]) : 20000;
+
+    // 每10ms一个点，1%的点迟到最多1s；保留最近1小时（36万个点），每写入1万个点做一次过期删除
+    const USER_KEY_TYPE step = 10, retention = 3600 * 1000;
+    std::mt19937_64 rng(20260417);
+    vector<t_ts_point> points(count);
+    for (long long i = 0; i < count; ++i) {
+        USER_KEY_TYPE ts = i * step;
+        if (rng() % 100 == 0) {
+            ts -= rng() % 1000;
+        }
+        points[i] = {ts, (USER_VALUE_TYPE)(rng() % 100000) / 100};
+    }
+
+    // 仪表盘查询：最近5分钟、1小时内的随机窗口
+    vector<t_ts_point> windows(queries);
+    for (long long i = 0; i < queries; ++i) {
+        USER_KEY_TYPE length = (i % 2 == 0 ? 300 * 1000 : (USER_KEY_TYPE)(rng() % retention));
+        windows[i] = {(USER_KEY_TYPE)(count * step - retention + rng() % (retention - length + 1)), (USER_VALUE_TYPE)length};
+    }
+
+    t_ts_index index;
+    ts_index_init(&index);
+    auto start = std::chrono::steady_clock::now();
+    long long dropped = 0;
+    for (long long i = 0; i < count; ++i) {
+        ts_index_insert(&index, points[i].ts, points[i].value);
+        if (i % 10000 == 9999) {
+            dropped += ts_index_drop_before(&index, points[i].ts - retention);
+        }
+    }
+    double index_ingest = elapsed_ms(start);
+
+    std::map<USER_KEY_TYPE, USER_VALUE_TYPE> reference;
+    start = std::chrono::steady_clock::now();
+    for (long long i = 0; i < count; ++i) {
+        reference[points[i].ts] = points[i].value;
+        if (i % 10000 == 9999) {
+            reference.erase(reference.begin(), reference.lower_bound(points[i].ts - retention));
+        }
+    }
+    double map_ingest = elapsed_ms(start);
+
+    vector<t_ts_aggregate> expected(queries), actual(queries);
+    start = std::chrono::steady_clock::now();
+    for (long long i = 0; i < queries; ++i) {
+        actual[i] = ts_index_query(&index, windows[i].ts, windows[i].ts + (USER_KEY_TYPE)windows[i].value);
+    }
+    double index_query = elapsed_ms(start);
+
+    start = std::chrono::steady_clock::now();
+    for (long long i = 0; i < queries; ++i) {
+        expected[i] = map_query(reference, windows[i].ts, windows[i].ts + (USER_KEY_TYPE)windows[i].value);
+    }
+    double map_query_ms = elapsed_ms(start);
+
+    long long mismatches = 0;
+    for (long long i = 0; i < queries; ++i) {
+        mismatches += !same_aggregate(actual[i], expected[i]);
+    }
+
+    std::printf("%lld points, %lld kept (%lld dropped by retention), %lld window queries\n", count, index.size,
+                dropped, queries);
+    std::printf("%10s %14s %14s\n", "engine", "ingest ns/pt", "query us");
+    std::printf("%10s %14.1f %14.2f\n", "ts_index", index_ingest * 1e6 / count, index_query * 1e3 / queries);
+    std::printf("%10s %14.1f %14.2f\n", "std::map", map_ingest * 1e6 / count, map_query_ms * 1e3 / queries);
+    std::printf("size match: %s, query mismatches: %lld, tree check: %s\n",
+                index.size == (long long)reference.size() ? "yes" : "no", mismatches,
+                ts_index_check(&index) == 0 ? "ok" : "broken");
+
+    ts_index_destroy(&index);
+    return 0;
+}
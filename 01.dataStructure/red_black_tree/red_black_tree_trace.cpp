@@ -0,0 +1,541 @@
+/**
+ * @file red_black_tree_trace.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 树操作的轨迹录制与确定性回放：把线上的操作序列记录成紧凑的二进制文件，离线在不同的引擎配置上全速或按原始节奏重放
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 红黑树和可替换的节点内存池来自red_black_tree_hugepage.cpp，二叉搜索树来自binarySearchTree.cpp
+#define RBTREE_HUGEPAGE_NO_MAIN
+#include "red_black_tree_hugepage.cpp"
+#define BSTREE_NO_MAIN
+#include "binarySearchTree.cpp"
+
+using std::vector;
+
+/*
+    合成的基准测试（均匀随机、固定速率）复现不了线上的尾延迟：线上的请求有突发、有热点、插入删除交替出现，节点在内存中
+的分布也是长时间演化出来的。这里提供两部分：
+
+    1. 录制（默认关闭）：调用trace_start之后，traced_rbtree_insert/erase/find在执行操作的同时把（操作类型，key，
+       时间戳）追加到缓冲区中，缓冲区满了再整块写入文件。也可以设置环境变量RBTREE_TRACE=<path>，由
+       trace_start_from_env打开。没有打开录制时，包装函数只多一次指针判空。录制器不加锁，与红黑树本身一样只能在
+       单线程中使用。程序正常退出（从main返回或调用exit）时如果还没有调用trace_stop，atexit注册的函数会把缓冲区
+       中剩下的记录写出去；被信号杀掉时最后一块缓冲区会丢失，回放时只使用完整的记录。
+       文件格式：16字节的文件头（魔数"RBTR"、版本号、录制开始时的墙上时间），之后每条记录是
+           1字节操作类型 + varint(与上一条记录的时间差，单位ns) + varint(zigzag(key))
+       时间差通常只占1~3个字节，绝对值小的key也只占1~2个字节，即使是随机的31位key，一条记录也只有8个字节左右，
+       是定长的16字节记录的一半。
+    2. 回放：先把整个文件解码到内存中，解码不会干扰计时。每个引擎提供setup/insert/erase/find/teardown，回放时可以
+       选择的引擎包括：默认new/delete的红黑树、4K页和大页节点内存池上的红黑树、二叉搜索树和std::set，方便离线评估
+       内存分配器和内存布局的改动。两种节奏：
+       - full：全速执行，延迟是单个操作的执行时间；
+       - timed：按录制时的时间间隔（可以用speed加速）发出操作，延迟从“计划发出的时刻”算起到操作完成为止，
+         引擎一旦落后，排队的时间也会计入延迟，避免协调遗漏（coordinated omission）把尾延迟掩盖掉。
+*/
+
+#define TRACE_MAGIC        0x52544252u      // "RBTR"
+#define TRACE_VERSION      1
+#define TRACE_BUFFER_SIZE  (64 * 1024)
+
+#define TRACE_OP_INSERT 0
+#define TRACE_OP_ERASE  1
+#define TRACE_OP_FIND   2
+
+typedef struct trace_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint64_t start_unix_ns;
+} t_trace_header;
+
+typedef struct trace_record {
+    int op;
+    USER_KEY_TYPE key;
+    int64_t offset_ns;          // 相对于录制开始的时间
+} t_trace_record;
+
+typedef struct trace_recorder {
+    FILE *file;
+    uint8_t buffer[TRACE_BUFFER_SIZE];
+    size_t used;
+    int64_t last_ns;
+    long long records;
+} t_trace_recorder;
+
+// 为nullptr时表示没有在录制
+static t_trace_recorder *g_trace_recorder = nullptr;
+
+static int64_t trace_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint8_t *__trace_put_varint(uint8_t *cursor, uint64_t value) {
+    while (value >= 0x80) {
+        *cursor++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *cursor++ = (uint8_t)value;
+    return cursor;
+}
+
+// 解码一个varint，数据不完整返回nullptr
+static const uint8_t *__trace_get_varint(const uint8_t *cursor, const uint8_t *end, uint64_t *value) {
+    uint64_t result = 0;
+    for (int shift = 0; cursor < end && shift < 64; shift += 7) {
+        uint8_t byte = *cursor++;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            return cursor;
+        }
+    }
+    return nullptr;
+}
+
+static void __trace_flush(t_trace_recorder *recorder) {
+    if (recorder->used > 0) {
+        std::fwrite(recorder->buffer, 1, recorder->used, recorder->file);
+        recorder->used = 0;
+    }
+}
+
+// 结束录制，返回记录的条数
+long long trace_stop() {
+    t_trace_recorder *recorder = g_trace_recorder;
+    if (recorder == nullptr)
+        return 0;
+
+    __trace_flush(recorder);
+    std::fclose(recorder->file);
+    long long records = recorder->records;
+    delete recorder;
+    g_trace_recorder = nullptr;
+    return records;
+}
+
+static void __trace_atexit() {
+    trace_stop();
+}
+
+// 开始录制到path，已经在录制时先结束之前的录制，失败返回-1
+int trace_start(const char *path) {
+    if (g_trace_recorder != nullptr) {
+        trace_stop();
+    }
+
+    // 只注册一次，进程退出时结束还没有结束的录制
+    static int atexit_registered = 0;
+    if (!atexit_registered) {
+        std::atexit(__trace_atexit);
+        atexit_registered = 1;
+    }
+
+    FILE *file = std::fopen(path, "wb");
+    if (file == nullptr)
+        return -1;
+
+    t_trace_header header = {TRACE_MAGIC, TRACE_VERSION, 0,
+                             (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 std::chrono::system_clock::now().time_since_epoch()).count()};
+    std::fwrite(&header, sizeof(header), 1, file);
+
+    t_trace_recorder *recorder = new t_trace_recorder;
+    recorder->file = file;
+    recorder->used = 0;
+    recorder->last_ns = trace_now_ns();
+    recorder->records = 0;
+    g_trace_recorder = recorder;
+    return 0;
+}
+
+// 环境变量RBTREE_TRACE非空时开始录制，返回值与trace_start相同，没有设置时返回1
+int trace_start_from_env() {
+    const char *path = std::getenv("RBTREE_TRACE");
+    if (path == nullptr || *path == '\0')
+        return 1;
+
+    return trace_start(path);
+}
+
+static void trace_record(t_trace_recorder *recorder, int op, USER_KEY_TYPE key, int64_t now) {
+    // 一条记录最多1 + 10 + 5个字节
+    if (recorder->used + 16 > TRACE_BUFFER_SIZE) {
+        __trace_flush(recorder);
+    }
+
+    uint8_t *cursor = recorder->buffer + recorder->used;
+    *cursor++ = (uint8_t)op;
+    cursor = __trace_put_varint(cursor, (uint64_t)std::max<int64_t>(0, now - recorder->last_ns));
+    cursor = __trace_put_varint(cursor, ((uint32_t)key << 1) ^ (uint32_t)(key >> 31));
+    recorder->used = cursor - recorder->buffer;
+    recorder->last_ns = now;
+    ++recorder->records;
+}
+
+// 带录制的红黑树操作，时间戳取操作开始的时刻
+void traced_rbtree_insert(t_rbtree *tree, USER_KEY_TYPE key) {
+    if (g_trace_recorder != nullptr) {
+        trace_record(g_trace_recorder, TRACE_OP_INSERT, key, trace_now_ns());
+    }
+    rbtree_insert(tree, key);
+}
+
+void traced_rbtree_erase(t_rbtree *tree, USER_KEY_TYPE key) {
+    if (g_trace_recorder != nullptr) {
+        trace_record(g_trace_recorder, TRACE_OP_ERASE, key, trace_now_ns());
+    }
+    rbtree_erase(tree, key);
+}
+
+t_rbtree_node *traced_rbtree_find(t_rbtree *tree, USER_KEY_TYPE key) {
+    if (g_trace_recorder != nullptr) {
+        trace_record(g_trace_recorder, TRACE_OP_FIND, key, trace_now_ns());
+    }
+    return rbtree_find(tree, key);
+}
+
+/*
+    把整个轨迹文件解码到records中，全部解码成功返回0；文件不存在或文件头不对返回-1。
+    录制进程被杀掉时最后一块缓冲区可能只写了一半，最后一条记录不完整。这时保留之前所有完整的记录，返回丢弃的字节数，
+由调用者报告，而不是整个文件都不能用。
+*/
+long long trace_load(const char *path, vector<t_trace_record>& records, t_trace_header *header) {
+    FILE *file = std::fopen(path, "rb");
+    if (file == nullptr)
+        return -1;
+
+    vector<uint8_t> data;
+    uint8_t buffer[TRACE_BUFFER_SIZE];
+    size_t n;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + n);
+    }
+    std::fclose(file);
+
+    if (data.size() < sizeof(t_trace_header))
+        return -1;
+    std::memcpy(header, data.data(), sizeof(t_trace_header));
+    if (header->magic != TRACE_MAGIC || header->version != TRACE_VERSION)
+        return -1;
+
+    records.clear();
+    const uint8_t *cursor = data.data() + sizeof(t_trace_header);
+    const uint8_t *end = data.data() + data.size();
+    int64_t offset = 0;
+    while (cursor < end) {
+        const uint8_t *record_start = cursor;
+        int op = *cursor++;
+        uint64_t delta, zigzag;
+        if (op > TRACE_OP_FIND ||
+            (cursor = __trace_get_varint(cursor, end, &delta)) == nullptr ||
+            (cursor = __trace_get_varint(cursor, end, &zigzag)) == nullptr)
+            return end - record_start;
+
+        offset += (int64_t)delta;
+        USER_KEY_TYPE key = (USER_KEY_TYPE)((uint32_t)(zigzag >> 1) ^ -(uint32_t)(zigzag & 1));
+        records.push_back({op, key, offset});
+    }
+
+    return 0;
+}
+
+/* ---------------------------------- 回放引擎 --------------------------------- */
+
+typedef struct replay_engine {
+    const char *name;
+    void (*setup)();
+    void (*insert)(USER_KEY_TYPE key);
+    void (*erase)(USER_KEY_TYPE key);
+    int (*find)(USER_KEY_TYPE key);
+    void (*teardown)();
+} t_replay_engine;
+
+static t_rbtree g_replay_rbtree;
+static t_bstree g_replay_bstree;
+static std::set<USER_KEY_TYPE> g_replay_set;
+
+static void rbtree_engine_setup() {
+    rbtree_node_alloc = rbtree_default_node_alloc;
+    rbtree_node_free = rbtree_default_node_free;
+    rbtree_node_footprint = rbtree_default_node_footprint();
+    rbtree_init(&g_replay_rbtree);
+}
+
+static void rbtree_arena_4k_setup() {
+    node_arena_init(&g_node_arena, NODE_ARENA_PAGE_4K);
+    rbtree_node_alloc = node_arena_alloc;
+    rbtree_node_free = node_arena_free;
+    rbtree_node_footprint = NODE_ARENA_FOOTPRINT;
+    rbtree_init(&g_replay_rbtree);
+}
+
+static void rbtree_arena_huge_setup() {
+    node_arena_init(&g_node_arena, NODE_ARENA_PAGE_HUGE);
+    rbtree_node_alloc = node_arena_alloc;
+    rbtree_node_free = node_arena_free;
+    rbtree_node_footprint = NODE_ARENA_FOOTPRINT;
+    rbtree_init(&g_replay_rbtree);
+}
+
+static void rbtree_engine_insert(USER_KEY_TYPE key) { rbtree_insert(&g_replay_rbtree, key); }
+static void rbtree_engine_erase(USER_KEY_TYPE key) { rbtree_erase(&g_replay_rbtree, key); }
+static int rbtree_engine_find(USER_KEY_TYPE key) { return rbtree_find(&g_replay_rbtree, key) != nullptr; }
+
+static void rbtree_engine_teardown() {
+    rbtree_destroy(&g_replay_rbtree);
+    if (rbtree_node_alloc == node_arena_alloc) {
+        node_arena_destroy(&g_node_arena);
+    }
+    rbtree_node_alloc = rbtree_default_node_alloc;
+    rbtree_node_free = rbtree_default_node_free;
+    rbtree_node_footprint = rbtree_default_node_footprint();
+}
+
+static void bstree_engine_setup() { bstree_init(&g_replay_bstree); }
+static void bstree_engine_insert(USER_KEY_TYPE key) { insert_node_to_bstree(&g_replay_bstree, key); }
+static void bstree_engine_erase(USER_KEY_TYPE key) { erase_node_from_bstree(&g_replay_bstree, key); }
+static int bstree_engine_find(USER_KEY_TYPE key) { return find_node_in_bstree(&g_replay_bstree, key) != nullptr; }
+static void bstree_engine_teardown() { destroy_bstree(&g_replay_bstree); }
+
+static void set_engine_setup() { g_replay_set.clear(); }
+static void set_engine_insert(USER_KEY_TYPE key) { g_replay_set.insert(key); }
+static void set_engine_erase(USER_KEY_TYPE key) { g_replay_set.erase(key); }
+static int set_engine_find(USER_KEY_TYPE key) { return g_replay_set.count(key) == 1; }
+static void set_engine_teardown() { g_replay_set.clear(); }
+
+static const t_replay_engine replay_engines[] = {
+    {"rbtree",            rbtree_engine_setup,     rbtree_engine_insert, rbtree_engine_erase, rbtree_engine_find, rbtree_engine_teardown},
+    {"rbtree-arena-4k",   rbtree_arena_4k_setup,   rbtree_engine_insert, rbtree_engine_erase, rbtree_engine_find, rbtree_engine_teardown},
+    {"rbtree-arena-huge", rbtree_arena_huge_setup, rbtree_engine_insert, rbtree_engine_erase, rbtree_engine_find, rbtree_engine_teardown},
+    {"bstree",            bstree_engine_setup,     bstree_engine_insert, bstree_engine_erase, bstree_engine_find, bstree_engine_teardown},
+    {"std::set",          set_engine_setup,        set_engine_insert,    set_engine_erase,    set_engine_find,    set_engine_teardown},
+};
+
+#define REPLAY_FULL  0
+#define REPLAY_TIMED 1
+
+typedef struct replay_result {
+    double elapsed_ms;
+    long long hits;
+    vector<int64_t> latencies;      // 每个操作的延迟，单位ns
+} t_replay_result;
+
+// timed模式下按录制的节奏发出操作，speed > 1表示加速
+void trace_replay(const vector<t_trace_record>& records, const t_replay_engine *engine,
+                  int mode, double speed, t_replay_result *result) {
+    result->hits = 0;
+    result->latencies.clear();
+    result->latencies.reserve(records.size());
+
+    engine->setup();
+    int64_t start = trace_now_ns();
+    for (auto& record : records) {
+        int64_t issue = trace_now_ns();
+        if (mode == REPLAY_TIMED) {
+            int64_t scheduled = start + (int64_t)(record.offset_ns / speed);
+            // 离计划时刻较远时睡眠，剩下的一小段自旋，保证发出的时刻足够准
+            while (issue < scheduled) {
+                if (scheduled - issue > 1000000) {
+                    std::this_thread::sleep_for(std::chrono::nanoseconds(scheduled - issue - 500000));
+                }
+                issue = trace_now_ns();
+            }
+            issue = scheduled;
+        }
+
+        switch (record.op) {
+        case TRACE_OP_INSERT:
+            engine->insert(record.key);
+            break;
+        case TRACE_OP_ERASE:
+            engine->erase(record.key);
+            break;
+        default:
+            result->hits += engine->find(record.key);
+            break;
+        }
+        result->latencies.push_back(trace_now_ns() - issue);
+    }
+    result->elapsed_ms = (trace_now_ns() - start) / 1e6;
+    engine->teardown();
+}
+
+// 其他文件可以直接#include本文件来使用录制和回放，此时先定义RBTREE_TRACE_NO_MAIN去掉下面的命令行工具
+#ifndef RBTREE_TRACE_NO_MAIN
+
+/*
+    生成一段演示用的轨迹：先突发地插入一批key预热，然后以平均每秒rate个操作的速度运行，每200ms中有20ms的突发，
+速度是平时的5倍。操作的组成：70%查找，20%插入，10%删除，查找和删除偏向最近插入的key。
+*/
+static long long record_demo(const char *path, long long ops, double rate) {
+    if (trace_start(path) != 0)
+        return -1;
+
+    std::mt19937 rng(20260417);
+    t_rbtree tree = {};
+    rbtree_init(&tree);
+    vector<USER_KEY_TYPE> recent;
+    for (int i = 0; i < 100000; ++i) {
+        USER_KEY_TYPE key = (USER_KEY_TYPE)(rng() & 0x7fffffff);
+        traced_rbtree_insert(&tree, key);
+        recent.push_back(key);
+    }
+
+    int64_t start = trace_now_ns();
+    double due = 0;
+    for (long long i = 0; i < ops; ++i) {
+        double elapsed = due / 1e9;
+        int burst = std::fmod(elapsed, 0.2) < 0.02;
+        due += 1e9 / (rate * (burst ? 5 : 1));
+        int64_t wait = start + (int64_t)due - trace_now_ns();
+        if (wait > 100000) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+        }
+
+        int dice = (int)(rng() % 100);
+        if (dice < 70) {
+            traced_rbtree_find(&tree, recent[rng() % recent.size()]);
+        } else if (dice < 90) {
+            USER_KEY_TYPE key = (USER_KEY_TYPE)(rng() & 0x7fffffff);
+            traced_rbtree_insert(&tree, key);
+            recent[rng() % recent.size()] = key;
+        } else {
+            traced_rbtree_erase(&tree, recent[rng() % recent.size()]);
+        }
+    }
+
+    rbtree_destroy(&tree);
+    return trace_stop();
+}
+
+static void print_replay(const char *engine, int mode, t_replay_result *result) {
+    vector<int64_t>& latencies = result->latencies;
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies.empty() ? 0.0 : latencies[(size_t)(p * (latencies.size() - 1))] / 1000.0;
+    };
+    std::printf("%-18s %6s %10.1f %12.0f %9.2f %9.2f %9.2f %9.2f\n", engine, mode == REPLAY_FULL ? "full" : "timed",
+                result->elapsed_ms, latencies.size() / (result->elapsed_ms / 1000),
+                percentile(0.5), percentile(0.99), percentile(0.999), percentile(1.0));
+}
+
+static void usage(const char *name) {
+    std::printf("usage: %s record <trace> [ops] [ops_per_sec]\n", name);
+    std::printf("       %s replay <trace> [engine|all] [full|timed|both] [speed]\n", name);
+    std::printf("       %s              (record /tmp/rbtree.trace and replay it on every engine)\n", name);
+    std::printf("engines:");
+    for (auto& engine : replay_engines) {
+        std::printf(" %s", engine.name);
+    }
+    std::printf("\n");
+}
+
+// 解析一个正数参数，不是数字、不大于0或者不是有限值时返回-1
+static double parse_positive(const char *text) {
+    char *end = nullptr;
+    double value = std::strtod(text, &end);
+    if (end == text || *end != '\0' || !(value > 0) || !std::isfinite(value))
+        return -1;
+
+    return value;
+}
+
+int main(int argc, char *argv[]) {
+    const char *command = argc > 1 ? argv[1] : "demo";
+    const char *path = argc > 2 ? argv[2] : "/tmp/rbtree.trace";
+    if (std::strcmp(command, "demo") != 0 && std::strcmp(command, "record") != 0 && std::strcmp(command, "replay") != 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (std::strcmp(command, "replay") != 0) {
+        long long ops = std::strcmp(command, "record") == 0 && argc > 3 ? std::atoll(argv[3]) : 200000;
+        double rate = std::strcmp(command, "record") == 0 && argc > 4 ? parse_positive(argv[4]) : 100000;
+        if (rate <= 0) {
+            std::fprintf(stderr, "ops_per_sec must be a positive number\n");
+            return 1;
+        }
+        long long records = record_demo(path, ops, rate);
+        if (records < 0) {
+            std::perror(path);
+            return 1;
+        }
+
+        FILE *file = std::fopen(path, "rb");
+        std::fseek(file, 0, SEEK_END);
+        long bytes = std::ftell(file);
+        std::fclose(file);
+        std::printf("recorded %lld operations to %s, %ld bytes (%.2f bytes/op)\n",
+                    records, path, bytes, (double)(bytes - sizeof(t_trace_header)) / records);
+        if (std::strcmp(command, "record") == 0)
+            return 0;
+    }
+
+    vector<t_trace_record> records;
+    t_trace_header header;
+    long long dropped = trace_load(path, records, &header);
+    if (dropped < 0) {
+        std::fprintf(stderr, "cannot load trace %s\n", path);
+        return 1;
+    }
+    if (dropped > 0) {
+        std::fprintf(stderr, "trace %s is truncated: dropped the last %lld bytes, replaying %zu complete records\n",
+                     path, dropped, records.size());
+    }
+
+    const char *engine_name = std::strcmp(command, "replay") == 0 && argc > 3 ? argv[3] : "all";
+    const char *mode_name = std::strcmp(command, "replay") == 0 && argc > 4 ? argv[4] : "both";
+    // timed模式按offset / speed计算发出的时刻，speed为0或者负数没有意义
+    double speed = std::strcmp(command, "replay") == 0 && argc > 5 ? parse_positive(argv[5]) : 1.0;
+    if (speed <= 0) {
+        std::fprintf(stderr, "speed must be a positive number\n");
+        return 1;
+    }
+    double duration = records.empty() ? 0 : records.back().offset_ns / 1e9;
+    std::printf("%zu operations over %.2f s, replay speed %.1fx\n", records.size(), duration, speed);
+    std::printf("%-18s %6s %10s %12s %9s %9s %9s %9s\n", "engine", "mode", "ms", "ops/s",
+                "p50 us", "p99 us", "p99.9 us", "max us");
+
+    int matched = 0;
+    t_replay_result result;
+    for (auto& engine : replay_engines) {
+        if (std::strcmp(engine_name, "all") != 0 && std::strcmp(engine_name, engine.name) != 0)
+            continue;
+
+        ++matched;
+        if (std::strcmp(mode_name, "timed") != 0) {
+            trace_replay(records, &engine, REPLAY_FULL, speed, &result);
+            print_replay(engine.name, REPLAY_FULL, &result);
+        }
+        if (std::strcmp(mode_name, "full") != 0) {
+            trace_replay(records, &engine, REPLAY_TIMED, speed, &result);
+            print_replay(engine.name, REPLAY_TIMED, &result);
+        }
+    }
+
+    if (matched == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    return 0;
+}
+#endif
@@ -0,0 +1,303 @@
+/**
+ * @file red_black_tree_txn.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 红黑树的批量事务：一组插入删除要么全部生效，要么通过undo日志全部回滚
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include <set>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#define RBTREE_NO_MAIN
+#include "red_black_tree_recursion.cpp"
+
+using std::vector;
+
+/*
+    循环调用rbtree_insert时如果中途失败（比如分配节点失败），树中已经有了一部分修改，只能从头重建。事务把一组操作
+先暂存起来，提交时一次性执行：
+    1. 原子性：读者通过读写锁的共享模式访问树，提交在独占模式下执行全部操作（以及可能的回滚），读者看到的要么是提交前
+       的树，要么是提交后的树，不会看到一半。
+    2. undo日志：每执行一个真正改变了树的操作，就记下它的逆操作（插入了key则记“删除key”，删除了key则记“插入key”）。
+       中途失败时倒序执行undo日志即可回到提交前的状态，代价与已执行的操作数成正比，与树的大小无关。
+       红黑树的一次插入删除会引起若干次旋转和改色，逐个记录节点的物理修改既复杂又占空间；按key记录逻辑上的逆操作，
+       回滚后树的形状可能和原来不同，但包含的key完全相同，仍然是一棵合法的红黑树。
+    3. 回滚本身不能失败：提交时在当前线程上为目标树设置节点来源（t_rbtree_node_source），被删除节点的内存先留在事务
+       中，回滚时重新插入这些key就复用这些内存，不需要再向分配器申请；每次插入之前先向分配器要一个节点，申请不到就
+       立即回滚，保证__rbtree_insert永远不会拿到空指针。节点来源只对当前线程上的这棵树生效，其他线程、其他树（包括
+       同时在别的锁下提交的事务）照常使用全局的分配器。
+*/
+
+typedef struct locked_rbtree {
+    t_rbtree tree;
+    std::shared_mutex lock;
+} t_locked_rbtree;
+
+#define RBTREE_TXN_INSERT 0
+#define RBTREE_TXN_ERASE  1
+
+typedef struct rbtree_txn_op {
+    int type;
+    USER_KEY_TYPE key;
+} t_rbtree_txn_op;
+
+typedef struct rbtree_txn {
+    t_locked_rbtree *target;
+    vector<t_rbtree_txn_op> ops;        // 暂存的操作
+    vector<t_rbtree_txn_op> undo;       // 已执行操作的逆操作
+    vector<t_rbtree_node *> reserve;    // 可供分配的节点：预先申请的，以及本事务中被删除的
+} t_rbtree_txn;
+
+// 提交前保证reserve中至少有一个节点，每次插入最多分配一个节点
+static t_rbtree_node *__txn_node_alloc(void *context) {
+    t_rbtree_txn *txn = (t_rbtree_txn *)context;
+    t_rbtree_node *node = txn->reserve.back();
+    txn->reserve.pop_back();
+    return node;
+}
+
+static void __txn_node_free(void *context, t_rbtree_node *node) {
+    ((t_rbtree_txn *)context)->reserve.push_back(node);
+}
+
+void locked_rbtree_init(t_locked_rbtree *locked) {
+    rbtree_init(&locked->tree);
+}
+
+void locked_rbtree_destroy(t_locked_rbtree *locked) {
+    std::unique_lock<std::shared_mutex> guard(locked->lock);
+    rbtree_destroy(&locked->tree);
+    rbtree_init(&locked->tree);
+}
+
+// 读者接口：在共享锁下查找
+int locked_rbtree_contains(t_locked_rbtree *locked, USER_KEY_TYPE key) {
+    std::shared_lock<std::shared_mutex> guard(locked->lock);
+    return rbtree_find(&locked->tree, key) != nullptr;
+}
+
+// 读者接口：在共享锁下做中序遍历
+int locked_rbtree_traversal(t_locked_rbtree *locked, vector<int>& result) {
+    std::shared_lock<std::shared_mutex> guard(locked->lock);
+    return inorder_traversal(&locked->tree, result);
+}
+
+void rbtree_txn_begin(t_rbtree_txn *txn, t_locked_rbtree *target) {
+    txn->target = target;
+    txn->ops.clear();
+    txn->undo.clear();
+    txn->reserve.clear();
+}
+
+// 暂存一个插入操作，提交前不影响树
+void rbtree_txn_insert(t_rbtree_txn *txn, USER_KEY_TYPE key) {
+    txn->ops.push_back({RBTREE_TXN_INSERT, key});
+}
+
+// 暂存一个删除操作，提交前不影响树
+void rbtree_txn_erase(t_rbtree_txn *txn, USER_KEY_TYPE key) {
+    txn->ops.push_back({RBTREE_TXN_ERASE, key});
+}
+
+// 放弃所有暂存的操作
+void rbtree_txn_abort(t_rbtree_txn *txn) {
+    txn->ops.clear();
+}
+
+// 倒序执行undo日志
+static void __rbtree_txn_rollback(t_rbtree_txn *txn) {
+    t_rbtree *tree = &txn->target->tree;
+    for (auto it = txn->undo.rbegin(); it != txn->undo.rend(); ++it) {
+        if (it->type == RBTREE_TXN_INSERT) {
+            rbtree_insert(tree, it->key);
+        } else {
+            rbtree_erase(tree, it->key);
+        }
+    }
+}
+
+/*
+    提交事务：成功返回0；分配节点失败返回-1，此时树已经回滚到提交前的状态。
+    无论成功与否，暂存的操作都会被清空，事务可以继续用于下一批操作。
+*/
+int rbtree_txn_commit(t_rbtree_txn *txn) {
+    if (txn == nullptr || txn->target == nullptr)
+        return -2;
+
+    std::unique_lock<std::shared_mutex> guard(txn->target->lock);
+    t_rbtree *tree = &txn->target->tree;
+
+    t_rbtree_node_source source = {tree, txn, __txn_node_alloc, __txn_node_free};
+    t_rbtree_node_source *saved_source = rbtree_node_source;
+    rbtree_node_source = &source;
+
+    int ret = 0;
+    for (auto& op : txn->ops) {
+        int exists = rbtree_find(tree, op.key) != nullptr;
+        if (op.type == RBTREE_TXN_INSERT) {
+            if (exists)
+                continue;
+
+            if (txn->reserve.empty()) {
+                t_rbtree_node *node = rbtree_node_alloc();
+                if (node == nullptr) {
+                    ret = -1;
+                    break;
+                }
+                txn->reserve.push_back(node);
+            }
+            if (rbtree_insert(tree, op.key) < 0) {
+                ret = -1;
+                break;
+            }
+            txn->undo.push_back({RBTREE_TXN_ERASE, op.key});
+        } else {
+            if (!exists)
+                continue;
+
+            rbtree_erase(tree, op.key);
+            txn->undo.push_back({RBTREE_TXN_INSERT, op.key});
+        }
+    }
+
+    if (ret != 0) {
+        __rbtree_txn_rollback(txn);
+    }
+
+    rbtree_node_source = saved_source;
+
+    // 剩下的节点（被删除的或者回滚后多出来的）还给原来的分配器
+    for (auto node : txn->reserve) {
+        rbtree_node_free(node);
+    }
+    txn->reserve.clear();
+    txn->ops.clear();
+    txn->undo.clear();
+
+    return ret;
+}
+
+// 第g_alloc_fail_at次分配时返回nullptr，用于演示中途失败
+static long long g_alloc_count = 0;
+static long long g_alloc_fail_at = -1;
+
+static t_rbtree_node *failing_node_alloc() {
+    if (++g_alloc_count == g_alloc_fail_at)
+        return nullptr;
+
+    return rbtree_default_node_alloc();
+}
+
+#define DEMO_KEYS  100000
+#define DEMO_BATCH 256
+#define DEMO_TXNS  2000
+
+int main() {
+    rbtree_node_alloc = failing_node_alloc;
+
+    t_locked_rbtree locked;
+    locked_rbtree_init(&locked);
+
+    // 初始时树中是0, 2, 4, ...这些偶数
+    std::set<int> expected;
+    t_rbtree_txn txn;
+    rbtree_txn_begin(&txn, &locked);
+    for (int i = 0; i < DEMO_KEYS; ++i) {
+        rbtree_txn_insert(&txn, i * 2);
+        expected.insert(i * 2);
+    }
+    rbtree_txn_commit(&txn);
+
+    // 读者不停地遍历整棵树，每个事务删除的key和插入的key一样多，读者看到的key数应当始终不变
+    std::atomic<int> running(1);
+    long long scans = 0, torn = 0;
+    std::thread reader([&]() {
+        vector<int> keys;
+        while (running.load()) {
+            keys.clear();
+            locked_rbtree_traversal(&locked, keys);
+            torn += (keys.size() != DEMO_KEYS);
+            ++scans;
+        }
+    });
+
+    std::mt19937 rng(20260417);
+    long long committed = 0, rolled_back = 0;
+    double commit_us = 0, rollback_us = 0;
+    for (int t = 0; t < DEMO_TXNS; ++t) {
+        // 每个事务把一批key移动到相邻的位置：删除x，插入x+1。先暂存所有插入再暂存所有删除，插入时才需要新的节点
+        vector<std::pair<int, int>> moves;
+        rbtree_txn_begin(&txn, &locked);
+        for (int i = 0; i < DEMO_BATCH; ++i) {
+            int from = (int)(rng() % (DEMO_KEYS * 2));
+            int to = from + 1;
+            if (!expected.count(from) || expected.count(to))
+                continue;
+
+            int duplicated = 0;
+            for (auto& move : moves) {
+                duplicated |= (move.first == from || move.second == from ||
+                               move.first == to || move.second == to);
+            }
+            if (duplicated)
+                continue;
+
+            moves.push_back({from, to});
+            rbtree_txn_insert(&txn, to);
+        }
+        for (auto& move : moves) {
+            rbtree_txn_erase(&txn, move.first);
+        }
+
+        // 每4个事务中有一个在中途分配失败
+        int inject = (t % 4 == 3);
+        g_alloc_fail_at = inject ? g_alloc_count + 1 + (long long)(rng() % (moves.size() + 1)) : -1;
+
+        auto start = std::chrono::steady_clock::now();
+        int ret = rbtree_txn_commit(&txn);
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        if (ret == 0) {
+            for (auto& move : moves) {
+                expected.erase(move.first);
+                expected.insert(move.second);
+            }
+            ++committed;
+            commit_us += us;
+        } else {
+            ++rolled_back;
+            rollback_us += us;
+        }
+    }
+    g_alloc_fail_at = -1;
+
+    running.store(0);
+    reader.join();
+
+    vector<int> keys;
+    locked_rbtree_traversal(&locked, keys);
+    int same = (keys.size() == expected.size());
+    auto it = expected.begin();
+    for (size_t i = 0; same && i < keys.size(); ++i, ++it) {
+        same = (keys[i] == *it);
+    }
+
+    std::printf("committed: %lld (%.1f us avg), rolled back: %lld (%.1f us avg)\n",
+                committed, committed ? commit_us / committed : 0.0,
+                rolled_back, rolled_back ? rollback_us / rolled_back : 0.0);
+    std::printf("reader scans: %lld, torn scans: %lld, final tree matches: %s\n",
+                scans, torn, same ? "yes" : "no");
+
+    locked_rbtree_destroy(&locked);
+    return 0;
+}
@@ -0,0 +1,637 @@
+/**
+ * @file red_black_tree_uring.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 基于io_uring的红黑树持久化：预写日志（WAL）追加和快照写盘，不可用时退化为线程池pwrite
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <mutex>
+#include <random>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define RBTREE_NO_MAIN
+#include "red_black_tree_recursion.cpp"
+
+using std::vector;
+
+/*
+    每次插入都追加一条日志时，如果直接在插入线程里调用write/fdatasync，系统调用的开销占了写路径的很大一部分。这里把
+日志先攒到缓冲区里，一个缓冲区满了才提交一次写，并且尽量让提交本身也不需要系统调用：
+    1. io_uring：提交队列（SQ）和完成队列（CQ）都是和内核共享的环形缓冲区，填好SQE、推进tail就完成了提交，从CQ中取
+       结果也只是读内存。创建时使用IORING_SETUP_SQPOLL，由内核线程轮询SQ，插入线程只在内核线程空闲睡眠后（SQ flags
+       中有IORING_SQ_NEED_WAKEUP）才需要调用一次io_uring_enter把它唤醒；没有权限使用SQPOLL时，每次提交调用一次
+       io_uring_enter。
+    2. 注册缓冲区：日志缓冲区在初始化时通过IORING_REGISTER_BUFFERS注册给内核，写入使用IORING_OP_WRITE_FIXED，内核
+       不必每次都去pin用户页。
+    3. 链接的fsync：每个缓冲区提交一个WRITE_FIXED，带IOSQE_IO_LINK链接一个IORING_OP_FSYNC（DATASYNC），内核保证写成功
+       之后才执行fsync，写失败时fsync会被取消。不同缓冲区的链之间没有顺序，后提交的缓冲区可能先落盘，因此一个缓冲区
+       只有在它自己以及之前提交的所有缓冲区的fsync都完成以后才算落盘：durable按提交顺序前进，缓冲区也按这个顺序
+       复用，崩溃后durable之前的日志一定是连续的。写入的字节数可能少于请求的长度（此时链接的fsync会被取消），剩下的
+       部分重新提交一个WRITE + FSYNC的链。
+    4. 退化：内核不支持io_uring（或被io_uring_disabled禁用）时，改为把缓冲区交给一个线程池，由工作线程执行pwrite和
+       fdatasync，插入线程同样不进入系统调用。
+    快照写盘走同一套缓冲区：迭代地中序遍历，把key依次追加进去，最后一个缓冲区写完后fsync。
+*/
+
+#define PERSIST_BACKEND_SYNC          0     // 在调用线程中直接pwrite + fdatasync，用于对比
+#define PERSIST_BACKEND_THREAD_POOL   1
+#define PERSIST_BACKEND_URING         2
+#define PERSIST_BACKEND_URING_SQPOLL  3
+
+static const char *persist_backend_names[] = {"sync pwrite", "thread pool", "io_uring", "io_uring sqpoll"};
+
+#define PERSIST_BUFFER_SIZE   (256 * 1024)
+#define PERSIST_BUFFER_COUNT  16
+#define PERSIST_POOL_THREADS  2
+
+typedef struct uring {
+    int fd;
+    unsigned setup_flags;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_flags, *sq_array;
+    unsigned sq_local_tail;                 // 已经填好但还没有发布给内核的SQE的tail
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+} t_uring;
+
+typedef struct persist_job {
+    int buffer;
+    size_t length;
+    off_t offset;
+} t_persist_job;
+
+typedef struct persist_writer {
+    int backend;
+    int fd;
+    off_t offset;                           // 下一个缓冲区在文件中的位置
+    off_t durable;                          // 文件中这个位置之前的数据都已经落盘
+    char *memory;                           // PERSIST_BUFFER_COUNT个缓冲区连续存放
+    size_t used[PERSIST_BUFFER_COUNT];
+    off_t buffer_offset[PERSIST_BUFFER_COUNT];      // 在途的缓冲区在文件中的位置
+    size_t written[PERSIST_BUFFER_COUNT];           // 在途的缓冲区已经写入了多少字节
+    int completed[PERSIST_BUFFER_COUNT];            // 在途的缓冲区自己的fsync已经完成
+    int result[PERSIST_BUFFER_COUNT];               // 在途的缓冲区的结果，0或-errno
+    std::deque<int> submit_order;                   // 在途的缓冲区，按提交的顺序
+    vector<int> free_buffers;
+    int current;                            // 正在填充的缓冲区，-1表示没有
+    int inflight;
+    int error;
+
+    t_uring ring;
+
+    // 线程池
+    vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable job_ready;
+    std::condition_variable job_done;
+    std::deque<t_persist_job> jobs;
+    vector<int> finished;
+    int stopping;
+
+    // 统计：调用线程自己发起的与I/O有关的系统调用次数（线程池后端唤醒工作线程时可能产生的futex调用不计入）
+    long long caller_syscalls;
+    long long submitted;
+} t_persist_writer;
+
+static inline char *__persist_buffer(t_persist_writer *writer, int index) {
+    return writer->memory + (size_t)index * PERSIST_BUFFER_SIZE;
+}
+
+/* --------------------------------- io_uring -------------------------------- */
+
+static int __uring_setup(t_uring *ring, unsigned entries, int sqpoll) {
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    if (sqpoll) {
+        params.flags = IORING_SETUP_SQPOLL;
+        params.sq_thread_idle = 1000;
+    }
+
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0)
+        return -1;
+
+    ring->fd = fd;
+    ring->setup_flags = params.flags;
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->sq_ring_size = ring->cq_ring_size = std::max(ring->sq_ring_size, ring->cq_ring_size);
+    }
+
+    ring->sq_ring = mmap(nullptr, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+
+    ring->cq_ring = ring->sq_ring;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        ring->cq_ring = mmap(nullptr, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                             fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            munmap(ring->sq_ring, ring->sq_ring_size);
+            close(fd);
+            return -1;
+        }
+    }
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe *)mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE,
+                                             MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        if (ring->cq_ring != ring->sq_ring) {
+            munmap(ring->cq_ring, ring->cq_ring_size);
+        }
+        munmap(ring->sq_ring, ring->sq_ring_size);
+        close(fd);
+        return -1;
+    }
+
+    char *sq = (char *)ring->sq_ring;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_flags = (unsigned *)(sq + params.sq_off.flags);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->sq_local_tail = *ring->sq_tail;
+
+    char *cq = (char *)ring->cq_ring;
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return 0;
+}
+
+static void __uring_destroy(t_uring *ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+}
+
+static int __uring_enter(t_uring *ring, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, ring->fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+// 取一个空闲的SQE，调用者保证SQ不会满（在途的请求数小于SQ的大小）
+static struct io_uring_sqe *__uring_get_sqe(t_uring *ring) {
+    unsigned index = ring->sq_local_tail++ & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    return sqe;
+}
+
+/*
+    让内核看到新的SQE：写tail使用release语义，保证SQE的内容先于tail可见。一次发布整条链接的请求，否则SQPOLL的内核
+线程可能只看到链的前半部分。
+*/
+static void __uring_submit(t_persist_writer *writer, unsigned count) {
+    t_uring *ring = &writer->ring;
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+
+    if (ring->setup_flags & IORING_SETUP_SQPOLL) {
+        // 内核线程还在轮询时不需要任何系统调用
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (__atomic_load_n(ring->sq_flags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP) {
+            __uring_enter(ring, 0, 0, IORING_ENTER_SQ_WAKEUP);
+            writer->caller_syscalls++;
+        }
+    } else {
+        __uring_enter(ring, count, 0, 0);
+        writer->caller_syscalls++;
+    }
+}
+
+/*
+    一个缓冲区的写和fsync都结束了，ret为0或-errno。只有之前提交的缓冲区都已经结束时才推进durable并复用缓冲区，
+否则先记下来，等前面的缓冲区结束时一并处理。某个缓冲区失败以后，durable停在它的开头，不会再越过它。
+*/
+static void __persist_complete_buffer(t_persist_writer *writer, int buffer, int ret) {
+    if (ret != 0 && writer->error == 0) {
+        writer->error = ret;
+    }
+    writer->result[buffer] = ret;
+    writer->completed[buffer] = 1;
+    while (!writer->submit_order.empty() && writer->completed[writer->submit_order.front()]) {
+        int front = writer->submit_order.front();
+        writer->submit_order.pop_front();
+        if (writer->result[front] == 0 && writer->durable == writer->buffer_offset[front]) {
+            writer->durable = writer->buffer_offset[front] + writer->used[front];
+        }
+
+        writer->used[front] = 0;
+        writer->free_buffers.push_back(front);
+        writer->inflight--;
+    }
+}
+
+// 提交缓冲区中还没有写入的部分，WRITE_FIXED之后链接一个fsync
+static void __uring_write(t_persist_writer *writer, int buffer) {
+    size_t done = writer->written[buffer];
+    struct io_uring_sqe *sqe = __uring_get_sqe(&writer->ring);
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->fd = writer->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(__persist_buffer(writer, buffer) + done);
+    sqe->len = writer->used[buffer] - done;
+    sqe->off = writer->buffer_offset[buffer] + done;
+    sqe->buf_index = buffer;
+    sqe->user_data = (uint64_t)buffer << 1;
+
+    sqe = __uring_get_sqe(&writer->ring);
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = writer->fd;
+    sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    sqe->user_data = ((uint64_t)buffer << 1) | 1;
+
+    __uring_submit(writer, 2);
+}
+
+/*
+    处理CQ中所有已经完成的请求，不进入内核。写的CQE只累加写入的字节数；fsync的CQE到达时这条链就结束了：没写完的
+（短写，fsync被取消）重新提交剩下的部分，否则这个缓冲区结束。
+*/
+static void __uring_reap(t_persist_writer *writer) {
+    t_uring *ring = &writer->ring;
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+        int buffer = (int)(cqe->user_data >> 1);
+        int is_fsync = (int)(cqe->user_data & 1);
+        if (!is_fsync) {
+            if (cqe->res > 0) {
+                writer->written[buffer] += cqe->res;
+            } else {
+                // 一个字节都没有写进去，重试也不会有进展
+                writer->result[buffer] = cqe->res < 0 ? cqe->res : -EIO;
+            }
+            continue;
+        }
+
+        if (writer->result[buffer] == 0 && writer->written[buffer] < writer->used[buffer]) {
+            __uring_write(writer, buffer);
+            continue;
+        }
+
+        int ret = writer->result[buffer];
+        if (ret == 0 && cqe->res < 0) {
+            ret = cqe->res;
+        }
+        __persist_complete_buffer(writer, buffer, ret);
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/* ---------------------------------- 线程池 --------------------------------- */
+
+// 用pwrite写完整个缓冲区（处理短写）再fdatasync，成功返回0，失败返回-errno
+static int __persist_write_sync(t_persist_writer *writer, int buffer, size_t length, off_t offset) {
+    const char *data = __persist_buffer(writer, buffer);
+    size_t done = 0;
+    while (done < length) {
+        ssize_t n = pwrite(writer->fd, data + done, length - done, offset + done);
+        if (n <= 0)
+            return n < 0 ? -errno : -EIO;
+
+        done += n;
+    }
+
+    return fdatasync(writer->fd) != 0 ? -errno : 0;
+}
+
+static void __pool_worker(t_persist_writer *writer) {
+    std::unique_lock<std::mutex> guard(writer->lock);
+    while (true) {
+        writer->job_ready.wait(guard, [&]() { return writer->stopping || !writer->jobs.empty(); });
+        if (writer->jobs.empty())
+            return;
+
+        t_persist_job job = writer->jobs.front();
+        writer->jobs.pop_front();
+        guard.unlock();
+
+        int ret = __persist_write_sync(writer, job.buffer, job.length, job.offset);
+
+        guard.lock();
+        writer->result[job.buffer] = ret;
+        writer->finished.push_back(job.buffer);
+        writer->job_done.notify_all();
+    }
+}
+
+static void __pool_reap(t_persist_writer *writer, int block) {
+    std::unique_lock<std::mutex> guard(writer->lock);
+    if (block) {
+        writer->job_done.wait(guard, [&]() { return !writer->finished.empty(); });
+    }
+    for (auto buffer : writer->finished) {
+        __persist_complete_buffer(writer, buffer, writer->result[buffer]);
+    }
+    writer->finished.clear();
+}
+
+/* ---------------------------------- 接口 ---------------------------------- */
+
+// 回收已经完成的缓冲区；block为1时至少等到一个完成
+static void __persist_reap(t_persist_writer *writer, int block) {
+    if (writer->backend >= PERSIST_BACKEND_URING) {
+        __uring_reap(writer);
+        if (block && writer->free_buffers.empty()) {
+            // 只有所有缓冲区都在途时，调用线程才不得不进入内核等待
+            __uring_enter(&writer->ring, 0, 1, IORING_ENTER_GETEVENTS);
+            writer->caller_syscalls++;
+            __uring_reap(writer);
+        }
+    } else if (writer->backend == PERSIST_BACKEND_THREAD_POOL) {
+        __pool_reap(writer, block);
+    }
+}
+
+// 把当前缓冲区提交写盘
+static void __persist_submit_current(t_persist_writer *writer) {
+    int buffer = writer->current;
+    if (buffer < 0 || writer->used[buffer] == 0)
+        return;
+
+    size_t length = writer->used[buffer];
+    off_t offset = writer->offset;
+    writer->offset += length;
+    writer->buffer_offset[buffer] = offset;
+    writer->written[buffer] = 0;
+    writer->completed[buffer] = 0;
+    writer->result[buffer] = 0;
+    writer->submit_order.push_back(buffer);
+    writer->current = -1;
+    writer->inflight++;
+    writer->submitted++;
+
+    if (writer->backend >= PERSIST_BACKEND_URING) {
+        __uring_write(writer, buffer);
+    } else if (writer->backend == PERSIST_BACKEND_THREAD_POOL) {
+        std::lock_guard<std::mutex> guard(writer->lock);
+        writer->jobs.push_back({buffer, length, offset});
+        writer->job_ready.notify_one();
+    } else {
+        int ret = __persist_write_sync(writer, buffer, length, offset);
+        writer->caller_syscalls += 2;
+        __persist_complete_buffer(writer, buffer, ret);
+    }
+}
+
+/*
+    打开（截断）path作为输出文件，backend是期望使用的后端：io_uring不可用时依次退化为不带SQPOLL的io_uring、线程池。
+    成功返回实际使用的后端，失败返回-1。
+*/
+int persist_writer_open(t_persist_writer *writer, const char *path, int backend) {
+    writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (writer->fd < 0)
+        return -1;
+
+    writer->memory = (char *)mmap(nullptr, (size_t)PERSIST_BUFFER_SIZE * PERSIST_BUFFER_COUNT,
+                                  PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (writer->memory == MAP_FAILED) {
+        close(writer->fd);
+        return -1;
+    }
+
+    writer->offset = 0;
+    writer->durable = 0;
+    writer->submit_order.clear();
+    writer->free_buffers.clear();
+    for (int i = PERSIST_BUFFER_COUNT - 1; i >= 0; --i) {
+        writer->used[i] = 0;
+        writer->free_buffers.push_back(i);
+    }
+    writer->current = -1;
+    writer->inflight = 0;
+    writer->error = 0;
+    writer->stopping = 0;
+    writer->caller_syscalls = 0;
+    writer->submitted = 0;
+
+    if (backend == PERSIST_BACKEND_URING_SQPOLL && __uring_setup(&writer->ring, PERSIST_BUFFER_COUNT * 2, 1) != 0) {
+        backend = PERSIST_BACKEND_URING;
+    }
+    if (backend == PERSIST_BACKEND_URING && __uring_setup(&writer->ring, PERSIST_BUFFER_COUNT * 2, 0) != 0) {
+        backend = PERSIST_BACKEND_THREAD_POOL;
+    }
+    if (backend >= PERSIST_BACKEND_URING) {
+        struct iovec iovs[PERSIST_BUFFER_COUNT];
+        for (int i = 0; i < PERSIST_BUFFER_COUNT; ++i) {
+            iovs[i].iov_base = __persist_buffer(writer, i);
+            iovs[i].iov_len = PERSIST_BUFFER_SIZE;
+        }
+        if (syscall(__NR_io_uring_register, writer->ring.fd, IORING_REGISTER_BUFFERS, iovs, PERSIST_BUFFER_COUNT) != 0) {
+            __uring_destroy(&writer->ring);
+            backend = PERSIST_BACKEND_THREAD_POOL;
+        }
+    }
+    if (backend == PERSIST_BACKEND_THREAD_POOL) {
+        for (int i = 0; i < PERSIST_POOL_THREADS; ++i) {
+            writer->workers.emplace_back(__pool_worker, writer);
+        }
+    }
+
+    writer->backend = backend;
+    return backend;
+}
+
+// 追加数据，缓冲区写满时提交；所有缓冲区都在途时等待
+void persist_append(t_persist_writer *writer, const void *data, size_t length) {
+    const char *bytes = (const char *)data;
+    while (length > 0) {
+        if (writer->current < 0) {
+            __persist_reap(writer, 0);
+            while (writer->free_buffers.empty()) {
+                __persist_reap(writer, 1);
+            }
+            writer->current = writer->free_buffers.back();
+            writer->free_buffers.pop_back();
+        }
+
+        size_t room = PERSIST_BUFFER_SIZE - writer->used[writer->current];
+        size_t n = length < room ? length : room;
+        std::memcpy(__persist_buffer(writer, writer->current) + writer->used[writer->current], bytes, n);
+        writer->used[writer->current] += n;
+        bytes += n;
+        length -= n;
+
+        if (writer->used[writer->current] == PERSIST_BUFFER_SIZE) {
+            __persist_submit_current(writer);
+        }
+    }
+}
+
+// 提交未满的缓冲区，并等待之前提交的所有数据落盘，成功返回0
+int persist_sync(t_persist_writer *writer) {
+    __persist_submit_current(writer);
+    while (writer->inflight > 0) {
+        __persist_reap(writer, 1);
+    }
+
+    return writer->error;
+}
+
+int persist_writer_close(t_persist_writer *writer) {
+    int ret = persist_sync(writer);
+
+    if (writer->backend >= PERSIST_BACKEND_URING) {
+        __uring_destroy(&writer->ring);
+    } else if (writer->backend == PERSIST_BACKEND_THREAD_POOL) {
+        {
+            std::lock_guard<std::mutex> guard(writer->lock);
+            writer->stopping = 1;
+        }
+        writer->job_ready.notify_all();
+        for (auto& worker : writer->workers) {
+            worker.join();
+        }
+        writer->workers.clear();
+    }
+
+    munmap(writer->memory, (size_t)PERSIST_BUFFER_SIZE * PERSIST_BUFFER_COUNT);
+    close(writer->fd);
+    return ret;
+}
+
+/* ------------------------------ 红黑树的持久化 ------------------------------ */
+
+#define WAL_OP_INSERT 1
+#define WAL_OP_ERASE  2
+
+typedef struct __attribute__((packed)) wal_record {
+    uint8_t op;
+    int32_t key;
+} t_wal_record;
+
+// 插入并记录日志，调用线程只做内存拷贝
+void rbtree_logged_insert(t_rbtree *tree, t_persist_writer *wal, USER_KEY_TYPE key) {
+    rbtree_insert(tree, key);
+    t_wal_record record = {WAL_OP_INSERT, key};
+    persist_append(wal, &record, sizeof(record));
+}
+
+void rbtree_logged_erase(t_rbtree *tree, t_persist_writer *wal, USER_KEY_TYPE key) {
+    rbtree_erase(tree, key);
+    t_wal_record record = {WAL_OP_ERASE, key};
+    persist_append(wal, &record, sizeof(record));
+}
+
+// 把整棵树按中序写成快照，返回写入的key的个数，失败返回负数
+long long rbtree_snapshot_write(t_rbtree *tree, t_persist_writer *writer) {
+    long long count = 0;
+    vector<t_rbtree_node *> stack;
+    t_rbtree_node *cursor = tree->root;
+    while (cursor != nil_node || !stack.empty()) {
+        while (cursor != nil_node) {
+            stack.push_back(cursor);
+            cursor = cursor->left;
+        }
+
+        cursor = stack.back();
+        stack.pop_back();
+        persist_append(writer, &cursor->key, sizeof(cursor->key));
+        ++count;
+        cursor = cursor->right;
+    }
+
+    int ret = persist_sync(writer);
+    return ret == 0 ? count : ret;
+}
+
+int main(int argc, char *argv[]) {
+    const char *dir = argc > 1 ? argv[1] : "/tmp";
+    long long ops = argc > 2 ? std::atoll(argv[2]) : 2000000;
+
+    char wal_path[4096], snapshot_path[4096];
+    std::snprintf(wal_path, sizeof(wal_path), "%s/rbtree.wal", dir);
+    std::snprintf(snapshot_path, sizeof(snapshot_path), "%s/rbtree.snapshot", dir);
+
+    std::printf("%lld logged operations, %d x %d KB buffers\n", ops, PERSIST_BUFFER_COUNT, PERSIST_BUFFER_SIZE / 1024);
+    std::printf("%16s %16s %10s %14s %14s %12s\n",
+                "requested", "backend", "ns/op", "caller sys", "buffers", "snapshot ms");
+    int backends[] = {PERSIST_BACKEND_SYNC, PERSIST_BACKEND_THREAD_POOL,
+                      PERSIST_BACKEND_URING, PERSIST_BACKEND_URING_SQPOLL};
+    for (auto requested : backends) {
+        t_rbtree tree = {};
+        rbtree_init(&tree);
+
+        t_persist_writer *wal = new t_persist_writer;
+        int backend = persist_writer_open(wal, wal_path, requested);
+        if (backend < 0) {
+            std::perror("open wal");
+            return 1;
+        }
+
+        std::mt19937 rng(20260417);
+        auto start = std::chrono::steady_clock::now();
+        for (long long i = 0; i < ops; ++i) {
+            int key = (int)(rng() % (ops / 2 + 1));
+            if (i % 4 == 3) {
+                rbtree_logged_erase(&tree, wal, key);
+            } else {
+                rbtree_logged_insert(&tree, wal, key);
+            }
+        }
+        int ret = persist_sync(wal);
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        long long syscalls = wal->caller_syscalls, buffers = wal->submitted;
+        persist_writer_close(wal);
+        delete wal;
+        if (ret != 0) {
+            std::printf("wal write failed: %s\n", std::strerror(-ret));
+        }
+
+        t_persist_writer *snapshot = new t_persist_writer;
+        persist_writer_open(snapshot, snapshot_path, requested);
+        start = std::chrono::steady_clock::now();
+        long long written = rbtree_snapshot_write(&tree, snapshot);
+        double snapshot_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        persist_writer_close(snapshot);
+        delete snapshot;
+        if (written < 0) {
+            std::printf("snapshot write failed: %s\n", std::strerror((int)-written));
+        }
+
+        std::printf("%16s %16s %10.1f %14lld %14lld %12.1f\n",
+                    persist_backend_names[requested], persist_backend_names[backend],
+                    ns / ops, syscalls, buffers, snapshot_ms);
+        rbtree_destroy(&tree);
+    }
+
+    unlink(wal_path);
+    unlink(snapshot_path);
+    return 0;
+}
@@ -0,0 +1,227 @@
+/**
+ * @file red_black_tree_validate.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 大树的并行性质校验：按子树并行检查有序性、红红冲突、黑高和残留的双黑，发现第一个错误就提前结束
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 复用并行构建和其中的工作窃取调度器
+#define RBTREE_PARALLEL_BUILD_NO_MAIN
+#include "red_black_tree_parallel_build.cpp"
+
+using std::vector;
+
+/*
+    每次故障恢复和批量构建之后都要校验整棵树，单线程递归检查10亿个节点需要几分钟。校验本身是一个fork-join的递归：
+    1. 每个节点需要检查：key落在祖先给出的开区间(lo, hi)中；颜色只能是红或黑（删除调整结束后不应残留RBTREE_CLR_DBL）；
+       红色节点的孩子都是黑色；左右子树的黑高相等。另外根和nil_node必须是黑色。
+    2. 前VALIDATE_SPLIT_DEPTH层中，左子树作为任务提交给调度器，当前线程检查右子树，再等待左子树的黑高；更深的子树
+       直接串行递归。10亿个节点的树大约30层，切分出的每个任务还有几十万个节点，调度的开销可以忽略。
+    3. 所有任务共享一个stop标志，第一个发现错误的任务把错误记录下来并置位，其他任务每访问一个节点检查一次标志，
+       看到置位后立即返回，因此错误的树不需要被完整地遍历。报告的错误是“第一个被发现的”，并行时不一定是中序最靠前的。
+*/
+
+#define RBTREE_VALID              0
+#define RBTREE_BAD_ORDER          1     // key不在祖先给出的范围内
+#define RBTREE_BAD_RED_RED        2     // 红色节点有红色的孩子
+#define RBTREE_BAD_BLACK_HEIGHT   3     // 左右子树的黑高不相等
+#define RBTREE_BAD_COLOR          4     // 颜色不是红或黑，比如残留的RBTREE_CLR_DBL
+#define RBTREE_BAD_ROOT           5     // 根节点或nil_node不是黑色
+
+// 子树所在的深度小于该值时，左子树作为独立的任务并行检查
+#define VALIDATE_SPLIT_DEPTH 12
+
+typedef struct rbtree_violation {
+    int kind;
+    t_rbtree_node *node;        // 出错的节点，RBTREE_BAD_ROOT时可能是nil_node
+} t_rbtree_violation;
+
+typedef struct validate_ctx {
+    t_ws_pool *pool;
+    std::atomic<int> stop;
+    std::mutex lock;
+    t_rbtree_violation violation;
+} t_validate_ctx;
+
+static const char *rbtree_violation_name(int kind) {
+    switch (kind) {
+    case RBTREE_VALID:            return "valid";
+    case RBTREE_BAD_ORDER:        return "bst order";
+    case RBTREE_BAD_RED_RED:      return "red-red";
+    case RBTREE_BAD_BLACK_HEIGHT: return "black height";
+    case RBTREE_BAD_COLOR:        return "lingering color";
+    case RBTREE_BAD_ROOT:         return "root/nil color";
+    default:                      return "unknown";
+    }
+}
+
+// 记录第一个错误并通知其他任务停止，返回-1方便调用者直接return
+static int __validate_fail(t_validate_ctx *ctx, int kind, t_rbtree_node *node) {
+    std::lock_guard<std::mutex> guard(ctx->lock);
+    if (ctx->violation.kind == RBTREE_VALID) {
+        ctx->violation.kind = kind;
+        ctx->violation.node = node;
+    }
+    ctx->stop.store(1, std::memory_order_relaxed);
+    return -1;
+}
+
+// 检查以root为根的子树，key必须在(lo, hi)中，返回黑高，出错或被叫停返回-1
+static int __rbtree_validate(t_validate_ctx *ctx, t_rbtree_node *root, long long lo, long long hi, int depth) {
+    if (ctx->stop.load(std::memory_order_relaxed))
+        return -1;
+    if (root == nil_node)
+        return 1;
+
+    if (root->color != RBTREE_CLR_RED && root->color != RBTREE_CLR_BLK)
+        return __validate_fail(ctx, RBTREE_BAD_COLOR, root);
+    if (root->key <= lo || root->key >= hi)
+        return __validate_fail(ctx, RBTREE_BAD_ORDER, root);
+    if (root->color == RBTREE_CLR_RED &&
+        (root->left->color == RBTREE_CLR_RED || root->right->color == RBTREE_CLR_RED))
+        return __validate_fail(ctx, RBTREE_BAD_RED_RED, root);
+
+    int left, right;
+    if (depth < VALIDATE_SPLIT_DEPTH && ctx->pool != nullptr) {
+        ws_invoke(ctx->pool, [&]() { left = __rbtree_validate(ctx, root->left, lo, root->key, depth + 1); },
+                  [&]() { right = __rbtree_validate(ctx, root->right, root->key, hi, depth + 1); });
+    } else {
+        left = __rbtree_validate(ctx, root->left, lo, root->key, depth + 1);
+        right = left < 0 ? -1 : __rbtree_validate(ctx, root->right, root->key, hi, depth + 1);
+    }
+
+    if (left < 0 || right < 0)
+        return -1;
+    if (left != right)
+        return __validate_fail(ctx, RBTREE_BAD_BLACK_HEIGHT, root);
+
+    return left + (root->color == RBTREE_CLR_BLK);
+}
+
+/*
+    校验整棵树，合法时返回黑高（空树为1），否则返回-1，错误信息写入violation（可以为nullptr）。
+    pool为nullptr时串行校验。
+*/
+int rbtree_parallel_validate(t_ws_pool *pool, t_rbtree *tree, t_rbtree_violation *violation) {
+    t_validate_ctx ctx;
+    ctx.pool = pool;
+    ctx.stop.store(0);
+    ctx.violation = {RBTREE_VALID, nullptr};
+
+    int height;
+    if (nil_node->color != RBTREE_CLR_BLK) {
+        height = __validate_fail(&ctx, RBTREE_BAD_ROOT, nil_node);
+    } else if (tree->root->color != RBTREE_CLR_BLK) {
+        height = __validate_fail(&ctx, RBTREE_BAD_ROOT, tree->root);
+    } else {
+        height = __rbtree_validate(&ctx, tree->root, LLONG_MIN, LLONG_MAX, 0);
+    }
+
+    if (violation != nullptr) {
+        *violation = ctx.violation;
+    }
+    return height;
+}
+
+// 其他文件可以直接#include本文件来复用校验，此时先定义RBTREE_VALIDATE_NO_MAIN去掉下面的示例
+#ifndef RBTREE_VALIDATE_NO_MAIN
+// 找到中序第rank个节点（从0开始），用于在树的深处制造错误
+static t_rbtree_node *__nth_node(t_rbtree_node *root, long long rank, long long size) {
+    while (root != nil_node) {
+        long long left_size = size / 2;     // 由有序数组构建的树，左子树的大小是确定的
+        if (rank == left_size)
+            return root;
+        if (rank < left_size) {
+            root = root->left;
+            size = left_size;
+        } else {
+            root = root->right;
+            rank -= left_size + 1;
+            size = size - left_size - 1;
+        }
+    }
+    return nil_node;
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+    long long count = argc > 1 ? std::atoll(argv[1]) : 20000000;
+    int threads = argc > 2 ? std::atoi(argv[2]) : 0;
+
+    t_ws_pool pool;
+    ws_pool_init(&pool, threads);
+
+    vector<USER_KEY_TYPE> keys(count);
+    for (long long i = 0; i < count; ++i) {
+        keys[i] = (USER_KEY_TYPE)(i * 2);
+    }
+    t_rbtree tree = {};
+    rbtree_parallel_build_from_sorted(&pool, &tree, keys.data(), count);
+    vector<USER_KEY_TYPE>().swap(keys);
+    std::printf("%lld keys, %d workers, %u hardware threads\n", count, pool.workers, std::thread::hardware_concurrency());
+
+    t_rbtree_violation violation;
+    auto start = std::chrono::steady_clock::now();
+    int serial = rbtree_parallel_validate(nullptr, &tree, &violation);
+    double serial_ms = elapsed_ms(start);
+    start = std::chrono::steady_clock::now();
+    int parallel = rbtree_parallel_validate(&pool, &tree, &violation);
+    std::printf("valid tree: serial %.0f ms (black height %d), parallel %.0f ms (black height %d)\n",
+                serial_ms, serial, elapsed_ms(start), parallel);
+
+    // 在树的中部制造各种错误，检查能否发现，以及提前结束的效果
+    t_rbtree_node *victim = __nth_node(tree.root, count / 3, count);
+    t_rbtree_node *red_parent = tree.root->right;
+    while (red_parent->left->left != nil_node) {
+        red_parent = red_parent->left;
+    }
+
+    USER_KEY_TYPE saved_key = victim->key;
+    victim->key = tree.root->key + (victim->key < tree.root->key ? 1 : -1);
+    start = std::chrono::steady_clock::now();
+    rbtree_parallel_validate(&pool, &tree, &violation);
+    std::printf("key %d -> %d: %s at key %d, %.0f ms\n", saved_key, victim->key,
+                rbtree_violation_name(violation.kind), violation.node->key, elapsed_ms(start));
+    victim->key = saved_key;
+
+    int saved_color = victim->color;
+    victim->color = RBTREE_CLR_DBL;
+    start = std::chrono::steady_clock::now();
+    rbtree_parallel_validate(&pool, &tree, &violation);
+    std::printf("lingering DBL at key %d: %s at key %d, %.0f ms\n", victim->key,
+                rbtree_violation_name(violation.kind), violation.node->key, elapsed_ms(start));
+
+    victim->color = saved_color == RBTREE_CLR_RED ? RBTREE_CLR_BLK : RBTREE_CLR_RED;
+    start = std::chrono::steady_clock::now();
+    rbtree_parallel_validate(&pool, &tree, &violation);
+    std::printf("flip color of key %d: %s at key %d, %.0f ms\n", victim->key,
+                rbtree_violation_name(violation.kind), violation.node->key, elapsed_ms(start));
+    victim->color = saved_color;
+
+    red_parent->color = red_parent->left->color = RBTREE_CLR_RED;
+    start = std::chrono::steady_clock::now();
+    rbtree_parallel_validate(&pool, &tree, &violation);
+    std::printf("red parent and child at key %d: %s at key %d, %.0f ms\n", red_parent->key,
+                rbtree_violation_name(violation.kind), violation.node->key, elapsed_ms(start));
+
+    rbtree_parallel_destroy(&pool, &tree);
+    ws_pool_destroy(&pool);
+    return 0;
+}
+#endif
@@ -0,0 +1,270 @@
+/**
+ * @file splay_tree.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 自顶向下伸展树（二叉搜索树的自调整版本），并在Zipf分布的访问下与红黑树做对比
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// 伸展树直接复用二叉搜索树的节点定义，红黑树用于对比
+#define BSTREE_NO_MAIN
+#include "binarySearchTree.cpp"
+#define RBTREE_NO_MAIN
+#include "red_black_tree_recursion.cpp"
+
+using std::vector;
+
+/*
+    红黑树只保证整棵树的高度是O(logn)，每个key的深度与它被访问的频率无关。当访问分布极度倾斜时，热点key仍然散落在
+树的各个深度上，每次查找都要沿着路径访问logn个节点，热点集合所在的缓存行也分散在整棵树中。
+    伸展树在每次访问后，都把被访问的节点通过旋转搬到根节点上，越热的key越靠近根，查找热点时只需要访问很少的几层，
+并且根附近的节点反复被访问，总是在缓存中。均摊下来每次操作仍然是O(logn)的。
+
+    这里采用自顶向下的伸展方式：从根向下查找的同时，把路径拆成三部分：
+    1. 左树L：所有比key小的节点，新拆下来的节点总是挂在L的最右边；
+    2. 右树R：所有比key大的节点，新拆下来的节点总是挂在R的最左边；
+    3. 中间树M：当前仍需继续查找的子树，其根节点就是当前的游标。
+    当连续两次向同一方向走时（zig-zig），先做一次旋转再拆分，这正是伸展树能保证均摊复杂度的关键。查找结束后，把M的
+左右子树分别接到L的最右边和R的最左边，再让L、R成为M根节点的左右孩子即可。整个过程只需要一趟，不需要递归和父指针。
+*/
+
+// 以key为目标对以root为根的子树进行伸展，返回新的根节点。key不存在时，新根是查找路径上最后访问的节点
+t_bstree_node *__bstree_splay(t_bstree_node *root, USER_KEY_TYPE key) {
+    if (nullptr == root)
+        return nullptr;
+
+    // header.entry.right是L的根，header.entry.left是R的根
+    t_bstree_node header;
+    header.entry.left = header.entry.right = nullptr;
+    t_bstree_node *left_max = &header;
+    t_bstree_node *right_min = &header;
+
+    while (true) {
+        if (key < root->key) {
+            if (nullptr == root->entry.left)
+                break;
+
+            // zig-zig：先右旋
+            if (key < root->entry.left->key) {
+                t_bstree_node *child = root->entry.left;
+                root->entry.left = child->entry.right;
+                child->entry.right = root;
+                root = child;
+                if (nullptr == root->entry.left)
+                    break;
+            }
+
+            // 当前根节点及其右子树都比key大，挂到R的最左边
+            right_min->entry.left = root;
+            right_min = root;
+            root = root->entry.left;
+        } else if (key > root->key) {
+            if (nullptr == root->entry.right)
+                break;
+
+            // zig-zig：先左旋
+            if (key > root->entry.right->key) {
+                t_bstree_node *child = root->entry.right;
+                root->entry.right = child->entry.left;
+                child->entry.left = root;
+                root = child;
+                if (nullptr == root->entry.right)
+                    break;
+            }
+
+            // 当前根节点及其左子树都比key小，挂到L的最右边
+            left_max->entry.right = root;
+            left_max = root;
+            root = root->entry.right;
+        } else {
+            break;
+        }
+    }
+
+    // 合并L、M、R
+    left_max->entry.right = root->entry.left;
+    right_min->entry.left = root->entry.right;
+    root->entry.left = header.entry.right;
+    root->entry.right = header.entry.left;
+
+    return root;
+}
+
+// 查找指定key的节点，找到后该节点会成为新的根节点；找不到时返回nullptr
+t_bstree_node *splay_find(t_bstree *tree, USER_KEY_TYPE key) {
+    if (nullptr == tree)
+        return nullptr;
+
+    tree->root = __bstree_splay(tree->root, key);
+    if (tree->root && tree->root->key == key)
+        return tree->root;
+
+    return nullptr;
+}
+
+// 插入节点，返回值的含义与insert_node_to_bstree相同
+int splay_insert(t_bstree *tree, USER_KEY_TYPE key) {
+    if (nullptr == tree)
+        return -1;
+
+    tree->root = __bstree_splay(tree->root, key);
+    if (tree->root && tree->root->key == key)
+        return 1;
+
+    t_bstree_node *node = create_bstree_node(key);
+    if (nullptr == node) {
+        return -2;
+    }
+
+    // 伸展之后，根节点是key的前驱或者后继，新节点直接作为新的根节点
+    if (tree->root) {
+        if (key < tree->root->key) {
+            node->entry.left = tree->root->entry.left;
+            node->entry.right = tree->root;
+            tree->root->entry.left = nullptr;
+        } else {
+            node->entry.right = tree->root->entry.right;
+            node->entry.left = tree->root;
+            tree->root->entry.right = nullptr;
+        }
+    }
+    tree->root = node;
+    ++tree->size;
+
+    return 0;
+}
+
+// 删除节点，成功返回0，不存在返回1
+int splay_erase(t_bstree *tree, USER_KEY_TYPE key) {
+    if (nullptr == tree)
+        return -1;
+
+    tree->root = __bstree_splay(tree->root, key);
+    if (nullptr == tree->root || tree->root->key != key)
+        return 1;
+
+    // 要删除的节点已经在根上了。左子树中的所有key都比它小，在左子树中对key伸展会把左子树的最大值搬到根上，
+    // 此时该最大值没有右孩子，正好把原来的右子树接上去
+    t_bstree_node *node = tree->root;
+    if (nullptr == node->entry.left) {
+        tree->root = node->entry.right;
+    } else {
+        tree->root = __bstree_splay(node->entry.left, key);
+        tree->root->entry.right = node->entry.right;
+    }
+    delete node;
+    --tree->size;
+
+    return 0;
+}
+
+/* ---------------------------------- 性能对比 --------------------------------- */
+
+#define BENCH_KEYS    (1 << 20)
+#define BENCH_LOOKUPS (1 << 21)
+
+/*
+    生成服从Zipf分布的访问序列：第i热的key被访问的概率正比于1 / i^theta。theta可能大于1，YCSB中的近似公式不适用，
+这里直接预先计算累积分布，再对均匀随机数二分查找即可。热度排名和key之间用一个随机排列打散，避免热点key恰好是
+连续的key。
+*/
+static vector<int> zipf_workload(const vector<int>& keys, double theta, int count, std::mt19937_64& rng) {
+    vector<double> cdf(keys.size());
+    double sum = 0;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        sum += 1.0 / std::pow((double)(i + 1), theta);
+        cdf[i] = sum;
+    }
+
+    std::uniform_real_distribution<double> uniform(0, sum);
+    vector<int> workload(count);
+    for (int i = 0; i < count; ++i) {
+        size_t rank = std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin();
+        workload[i] = keys[std::min(rank, keys.size() - 1)];
+    }
+
+    return workload;
+}
+
+template <typename F>
+static double bench_ns_per_op(const vector<int>& workload, F &&find) {
+    long long hits = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (auto key : workload) {
+        hits += find(key);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    // 防止编译器把查找优化掉
+    if (hits != (long long)workload.size()) {
+        std::printf("unexpected misses: %lld\n", (long long)workload.size() - hits);
+    }
+    return ns / workload.size();
+}
+
+int main(int argc, char *argv[]) {
+    // 与二叉搜索树相同的测试数据
+    int nums[] = {12,31,24,5,12,5,34,9,2985,324,5,69,8};
+    int len = sizeof(nums) / sizeof(int);
+
+    t_bstree tree;
+    bstree_init(&tree);
+    for (int i = 0; i < len; ++i) {
+        splay_insert(&tree, nums[i]);
+    }
+    splay_find(&tree, 34);
+    std::printf("root after find(34): %d\n", tree.root->key);
+
+    int del_nums[] = {5, 0, 12, 2985, 69};
+    len = sizeof(del_nums) / sizeof(int);
+    for (int i = 0; i < len; ++i) {
+        splay_erase(&tree, del_nums[i]);
+    }
+
+    vector<int> result;
+    inorder_traversal(tree.root, result);
+    for (auto key : result) {
+        std::printf("%d ", key);
+    }
+    std::printf("\n");
+    destroy_bstree(&tree);
+
+    // 两棵树中放入相同的key，插入顺序随机
+    std::mt19937_64 rng(argc > 1 ? std::atoll(argv[1]) : 20260417);
+    vector<int> keys(BENCH_KEYS);
+    for (int i = 0; i < BENCH_KEYS; ++i) {
+        keys[i] = i * 16;
+    }
+    std::shuffle(keys.begin(), keys.end(), rng);
+
+    t_rbtree rbtree = {};
+    rbtree_init(&rbtree);
+    for (auto key : keys) {
+        splay_insert(&tree, key);
+        rbtree_insert(&rbtree, key);
+    }
+
+    std::printf("%8s %16s %16s\n", "theta", "splay ns/op", "rbtree ns/op");
+    double thetas[] = {0.0, 0.9, 0.99, 1.1, 1.2};
+    for (auto theta : thetas) {
+        vector<int> workload = zipf_workload(keys, theta, BENCH_LOOKUPS, rng);
+        double splay_ns = bench_ns_per_op(workload, [&](int key) { return splay_find(&tree, key) != nullptr; });
+        double rbtree_ns = bench_ns_per_op(workload, [&](int key) { return rbtree_find(&rbtree, key) != nullptr; });
+        std::printf("%8.2f %16.1f %16.1f\n", theta, splay_ns, rbtree_ns);
+    }
+
+    destroy_bstree(&tree);
+    rbtree_destroy(&rbtree);
+    return 0;
+}
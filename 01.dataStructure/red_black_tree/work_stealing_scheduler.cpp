@@ -0,0 +1,439 @@
+/**
+ * @file work_stealing_scheduler.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 树算法共用的fork-join工作窃取调度器：每个核一个工作线程，每个工作线程一个Chase-Lev双端队列
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <pthread.h>
+#include <sched.h>
+#include <thread>
+#include <vector>
+
+using std::vector;
+
+/*
+    树上的递归算法（并行构建、并行销毁、并行遍历、并行校验）天然是fork-join的：把左子树交给别人，自己处理右子树，
+最后等左子树完成。如果每个子树都创建一个std::thread，创建和销毁线程的开销是几十微秒，而且线程数随递归深度指数增长，
+远远超过核数。这里的调度器固定创建与核数相同的工作线程，每个线程绑定到一个核上，任务只是一个堆上的小对象：
+
+    1. 每个工作线程有一个Chase-Lev双端队列（Chase & Lev 2005，内存序参考Lê等人2013年的C11版本）。只有队列的主人
+       在bottom端push和take，不需要加锁；其他线程在top端steal，用一次CAS和主人竞争最后一个元素。数组满时主人
+       换一个两倍大的数组，旧数组可能还有窃取者在读，所以不立即释放，挂到队列上等调度器销毁时统一释放。
+    2. 非工作线程（比如main）不能操作Chase-Lev队列的bottom端，它们提交的任务放进一个加锁的注入队列，工作线程
+       自己的队列为空时从注入队列的头部取，再随机选一个受害者窃取；非工作线程等待时从注入队列的尾部取。
+    3. 等待一组任务的线程不会阻塞，而是一边等一边执行任务：先取自己队列中的任务（最近提交的、数据还在缓存里），
+       再去窃取。所以任务中可以再fork、再等待，不会死锁，也不需要额外的线程。
+    4. 空闲的工作线程先自旋并yield，一段时间都偷不到任务再短暂sleep，避免在没有任务时占满所有的核。
+
+    为了让ThreadSanitizer能理解同步关系，论文中的独立fence改成了对top/bottom的seq_cst读写，语义等价。
+*/
+
+typedef std::function<void()> t_ws_task;
+
+typedef struct ws_group t_ws_group;
+
+// 提交到调度器的一个任务
+typedef struct ws_job {
+    t_ws_task task;
+    t_ws_group *group;
+} t_ws_job;
+
+// Chase-Lev双端队列的循环数组，容量是2的幂
+typedef struct ws_array {
+    long long mask;
+    std::atomic<t_ws_job *> *slots;
+} t_ws_array;
+
+typedef struct ws_deque {
+    alignas(64) std::atomic<long long> top;
+    alignas(64) std::atomic<long long> bottom;
+    std::atomic<t_ws_array *> array;
+    vector<t_ws_array *> retired;           // 扩容替换下来的旧数组，销毁时释放
+} t_ws_deque;
+
+typedef struct ws_pool {
+    int workers;
+    vector<std::thread> threads;
+    vector<t_ws_deque *> deques;
+    std::mutex inject_lock;                 // 非工作线程提交任务使用的注入队列
+    std::deque<t_ws_job *> inject;
+    std::atomic<long long> inject_size;
+    std::atomic<int> stopping;
+} t_ws_pool;
+
+// 一组需要等待的任务
+struct ws_group {
+    std::atomic<long long> pending;
+};
+
+#define WS_DEQUE_INITIAL_CAPACITY 256
+
+static thread_local int tls_ws_worker = -1;
+static thread_local t_ws_pool *tls_ws_pool = nullptr;
+static thread_local uint64_t tls_ws_seed = 0;
+
+/* ------------------------------- Chase-Lev双端队列 ------------------------------- */
+
+static t_ws_array *__ws_array_create(long long capacity) {
+    t_ws_array *array = new t_ws_array;
+    array->mask = capacity - 1;
+    array->slots = new std::atomic<t_ws_job *>[capacity];
+    return array;
+}
+
+static void __ws_array_destroy(t_ws_array *array) {
+    delete[] array->slots;
+    delete array;
+}
+
+static t_ws_deque *__ws_deque_create() {
+    t_ws_deque *deque = new t_ws_deque;
+    deque->top.store(0);
+    deque->bottom.store(0);
+    deque->array.store(__ws_array_create(WS_DEQUE_INITIAL_CAPACITY));
+    return deque;
+}
+
+static void __ws_deque_destroy(t_ws_deque *deque) {
+    for (auto array : deque->retired) {
+        __ws_array_destroy(array);
+    }
+    __ws_array_destroy(deque->array.load());
+    delete deque;
+}
+
+// 只能由队列的主人调用
+static void __ws_deque_push(t_ws_deque *deque, t_ws_job *job) {
+    long long bottom = deque->bottom.load(std::memory_order_relaxed);
+    long long top = deque->top.load(std::memory_order_acquire);
+    t_ws_array *array = deque->array.load(std::memory_order_relaxed);
+    if (bottom - top > array->mask) {
+        t_ws_array *bigger = __ws_array_create((array->mask + 1) * 2);
+        for (long long i = top; i < bottom; ++i) {
+            bigger->slots[i & bigger->mask].store(array->slots[i & array->mask].load(std::memory_order_relaxed),
+                                                  std::memory_order_relaxed);
+        }
+        deque->retired.push_back(array);
+        deque->array.store(bigger, std::memory_order_release);
+        array = bigger;
+    }
+
+    array->slots[bottom & array->mask].store(job, std::memory_order_relaxed);
+    deque->bottom.store(bottom + 1, std::memory_order_release);
+}
+
+// 只能由队列的主人调用，从bottom端取出最近push的任务，队列为空返回nullptr
+static t_ws_job *__ws_deque_take(t_ws_deque *deque) {
+    long long bottom = deque->bottom.load(std::memory_order_relaxed) - 1;
+    t_ws_array *array = deque->array.load(std::memory_order_relaxed);
+    deque->bottom.store(bottom, std::memory_order_seq_cst);
+    long long top = deque->top.load(std::memory_order_seq_cst);
+    if (top > bottom) {
+        deque->bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    t_ws_job *job = array->slots[bottom & array->mask].load(std::memory_order_relaxed);
+    if (top == bottom) {
+        // 最后一个元素，和窃取者竞争
+        if (!deque->top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            job = nullptr;
+        }
+        deque->bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+// 任意线程都可以调用，从top端窃取最早push的任务，队列为空或竞争失败返回nullptr
+static t_ws_job *__ws_deque_steal(t_ws_deque *deque) {
+    long long top = deque->top.load(std::memory_order_seq_cst);
+    long long bottom = deque->bottom.load(std::memory_order_seq_cst);
+    if (top >= bottom)
+        return nullptr;
+
+    t_ws_array *array = deque->array.load(std::memory_order_acquire);
+    t_ws_job *job = array->slots[top & array->mask].load(std::memory_order_relaxed);
+    if (!deque->top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return nullptr;
+
+    return job;
+}
+
+/* ---------------------------------- 调度器 --------------------------------- */
+
+static uint64_t __ws_random() {
+    tls_ws_seed ^= tls_ws_seed << 13;
+    tls_ws_seed ^= tls_ws_seed >> 7;
+    tls_ws_seed ^= tls_ws_seed << 17;
+    return tls_ws_seed;
+}
+
+// 当前线程是否是pool的工作线程
+static int __ws_is_worker(t_ws_pool *pool) {
+    return tls_ws_pool == pool && tls_ws_worker >= 0;
+}
+
+// 找一个可以执行的任务：自己的队列、注入队列、随机窃取
+static t_ws_job *__ws_find(t_ws_pool *pool) {
+    t_ws_job *job;
+    if (__ws_is_worker(pool) && (job = __ws_deque_take(pool->deques[tls_ws_worker])) != nullptr)
+        return job;
+
+    if (pool->inject_size.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> guard(pool->inject_lock);
+        if (!pool->inject.empty()) {
+            // 非工作线程像队列的主人一样从尾部取，保证嵌套等待时递归深度有界；工作线程从头部取最早的任务
+            if (__ws_is_worker(pool)) {
+                job = pool->inject.front();
+                pool->inject.pop_front();
+            } else {
+                job = pool->inject.back();
+                pool->inject.pop_back();
+            }
+            pool->inject_size.fetch_sub(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+
+    if (tls_ws_seed == 0) {
+        tls_ws_seed = (uint64_t)(uintptr_t)&job | 1;
+    }
+    int count = pool->workers;
+    int start = count > 0 ? (int)(__ws_random() % count) : 0;
+    for (int i = 0; i < count; ++i) {
+        int victim = (start + i) % count;
+        if (__ws_is_worker(pool) && victim == tls_ws_worker)
+            continue;
+
+        if ((job = __ws_deque_steal(pool->deques[victim])) != nullptr)
+            return job;
+    }
+
+    return nullptr;
+}
+
+// 先销毁job（包括task捕获的对象）再减少pending：pending归零后等待者可能立即返回并销毁group和task引用的数据
+static void __ws_run(t_ws_job *job) {
+    t_ws_group *group = job->group;
+    job->task();
+    delete job;
+    group->pending.fetch_sub(1, std::memory_order_release);
+}
+
+static void __ws_worker(t_ws_pool *pool, int index) {
+    tls_ws_worker = index;
+    tls_ws_pool = pool;
+    tls_ws_seed = 0x9e3779b97f4a7c15ULL * (index + 1);
+
+    int idle = 0;
+    while (!pool->stopping.load(std::memory_order_relaxed)) {
+        t_ws_job *job = __ws_find(pool);
+        if (job != nullptr) {
+            __ws_run(job);
+            idle = 0;
+        } else if (++idle < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+}
+
+// 创建workers个工作线程，workers <= 0时与核数相同；每个工作线程绑定到一个核上
+void ws_pool_init(t_ws_pool *pool, int workers) {
+    int cores = (int)std::thread::hardware_concurrency();
+    if (workers <= 0) {
+        workers = std::max(1, cores);
+    }
+
+    pool->workers = workers;
+    pool->stopping.store(0);
+    pool->inject_size.store(0);
+    for (int i = 0; i < workers; ++i) {
+        pool->deques.push_back(__ws_deque_create());
+    }
+    for (int i = 0; i < workers; ++i) {
+        pool->threads.emplace_back(__ws_worker, pool, i);
+        if (cores > 1) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(i % cores, &set);
+            pthread_setaffinity_np(pool->threads.back().native_handle(), sizeof(set), &set);
+        }
+    }
+}
+
+// 调用前所有的任务必须已经完成
+void ws_pool_destroy(t_ws_pool *pool) {
+    pool->stopping.store(1);
+    for (auto& thread : pool->threads) {
+        thread.join();
+    }
+    for (auto deque : pool->deques) {
+        __ws_deque_destroy(deque);
+    }
+    pool->threads.clear();
+    pool->deques.clear();
+}
+
+// 提交一个属于group的任务
+void ws_spawn(t_ws_pool *pool, t_ws_group *group, t_ws_task task) {
+    group->pending.fetch_add(1, std::memory_order_relaxed);
+    t_ws_job *job = new t_ws_job{std::move(task), group};
+    if (__ws_is_worker(pool)) {
+        __ws_deque_push(pool->deques[tls_ws_worker], job);
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(pool->inject_lock);
+    pool->inject.push_back(job);
+    pool->inject_size.fetch_add(1, std::memory_order_relaxed);
+}
+
+// 等待group中的所有任务（包括任务中再提交的任务）完成，等待期间帮忙执行任务
+void ws_wait(t_ws_pool *pool, t_ws_group *group) {
+    while (group->pending.load(std::memory_order_acquire) > 0) {
+        t_ws_job *job = __ws_find(pool);
+        if (job != nullptr) {
+            __ws_run(job);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+// fork-join：left作为任务提交，当前线程执行right，然后等待left完成
+void ws_invoke(t_ws_pool *pool, const t_ws_task& left, const t_ws_task& right) {
+    t_ws_group group = {{0}};
+    ws_spawn(pool, &group, left);
+    right();
+    ws_wait(pool, &group);
+}
+
+// 把[0, count)切成大约parts段，每段作为一个任务执行fn(begin, end)，等待全部完成
+void ws_parallel_for(t_ws_pool *pool, long long count, int parts,
+                     const std::function<void(long long, long long)>& fn) {
+    if (count <= 0)
+        return;
+
+    t_ws_group group = {{0}};
+    long long step = (count + std::max(1, parts) - 1) / std::max(1, parts);
+    for (long long begin = 0; begin < count; begin += step) {
+        long long end = std::min(count, begin + step);
+        ws_spawn(pool, &group, [&fn, begin, end]() { fn(begin, end); });
+    }
+    ws_wait(pool, &group);
+}
+
+// 其他文件可以直接#include本文件来使用调度器，此时先定义WS_SCHEDULER_NO_MAIN去掉下面的微基准测试
+#ifndef WS_SCHEDULER_NO_MAIN
+
+static long long fib_serial(int n) {
+    return n < 2 ? n : fib_serial(n - 1) + fib_serial(n - 2);
+}
+
+// 每一层递归都fork，衡量spawn/join本身的开销
+static long long fib_fork_join(t_ws_pool *pool, int n) {
+    if (n < 2)
+        return n;
+
+    long long left = 0, right = 0;
+    ws_invoke(pool, [&]() { left = fib_fork_join(pool, n - 1); }, [&]() { right = fib_fork_join(pool, n - 2); });
+    return left + right;
+}
+
+// 对照组：每次fork都创建一个std::thread，只能在较浅的几层使用，否则线程数爆炸
+static long long fib_raw_thread(int n, int depth) {
+    if (n < 2)
+        return n;
+    if (depth == 0)
+        return fib_serial(n);
+
+    long long left = 0;
+    std::thread thread([&]() { left = fib_raw_thread(n - 1, depth - 1); });
+    long long right = fib_raw_thread(n - 2, depth - 1);
+    thread.join();
+    return left + right;
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+    int workers = argc > 1 ? std::atoi(argv[1]) : 0;
+    int fib_n = argc > 2 ? std::atoi(argv[2]) : 27;
+    long long flat_tasks = 1000000;
+
+    t_ws_pool pool;
+    ws_pool_init(&pool, workers);
+    std::printf("%d workers, %u hardware threads\n", pool.workers, std::thread::hardware_concurrency());
+
+    // 1. 由main提交大量空任务，经过注入队列
+    std::atomic<long long> counter{0};
+    auto start = std::chrono::steady_clock::now();
+    t_ws_group group = {{0}};
+    for (long long i = 0; i < flat_tasks; ++i) {
+        ws_spawn(&pool, &group, [&counter]() { counter.fetch_add(1, std::memory_order_relaxed); });
+    }
+    ws_wait(&pool, &group);
+    double ms = elapsed_ms(start);
+    std::printf("flat spawn from main: %lld tasks, %.0f ns/task\n", counter.load(), ms * 1e6 / flat_tasks);
+
+    // 2. 工作线程内部的嵌套fork-join，任务都走Chase-Lev队列
+    counter.store(0);
+    start = std::chrono::steady_clock::now();
+    group.pending.store(0);
+    ws_spawn(&pool, &group, [&]() {
+        t_ws_group inner = {{0}};
+        for (long long i = 0; i < flat_tasks; ++i) {
+            ws_spawn(&pool, &inner, [&counter]() { counter.fetch_add(1, std::memory_order_relaxed); });
+        }
+        ws_wait(&pool, &inner);
+    });
+    ws_wait(&pool, &group);
+    ms = elapsed_ms(start);
+    std::printf("flat spawn from worker: %lld tasks, %.0f ns/task\n", counter.load(), ms * 1e6 / flat_tasks);
+
+    // 3. 递归fork-join，fib(n)会产生fib(n+1)-1次fork
+    start = std::chrono::steady_clock::now();
+    long long expected = fib_serial(fib_n);
+    double serial_ms = elapsed_ms(start);
+    long long forks = fib_serial(fib_n + 1) - 1;
+
+    start = std::chrono::steady_clock::now();
+    long long result = 0;
+    group.pending.store(0);
+    ws_spawn(&pool, &group, [&]() { result = fib_fork_join(&pool, fib_n); });
+    ws_wait(&pool, &group);
+    ms = elapsed_ms(start);
+    std::printf("fib(%d): serial %.1f ms, fork-join %.1f ms, %lld forks, %.0f ns/fork, %s\n", fib_n, serial_ms, ms,
+                forks, (ms - serial_ms) * 1e6 / forks, result == expected ? "ok" : "wrong");
+
+    // 4. 对照组：std::thread per fork，只在前10层fork
+    int depth = 10;
+    start = std::chrono::steady_clock::now();
+    result = fib_raw_thread(fib_n, depth);
+    ms = elapsed_ms(start);
+    long long threads = (1LL << depth) - 1;
+    std::printf("fib(%d) with std::thread per fork (top %d levels): %.1f ms, up to %lld threads, %.0f ns/thread, %s\n",
+                fib_n, depth, ms, threads, (ms - serial_ms) * 1e6 / threads, result == expected ? "ok" : "wrong");
+
+    ws_pool_destroy(&pool);
+    return 0;
+}
+#endif
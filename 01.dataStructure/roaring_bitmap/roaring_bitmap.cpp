@@ -0,0 +1,578 @@
+/**
+ * @file roaring_bitmap.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 压缩位图（roaring bitmap风格）的简单实现，提供与t_rbtree相同的有序集合接口
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using std::vector;
+
+// 与红黑树保持一致，假设用户的key的类型是int
+typedef int USER_KEY_TYPE;
+
+/*
+    roaring bitmap的思路：把32位的key拆成高16位和低16位两部分。高16位相同的key放在同一个容器（container）中，
+容器中只保存低16位。每个容器最多保存65536个值，根据容器中元素的多少，选择不同的存储方式：
+    1. 数组容器：元素个数不超过4096时，用有序的uint16_t数组保存，每个key占2字节；
+    2. 位图容器：元素个数超过4096时，用65536位（8KB）的位图保存，每个key平均不超过2字节，越稠密越省。
+    4096这个阈值正好是两种容器占用空间相等的点：4096 * 2B = 8KB。
+    对于稠密的ID区间，每个key只占用1~2个bit，而红黑树的每个节点需要24字节以上。
+
+    由于USER_KEY_TYPE是有符号的int，为了让容器的顺序和key的顺序一致，先将符号位翻转，映射到无符号的32位整数上，
+这样INT_MIN映射为0，INT_MAX映射为0xFFFFFFFF，大小关系保持不变。
+*/
+
+#define ROARING_CTN_ARRAY    0
+#define ROARING_CTN_BITMAP   1
+
+#define ROARING_ARRAY_MAX    4096
+#define ROARING_BITMAP_WORDS 1024 // 65536 / 64
+
+typedef struct roaring_container {
+    int type;
+    int cardinality;
+    vector<uint16_t> array; // type为ROARING_CTN_ARRAY时使用，有序
+    uint64_t *words;        // type为ROARING_CTN_BITMAP时使用，共ROARING_BITMAP_WORDS个字
+} t_roaring_container;
+
+// 高16位和容器一一对应，两个数组都按照高16位有序排列
+typedef struct roaring {
+    vector<uint16_t> highs;
+    vector<t_roaring_container *> containers;
+} t_roaring;
+
+static inline uint32_t roaring_key_to_u32(USER_KEY_TYPE key) {
+    return (uint32_t)key ^ 0x80000000u;
+}
+
+static inline USER_KEY_TYPE roaring_u32_to_key(uint32_t value) {
+    return (USER_KEY_TYPE)(value ^ 0x80000000u);
+}
+
+t_roaring_container *roaring_create_container(int type) {
+    t_roaring_container *container = new t_roaring_container;
+    if (nullptr == container) {
+        return nullptr;
+    }
+
+    container->type = type;
+    container->cardinality = 0;
+    container->words = nullptr;
+    if (type == ROARING_CTN_BITMAP) {
+        container->words = new uint64_t[ROARING_BITMAP_WORDS]();
+    }
+
+    return container;
+}
+
+void roaring_destroy_container(t_roaring_container *container) {
+    if (nullptr == container)
+        return;
+
+    delete[] container->words;
+    delete container;
+}
+
+// 销毁整个位图
+void roaring_destroy(t_roaring *bm) {
+    if (nullptr == bm)
+        return;
+
+    for (auto container : bm->containers) {
+        roaring_destroy_container(container);
+    }
+    bm->highs.clear();
+    bm->containers.clear();
+}
+
+// 数组容器转换为位图容器，在数组容器元素个数超过阈值时调用
+static void __container_array_to_bitmap(t_roaring_container *container) {
+    container->words = new uint64_t[ROARING_BITMAP_WORDS]();
+    for (auto low : container->array) {
+        container->words[low >> 6] |= (1ULL << (low & 63));
+    }
+
+    vector<uint16_t>().swap(container->array);
+    container->type = ROARING_CTN_BITMAP;
+}
+
+// 位图容器转换为数组容器，在位图容器元素个数不超过阈值时调用
+static void __container_bitmap_to_array(t_roaring_container *container) {
+    container->array.clear();
+    container->array.reserve(container->cardinality);
+    for (int i = 0; i < ROARING_BITMAP_WORDS; ++i) {
+        uint64_t word = container->words[i];
+        while (word) {
+            container->array.emplace_back((uint16_t)(i * 64 + __builtin_ctzll(word)));
+            word &= word - 1;
+        }
+    }
+
+    delete[] container->words;
+    container->words = nullptr;
+    container->type = ROARING_CTN_ARRAY;
+}
+
+// 位图容器的基数需要在批量运算之后重新统计
+static int __bitmap_cardinality(const uint64_t *words) {
+    int cardinality = 0;
+    for (int i = 0; i < ROARING_BITMAP_WORDS; ++i) {
+        cardinality += __builtin_popcountll(words[i]);
+    }
+
+    return cardinality;
+}
+
+// 向容器中加入低16位，加入成功返回1，已存在返回0
+static int __container_add(t_roaring_container *container, uint16_t low) {
+    if (container->type == ROARING_CTN_BITMAP) {
+        uint64_t mask = 1ULL << (low & 63);
+        if (container->words[low >> 6] & mask)
+            return 0;
+
+        container->words[low >> 6] |= mask;
+        container->cardinality++;
+        return 1;
+    }
+
+    auto it = std::lower_bound(container->array.begin(), container->array.end(), low);
+    if (it != container->array.end() && *it == low)
+        return 0;
+
+    // 数组容器已满，先转换为位图再插入
+    if (container->cardinality == ROARING_ARRAY_MAX) {
+        __container_array_to_bitmap(container);
+        return __container_add(container, low);
+    }
+
+    container->array.insert(it, low);
+    container->cardinality++;
+    return 1;
+}
+
+// 从容器中删除低16位，删除成功返回1，不存在返回0
+static int __container_remove(t_roaring_container *container, uint16_t low) {
+    if (container->type == ROARING_CTN_BITMAP) {
+        uint64_t mask = 1ULL << (low & 63);
+        if (!(container->words[low >> 6] & mask))
+            return 0;
+
+        container->words[low >> 6] &= ~mask;
+        container->cardinality--;
+        // 元素个数回落到阈值以下，改用数组容器更省空间
+        if (container->cardinality <= ROARING_ARRAY_MAX) {
+            __container_bitmap_to_array(container);
+        }
+        return 1;
+    }
+
+    auto it = std::lower_bound(container->array.begin(), container->array.end(), low);
+    if (it == container->array.end() || *it != low)
+        return 0;
+
+    container->array.erase(it);
+    container->cardinality--;
+    return 1;
+}
+
+static int __container_contains(const t_roaring_container *container, uint16_t low) {
+    if (container->type == ROARING_CTN_BITMAP) {
+        return (container->words[low >> 6] >> (low & 63)) & 1;
+    }
+
+    return std::binary_search(container->array.begin(), container->array.end(), low);
+}
+
+// 返回容器中小于等于low的元素个数
+static int __container_rank(const t_roaring_container *container, uint16_t low) {
+    if (container->type == ROARING_CTN_BITMAP) {
+        int rank = 0;
+        int last = low >> 6;
+        for (int i = 0; i < last; ++i) {
+            rank += __builtin_popcountll(container->words[i]);
+        }
+        // 注意low & 63为63时不能直接左移64位
+        uint64_t mask = (low & 63) == 63 ? ~0ULL : ((1ULL << ((low & 63) + 1)) - 1);
+        return rank + __builtin_popcountll(container->words[last] & mask);
+    }
+
+    return std::upper_bound(container->array.begin(), container->array.end(), low) - container->array.begin();
+}
+
+// 返回高16位为high的容器在数组中的下标，不存在时返回应插入的位置，并通过found告知是否找到
+static int __roaring_find_container(const t_roaring *bm, uint16_t high, int *found) {
+    auto it = std::lower_bound(bm->highs.begin(), bm->highs.end(), high);
+    *found = (it != bm->highs.end() && *it == high);
+    return it - bm->highs.begin();
+}
+
+// 插入key，成功返回0，已存在返回1，出错返回负数，返回值的含义与insert_node_to_bstree相同
+int roaring_insert(t_roaring *bm, USER_KEY_TYPE key) {
+    if (nullptr == bm)
+        return -1;
+
+    uint32_t value = roaring_key_to_u32(key);
+    uint16_t high = value >> 16;
+    int found = 0;
+    int idx = __roaring_find_container(bm, high, &found);
+    if (!found) {
+        t_roaring_container *container = roaring_create_container(ROARING_CTN_ARRAY);
+        if (nullptr == container) {
+            return -2;
+        }
+
+        bm->highs.insert(bm->highs.begin() + idx, high);
+        bm->containers.insert(bm->containers.begin() + idx, container);
+    }
+
+    return __container_add(bm->containers[idx], (uint16_t)value) ? 0 : 1;
+}
+
+// 删除key，成功返回0，不存在返回1
+int roaring_erase(t_roaring *bm, USER_KEY_TYPE key) {
+    if (nullptr == bm)
+        return -1;
+
+    uint32_t value = roaring_key_to_u32(key);
+    int found = 0;
+    int idx = __roaring_find_container(bm, value >> 16, &found);
+    if (!found || !__container_remove(bm->containers[idx], (uint16_t)value))
+        return 1;
+
+    // 容器空了就直接回收
+    if (bm->containers[idx]->cardinality == 0) {
+        roaring_destroy_container(bm->containers[idx]);
+        bm->highs.erase(bm->highs.begin() + idx);
+        bm->containers.erase(bm->containers.begin() + idx);
+    }
+
+    return 0;
+}
+
+int roaring_contains(const t_roaring *bm, USER_KEY_TYPE key) {
+    if (nullptr == bm)
+        return 0;
+
+    uint32_t value = roaring_key_to_u32(key);
+    int found = 0;
+    int idx = __roaring_find_container(bm, value >> 16, &found);
+    return found && __container_contains(bm->containers[idx], (uint16_t)value);
+}
+
+// 返回集合中小于等于key的元素个数
+long long roaring_rank(const t_roaring *bm, USER_KEY_TYPE key) {
+    if (nullptr == bm)
+        return 0;
+
+    uint32_t value = roaring_key_to_u32(key);
+    uint16_t high = value >> 16;
+    long long rank = 0;
+    for (size_t i = 0; i < bm->highs.size() && bm->highs[i] <= high; ++i) {
+        if (bm->highs[i] < high) {
+            rank += bm->containers[i]->cardinality;
+        } else {
+            rank += __container_rank(bm->containers[i], (uint16_t)value);
+        }
+    }
+
+    return rank;
+}
+
+long long roaring_cardinality(const t_roaring *bm) {
+    if (nullptr == bm)
+        return 0;
+
+    long long cardinality = 0;
+    for (auto container : bm->containers) {
+        cardinality += container->cardinality;
+    }
+
+    return cardinality;
+}
+
+// 统计位图当前占用的字节数（不含分配器本身的额外开销）
+size_t roaring_memory_usage(const t_roaring *bm) {
+    if (nullptr == bm)
+        return 0;
+
+    size_t bytes = sizeof(t_roaring);
+    bytes += bm->highs.capacity() * sizeof(uint16_t);
+    bytes += bm->containers.capacity() * sizeof(t_roaring_container *);
+    for (auto container : bm->containers) {
+        bytes += sizeof(t_roaring_container);
+        if (container->type == ROARING_CTN_BITMAP) {
+            bytes += ROARING_BITMAP_WORDS * sizeof(uint64_t);
+        } else {
+            bytes += container->array.capacity() * sizeof(uint16_t);
+        }
+    }
+
+    return bytes;
+}
+
+// 有序遍历，接口与红黑树的inorder_traversal保持一致
+int inorder_traversal(const t_roaring *bm, vector<int>& result) {
+    if (nullptr == bm)
+        return -1;
+
+    for (size_t i = 0; i < bm->highs.size(); ++i) {
+        uint32_t base = (uint32_t)bm->highs[i] << 16;
+        const t_roaring_container *container = bm->containers[i];
+        if (container->type == ROARING_CTN_ARRAY) {
+            for (auto low : container->array) {
+                result.emplace_back(roaring_u32_to_key(base | low));
+            }
+            continue;
+        }
+
+        for (int w = 0; w < ROARING_BITMAP_WORDS; ++w) {
+            uint64_t word = container->words[w];
+            while (word) {
+                result.emplace_back(roaring_u32_to_key(base | (uint32_t)(w * 64 + __builtin_ctzll(word))));
+                word &= word - 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+// 两个位图容器按字进行或/与运算，这是集合运算中最热的部分，用SIMD一次处理256/128位
+#define ROARING_OP_OR  0
+#define ROARING_OP_AND 1
+static void __bitmap_op(uint64_t *dst, const uint64_t *a, const uint64_t *b, int op) {
+    int i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= ROARING_BITMAP_WORDS; i += 4) {
+        __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+        __m256i vr = (op == ROARING_OP_OR) ? _mm256_or_si256(va, vb) : _mm256_and_si256(va, vb);
+        _mm256_storeu_si256((__m256i *)(dst + i), vr);
+    }
+#elif defined(__SSE2__)
+    for (; i + 2 <= ROARING_BITMAP_WORDS; i += 2) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        __m128i vr = (op == ROARING_OP_OR) ? _mm_or_si128(va, vb) : _mm_and_si128(va, vb);
+        _mm_storeu_si128((__m128i *)(dst + i), vr);
+    }
+#endif
+    // 不支持SIMD的平台以及剩余部分，逐字处理
+    for (; i < ROARING_BITMAP_WORDS; ++i) {
+        dst[i] = (op == ROARING_OP_OR) ? (a[i] | b[i]) : (a[i] & b[i]);
+    }
+}
+
+// 计算两个容器的并集，返回新容器
+static t_roaring_container *__container_union(const t_roaring_container *a, const t_roaring_container *b) {
+    // 两个数组容器：归并，结果超过阈值时再转为位图
+    if (a->type == ROARING_CTN_ARRAY && b->type == ROARING_CTN_ARRAY) {
+        t_roaring_container *result = roaring_create_container(ROARING_CTN_ARRAY);
+        result->array.resize(a->array.size() + b->array.size());
+        auto end = std::set_union(a->array.begin(), a->array.end(),
+                                  b->array.begin(), b->array.end(),
+                                  result->array.begin());
+        result->array.erase(end, result->array.end());
+        result->cardinality = result->array.size();
+        if (result->cardinality > ROARING_ARRAY_MAX) {
+            __container_array_to_bitmap(result);
+        }
+        return result;
+    }
+
+    t_roaring_container *result = roaring_create_container(ROARING_CTN_BITMAP);
+    if (a->type == ROARING_CTN_BITMAP && b->type == ROARING_CTN_BITMAP) {
+        __bitmap_op(result->words, a->words, b->words, ROARING_OP_OR);
+    } else {
+        // 一个数组一个位图：复制位图后，把数组中的元素逐个置位
+        const t_roaring_container *bitmap = (a->type == ROARING_CTN_BITMAP ? a : b);
+        const t_roaring_container *array = (a->type == ROARING_CTN_BITMAP ? b : a);
+        std::copy(bitmap->words, bitmap->words + ROARING_BITMAP_WORDS, result->words);
+        for (auto low : array->array) {
+            result->words[low >> 6] |= (1ULL << (low & 63));
+        }
+    }
+    result->cardinality = __bitmap_cardinality(result->words);
+
+    return result;
+}
+
+// 计算两个容器的交集，返回新容器，交集为空时返回nullptr
+static t_roaring_container *__container_intersection(const t_roaring_container *a, const t_roaring_container *b) {
+    t_roaring_container *result = nullptr;
+    if (a->type == ROARING_CTN_BITMAP && b->type == ROARING_CTN_BITMAP) {
+        result = roaring_create_container(ROARING_CTN_BITMAP);
+        __bitmap_op(result->words, a->words, b->words, ROARING_OP_AND);
+        result->cardinality = __bitmap_cardinality(result->words);
+        if (result->cardinality <= ROARING_ARRAY_MAX) {
+            __container_bitmap_to_array(result);
+        }
+    } else {
+        // 至少有一个是数组容器，交集的大小不会超过数组容器，结果一定是数组容器
+        result = roaring_create_container(ROARING_CTN_ARRAY);
+        if (a->type == ROARING_CTN_ARRAY && b->type == ROARING_CTN_ARRAY) {
+            std::set_intersection(a->array.begin(), a->array.end(),
+                                  b->array.begin(), b->array.end(),
+                                  std::back_inserter(result->array));
+        } else {
+            const t_roaring_container *bitmap = (a->type == ROARING_CTN_BITMAP ? a : b);
+            const t_roaring_container *array = (a->type == ROARING_CTN_BITMAP ? b : a);
+            for (auto low : array->array) {
+                if (__container_contains(bitmap, low)) {
+                    result->array.emplace_back(low);
+                }
+            }
+        }
+        result->cardinality = result->array.size();
+    }
+
+    if (result->cardinality == 0) {
+        roaring_destroy_container(result);
+        return nullptr;
+    }
+
+    return result;
+}
+
+static t_roaring_container *__container_clone(const t_roaring_container *container) {
+    t_roaring_container *result = roaring_create_container(container->type);
+    result->cardinality = container->cardinality;
+    if (container->type == ROARING_CTN_BITMAP) {
+        std::copy(container->words, container->words + ROARING_BITMAP_WORDS, result->words);
+    } else {
+        result->array = container->array;
+    }
+
+    return result;
+}
+
+// 计算a和b的并集，结果保存到result中（result原有的内容会被清空）
+int roaring_union(t_roaring *result, const t_roaring *a, const t_roaring *b) {
+    if (nullptr == result || nullptr == a || nullptr == b)
+        return -1;
+
+    t_roaring tmp;
+    size_t i = 0, j = 0;
+    // 按高16位归并两个容器数组
+    while (i < a->highs.size() || j < b->highs.size()) {
+        if (j == b->highs.size() || (i < a->highs.size() && a->highs[i] < b->highs[j])) {
+            tmp.highs.emplace_back(a->highs[i]);
+            tmp.containers.emplace_back(__container_clone(a->containers[i++]));
+        } else if (i == a->highs.size() || b->highs[j] < a->highs[i]) {
+            tmp.highs.emplace_back(b->highs[j]);
+            tmp.containers.emplace_back(__container_clone(b->containers[j++]));
+        } else {
+            tmp.highs.emplace_back(a->highs[i]);
+            tmp.containers.emplace_back(__container_union(a->containers[i++], b->containers[j++]));
+        }
+    }
+
+    // 先算到临时位图再交换，允许result与a或b是同一个位图
+    roaring_destroy(result);
+    result->highs.swap(tmp.highs);
+    result->containers.swap(tmp.containers);
+    return 0;
+}
+
+// 计算a和b的交集，结果保存到result中（result原有的内容会被清空）
+int roaring_intersection(t_roaring *result, const t_roaring *a, const t_roaring *b) {
+    if (nullptr == result || nullptr == a || nullptr == b)
+        return -1;
+
+    t_roaring tmp;
+    size_t i = 0, j = 0;
+    while (i < a->highs.size() && j < b->highs.size()) {
+        if (a->highs[i] < b->highs[j]) {
+            ++i;
+        } else if (b->highs[j] < a->highs[i]) {
+            ++j;
+        } else {
+            t_roaring_container *container = __container_intersection(a->containers[i], b->containers[j]);
+            if (container) {
+                tmp.highs.emplace_back(a->highs[i]);
+                tmp.containers.emplace_back(container);
+            }
+            ++i, ++j;
+        }
+    }
+
+    roaring_destroy(result);
+    result->highs.swap(tmp.highs);
+    result->containers.swap(tmp.containers);
+    return 0;
+}
+
+int main() {
+    // 与红黑树相同的测试数据，有重复的，所以只保存一遍，共10个不重复元素
+    int nums[] = {12,31,24,5,12,5,34,9,2985,324,5,69,8};
+    int len = sizeof(nums) / sizeof(int);
+
+    t_roaring bm;
+    for (int i = 0; i < len; ++i) {
+        roaring_insert(&bm, nums[i]);
+    }
+
+    vector<int> result;
+    inorder_traversal(&bm, result);
+    for (auto key : result) {
+        std::printf("%d ", key);
+    }
+    std::printf("\n");
+
+    int del_nums[] = {5, 0, 12, 2985, 69};
+    len = sizeof(del_nums) / sizeof(int);
+    for (int i = 0; i < len; ++i) {
+        roaring_erase(&bm, del_nums[i]);
+    }
+
+    result.clear();
+    inorder_traversal(&bm, result);
+    for (auto key : result) {
+        std::printf("%d ", key);
+    }
+    std::printf("\n");
+    std::printf("rank(31) = %lld, rank(-1) = %lld\n", roaring_rank(&bm, 31), roaring_rank(&bm, -1));
+    roaring_destroy(&bm);
+
+    // 稠密ID区间的内存占用对比，t_rbtree_node是int key + int color + 两个指针，共24字节
+    const int count = 1000000;
+    t_roaring dense, odd;
+    for (int i = 0; i < count; ++i) {
+        roaring_insert(&dense, i);
+        if (i & 1) {
+            roaring_insert(&odd, i + count / 2);
+        }
+    }
+    size_t bytes = roaring_memory_usage(&dense);
+    std::printf("%d dense keys: roaring %zu bytes (%.2f bits/key), rbtree ~%zu bytes\n",
+                count, bytes, bytes * 8.0 / count, (size_t)count * 24);
+
+    t_roaring u, n;
+    auto start = std::chrono::steady_clock::now();
+    roaring_union(&u, &dense, &odd);
+    roaring_intersection(&n, &dense, &odd);
+    auto cost = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    std::printf("union: %lld keys, intersection: %lld keys, cost %lld us\n",
+                roaring_cardinality(&u), roaring_cardinality(&n), (long long)cost.count());
+
+    roaring_destroy(&dense);
+    roaring_destroy(&odd);
+    roaring_destroy(&u);
+    roaring_destroy(&n);
+    return 0;
+}
@@ -0,0 +1,560 @@
+/**
+ * @file concurrent_skip_list.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 无锁并发跳表（CAS链接各层 + 基于epoch的内存回收），并与加锁的t_rbtree做多线程性能对比
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+// 复用红黑树的实现做对比测试
+#define RBTREE_NO_MAIN
+#include "../red_black_tree/red_black_tree_recursion.cpp"
+
+using std::vector;
+
+/*
+    红黑树的插入调整（rbtree_insert_maintian）在回溯时会旋转、改色，修改的范围从插入点一直可能延伸到根节点，
+只能整棵树加一把大锁，写多的场景下多核根本用不起来。跳表没有全局的再平衡操作，插入和删除只修改待操作节点前后的
+指针，因此每一层都可以用CAS独立链接，做到无锁。
+
+    1. 删除分为两步：先逻辑删除，即从高层到底层依次把待删除节点每层next指针的最低位置1（标记），底层标记成功的线程
+       才算真正删除了该节点；再物理删除，即后续任何线程在查找时遇到被标记的节点，都会顺手用CAS把它从链表中摘掉。
+       由于被标记的next指针无法再被CAS成功，所以不会有新节点挂到一个已经被删除的节点后面。
+    2. 节点被摘掉后不能立刻释放，因为其他线程可能刚刚读到它的指针。这里使用基于epoch的回收（EBR）：线程在每次操作前
+       登记当前的全局epoch，操作后退出；被删除的节点记录下删除时的epoch，当全局epoch前进了两次以后，所有可能持有该
+       节点指针的线程都已经退出了临界区，此时才真正释放。EBR的状态（epoch、每个线程的槽位和待回收的节点）属于各自的
+       跳表，销毁一个跳表只会释放它自己的节点，不会动到其他跳表正在使用的槽位。
+    3. 插入时高层的链接和删除可能并发发生：插入线程还在链接高层时，节点可能已经被删除并从低层摘掉了。为了保证节点
+       被回收时已经在所有层都不可达，每个节点带一个计数（初值为2），插入线程完成所有层的链接、删除线程完成物理摘除后
+       各减一，最后减到0的线程负责把节点交给EBR回收。
+*/
+
+#define SKIPLIST_MAX_LEVEL 24
+
+typedef struct skiplist_node {
+    USER_KEY_TYPE key;
+    int level;
+    std::atomic<int> pending;               // 见上面说明的第3点
+    std::atomic<uintptr_t> next[1];         // 实际长度为level，最低位是删除标记
+} t_skiplist_node;
+
+typedef struct skiplist {
+    t_skiplist_node *head;                  // 哨兵头节点，层数为SKIPLIST_MAX_LEVEL，key无意义
+    struct ebr_domain *ebr;                 // 该跳表的EBR状态
+} t_skiplist;
+
+#define SKIPLIST_MARK_BIT ((uintptr_t)1)
+
+static inline t_skiplist_node *skiplist_ptr(uintptr_t value) {
+    return (t_skiplist_node *)(value & ~SKIPLIST_MARK_BIT);
+}
+
+static inline int skiplist_is_marked(uintptr_t value) {
+    return (int)(value & SKIPLIST_MARK_BIT);
+}
+
+t_skiplist_node *skiplist_create_node(USER_KEY_TYPE key, int level) {
+    size_t bytes = sizeof(t_skiplist_node) + (level - 1) * sizeof(std::atomic<uintptr_t>);
+    t_skiplist_node *node = (t_skiplist_node *)::operator new(bytes, std::nothrow);
+    if (nullptr == node) {
+        return nullptr;
+    }
+
+    node->key = key;
+    node->level = level;
+    new (&node->pending) std::atomic<int>(2);
+    for (int i = 0; i < level; ++i) {
+        new (&node->next[i]) std::atomic<uintptr_t>(0);
+    }
+
+    return node;
+}
+
+void skiplist_free_node(t_skiplist_node *node) {
+    ::operator delete(node);
+}
+
+/* ---------------------------- 基于epoch的内存回收 ---------------------------- */
+
+#define EBR_MAX_THREADS   128
+#define EBR_RETIRE_BATCH  64
+
+typedef struct ebr_retired {
+    uint64_t epoch;
+    t_skiplist_node *node;
+} t_ebr_retired;
+
+// 每个线程在每个跳表中一个槽位，按缓存行对齐，避免不同线程的epoch互相伪共享
+typedef struct alignas(64) ebr_slot {
+    std::atomic<int> active;
+    std::atomic<uint64_t> epoch;
+    vector<t_ebr_retired> retired;          // 只有持有该槽位编号的线程会读写
+} t_ebr_slot;
+
+typedef struct ebr_domain {
+    std::atomic<uint64_t> epoch;
+    t_ebr_slot slots[EBR_MAX_THREADS];
+} t_ebr_domain;
+
+/*
+    线程的槽位编号是全局分配的，同一个线程在所有跳表中都使用相同编号的槽位。线程退出时只归还编号，它在各个跳表中
+还没来得及释放的节点留在对应的槽位里，由之后拿到这个编号的线程继续回收，或者在销毁跳表时统一释放。
+*/
+static std::atomic<int> g_ebr_slot_in_use[EBR_MAX_THREADS];
+
+// 线程退出时自动归还槽位编号
+struct ebr_thread_guard {
+    int slot = -1;
+    ~ebr_thread_guard() {
+        if (slot >= 0) {
+            g_ebr_slot_in_use[slot].store(0, std::memory_order_release);
+        }
+    }
+};
+static thread_local ebr_thread_guard t_ebr_guard;
+
+static t_ebr_slot *ebr_current_slot(t_ebr_domain *domain) {
+    if (t_ebr_guard.slot >= 0)
+        return &domain->slots[t_ebr_guard.slot];
+
+    for (int i = 0; i < EBR_MAX_THREADS; ++i) {
+        int expected = 0;
+        if (g_ebr_slot_in_use[i].compare_exchange_strong(expected, 1, std::memory_order_acquire)) {
+            t_ebr_guard.slot = i;
+            return &domain->slots[i];
+        }
+    }
+
+    std::fprintf(stderr, "ebr: too many threads\n");
+    std::abort();
+}
+
+// 进入临界区，在此之后读到的节点指针，在退出临界区之前都不会被释放
+static void ebr_enter(t_ebr_domain *domain) {
+    t_ebr_slot *slot = ebr_current_slot(domain);
+    slot->active.store(1, std::memory_order_relaxed);
+    slot->epoch.store(domain->epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    // 必须保证对active/epoch的写先于之后对跳表的读，否则回收线程可能看不到本线程
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+static void ebr_exit(t_ebr_domain *domain) {
+    ebr_current_slot(domain)->active.store(0, std::memory_order_release);
+}
+
+// 当所有处于临界区的线程都已经看到了当前的epoch，epoch才能前进；这里只读其他槽位的active/epoch两个原子变量
+static void ebr_try_advance(t_ebr_domain *domain) {
+    uint64_t epoch = domain->epoch.load();
+    for (int i = 0; i < EBR_MAX_THREADS; ++i) {
+        t_ebr_slot *slot = &domain->slots[i];
+        if (slot->active.load() && slot->epoch.load() != epoch)
+            return;
+    }
+
+    domain->epoch.compare_exchange_strong(epoch, epoch + 1);
+}
+
+// 释放所有在两个epoch之前删除的节点
+static void ebr_reclaim(t_ebr_domain *domain, t_ebr_slot *slot) {
+    uint64_t epoch = domain->epoch.load();
+    size_t kept = 0;
+    for (size_t i = 0; i < slot->retired.size(); ++i) {
+        if (slot->retired[i].epoch + 2 <= epoch) {
+            skiplist_free_node(slot->retired[i].node);
+        } else {
+            slot->retired[kept++] = slot->retired[i];
+        }
+    }
+    slot->retired.resize(kept);
+}
+
+static void ebr_retire(t_ebr_domain *domain, t_skiplist_node *node) {
+    t_ebr_slot *slot = ebr_current_slot(domain);
+    slot->retired.push_back({domain->epoch.load(), node});
+    if (slot->retired.size() >= EBR_RETIRE_BATCH) {
+        ebr_try_advance(domain);
+        ebr_reclaim(domain, slot);
+    }
+}
+
+/* --------------------------------- 跳表本身 --------------------------------- */
+
+// 每个线程独立的随机数发生器，避免rand()内部的锁
+static int skiplist_random_level() {
+    static thread_local uint64_t seed = 0x9E3779B97F4A7C15ULL ^ (uint64_t)(uintptr_t)&seed;
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+
+    // 每层以1/4的概率上升，期望每个节点有4/3个next指针
+    int level = 1;
+    uint64_t bits = seed;
+    while (level < SKIPLIST_MAX_LEVEL && (bits & 3) == 0) {
+        ++level;
+        bits >>= 2;
+    }
+
+    return level;
+}
+
+int skiplist_init(t_skiplist *list) {
+    if (nullptr == list)
+        return -1;
+
+    list->head = skiplist_create_node(0, SKIPLIST_MAX_LEVEL);
+    if (nullptr == list->head) {
+        return -2;
+    }
+
+    list->ebr = new (std::nothrow) t_ebr_domain();
+    if (nullptr == list->ebr) {
+        skiplist_free_node(list->head);
+        list->head = nullptr;
+        return -2;
+    }
+
+    return 0;
+}
+
+// 节点已经被删除线程和插入线程都“放手”了，交给EBR回收
+static void skiplist_release_node(t_skiplist *list, t_skiplist_node *node) {
+    if (node->pending.fetch_sub(1) == 1) {
+        ebr_retire(list->ebr, node);
+    }
+}
+
+/*
+    在每一层找到第一个key >= 给定key的节点succs[i]以及它的前驱preds[i]，沿途摘除所有已被标记删除的节点。
+如果底层找到了相等的key，返回1，否则返回0。调用前必须已经进入EBR临界区。
+*/
+static int __skiplist_find(t_skiplist *list, USER_KEY_TYPE key, t_skiplist_node **preds, t_skiplist_node **succs) {
+retry:
+    t_skiplist_node *pred = list->head;
+    for (int level = SKIPLIST_MAX_LEVEL - 1; level >= 0; --level) {
+        t_skiplist_node *curr = skiplist_ptr(pred->next[level].load());
+        while (curr) {
+            uintptr_t succ = curr->next[level].load();
+            // curr在这一层已经被标记删除，把它摘掉；pred也被删除时CAS会失败，只能从头再来
+            if (skiplist_is_marked(succ)) {
+                uintptr_t expected = (uintptr_t)curr;
+                if (!pred->next[level].compare_exchange_strong(expected, succ & ~SKIPLIST_MARK_BIT))
+                    goto retry;
+
+                curr = skiplist_ptr(succ);
+                continue;
+            }
+
+            if (curr->key >= key)
+                break;
+
+            pred = curr;
+            curr = skiplist_ptr(succ);
+        }
+
+        preds[level] = pred;
+        succs[level] = curr;
+    }
+
+    return succs[0] != nullptr && succs[0]->key == key;
+}
+
+// 插入key，成功返回0，已存在返回1，出错返回负数
+int skiplist_insert(t_skiplist *list, USER_KEY_TYPE key) {
+    if (nullptr == list)
+        return -1;
+
+    t_skiplist_node *preds[SKIPLIST_MAX_LEVEL];
+    t_skiplist_node *succs[SKIPLIST_MAX_LEVEL];
+    int level = skiplist_random_level();
+
+    ebr_enter(list->ebr);
+    t_skiplist_node *node = nullptr;
+    while (true) {
+        if (__skiplist_find(list, key, preds, succs)) {
+            ebr_exit(list->ebr);
+            if (node) {
+                skiplist_free_node(node);
+            }
+            return 1;
+        }
+
+        if (nullptr == node) {
+            node = skiplist_create_node(key, level);
+            if (nullptr == node) {
+                ebr_exit(list->ebr);
+                return -2;
+            }
+        }
+
+        for (int i = 0; i < level; ++i) {
+            node->next[i].store((uintptr_t)succs[i], std::memory_order_relaxed);
+        }
+
+        // 底层链接成功，节点就算插入成功了（线性化点）
+        uintptr_t expected = (uintptr_t)succs[0];
+        if (preds[0]->next[0].compare_exchange_strong(expected, (uintptr_t)node))
+            break;
+    }
+
+    // 再从下往上逐层链接
+    for (int i = 1; i < level; ++i) {
+        while (true) {
+            uintptr_t next = node->next[i].load();
+            // 节点已经被其他线程删除，不再继续链接
+            if (skiplist_is_marked(next))
+                goto done;
+
+            if (skiplist_ptr(next) != succs[i] &&
+                !node->next[i].compare_exchange_strong(next, (uintptr_t)succs[i]))
+                continue;
+
+            uintptr_t expected = (uintptr_t)succs[i];
+            if (preds[i]->next[i].compare_exchange_strong(expected, (uintptr_t)node))
+                break;
+
+            // 前驱发生了变化，重新查找；如果底层找到的已不是当前节点，说明它已经被删掉了
+            __skiplist_find(list, key, preds, succs);
+            if (succs[0] != node)
+                goto done;
+        }
+    }
+
+done:
+    // 在链接的过程中节点被删除了，它可能刚刚又被链到了某一层上，再查找一遍把它摘干净
+    if (skiplist_is_marked(node->next[0].load())) {
+        __skiplist_find(list, key, preds, succs);
+    }
+    skiplist_release_node(list, node);
+    ebr_exit(list->ebr);
+    return 0;
+}
+
+// 删除key，成功返回0，不存在返回1
+int skiplist_erase(t_skiplist *list, USER_KEY_TYPE key) {
+    if (nullptr == list)
+        return -1;
+
+    t_skiplist_node *preds[SKIPLIST_MAX_LEVEL];
+    t_skiplist_node *succs[SKIPLIST_MAX_LEVEL];
+
+    ebr_enter(list->ebr);
+    if (!__skiplist_find(list, key, preds, succs)) {
+        ebr_exit(list->ebr);
+        return 1;
+    }
+
+    t_skiplist_node *node = succs[0];
+    // 从最高层到第1层依次标记，第0层最后标记
+    for (int i = node->level - 1; i >= 1; --i) {
+        uintptr_t next = node->next[i].load();
+        while (!skiplist_is_marked(next)) {
+            node->next[i].compare_exchange_weak(next, next | SKIPLIST_MARK_BIT);
+        }
+    }
+
+    // 第0层标记成功的线程才是真正删除该节点的线程
+    uintptr_t next = node->next[0].load();
+    while (true) {
+        if (skiplist_is_marked(next)) {
+            ebr_exit(list->ebr);
+            return 1;
+        }
+
+        if (node->next[0].compare_exchange_strong(next, next | SKIPLIST_MARK_BIT))
+            break;
+    }
+
+    // 借助查找完成物理删除
+    __skiplist_find(list, key, preds, succs);
+    skiplist_release_node(list, node);
+    ebr_exit(list->ebr);
+    return 0;
+}
+
+int skiplist_contains(t_skiplist *list, USER_KEY_TYPE key) {
+    if (nullptr == list)
+        return 0;
+
+    // 查找只读不写，不去摘除被标记的节点，遇到被标记的节点直接跳过
+    ebr_enter(list->ebr);
+    t_skiplist_node *pred = list->head;
+    t_skiplist_node *curr = nullptr;
+    for (int level = SKIPLIST_MAX_LEVEL - 1; level >= 0; --level) {
+        curr = skiplist_ptr(pred->next[level].load());
+        while (curr) {
+            uintptr_t succ = curr->next[level].load();
+            if (!skiplist_is_marked(succ) && curr->key >= key)
+                break;
+
+            if (!skiplist_is_marked(succ)) {
+                pred = curr;
+            }
+            curr = skiplist_ptr(succ);
+        }
+    }
+
+    int found = curr != nullptr && curr->key == key && !skiplist_is_marked(curr->next[0].load());
+    ebr_exit(list->ebr);
+    return found;
+}
+
+// 有序遍历底层链表，与其他线程并发执行时得到的是弱一致的结果
+int inorder_traversal(t_skiplist *list, vector<int>& result) {
+    if (nullptr == list)
+        return -1;
+
+    ebr_enter(list->ebr);
+    t_skiplist_node *cursor = skiplist_ptr(list->head->next[0].load());
+    while (cursor) {
+        uintptr_t next = cursor->next[0].load();
+        if (!skiplist_is_marked(next)) {
+            result.emplace_back(cursor->key);
+        }
+        cursor = skiplist_ptr(next);
+    }
+    ebr_exit(list->ebr);
+
+    return 0;
+}
+
+// 销毁跳表，调用时不能再有其他线程访问该跳表
+void skiplist_destroy(t_skiplist *list) {
+    if (nullptr == list || nullptr == list->head)
+        return;
+
+    t_skiplist_node *cursor = list->head;
+    while (cursor) {
+        t_skiplist_node *next = skiplist_ptr(cursor->next[0].load());
+        skiplist_free_node(cursor);
+        cursor = next;
+    }
+    list->head = nullptr;
+
+    // 已经被摘除、还在等待回收的节点，只属于这个跳表；此时没有线程处于它的临界区，可以直接释放
+    for (int i = 0; i < EBR_MAX_THREADS; ++i) {
+        for (auto &item : list->ebr->slots[i].retired) {
+            skiplist_free_node(item.node);
+        }
+    }
+    delete list->ebr;
+    list->ebr = nullptr;
+}
+
+/* ---------------------------------- 性能对比 --------------------------------- */
+
+#define BENCH_KEY_RANGE     (1 << 20)
+#define BENCH_TOTAL_OPS     (1 << 21)
+
+// 查找的结果累加到这里，防止编译器把没有副作用的查找优化掉
+static std::atomic<long long> g_bench_sink(0);
+
+// 写多的负载：40%插入，40%删除，20%查找
+template <typename F>
+static double bench_run(int threads, F &&op) {
+    vector<std::thread> workers;
+    int ops_per_thread = BENCH_TOTAL_OPS / threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            uint64_t seed = 0x2545F4914F6CDD1DULL * (t + 1);
+            long long sink = 0;
+            for (int i = 0; i < ops_per_thread; ++i) {
+                seed ^= seed << 13;
+                seed ^= seed >> 7;
+                seed ^= seed << 17;
+                int key = (int)(seed % BENCH_KEY_RANGE);
+                int kind = (int)((seed >> 32) % 10);
+                sink += op(kind < 4 ? 0 : (kind < 8 ? 1 : 2), key);
+            }
+            g_bench_sink += sink;
+        });
+    }
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return (double)ops_per_thread * threads / seconds / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+    // 与红黑树相同的测试数据
+    int nums[] = {12,31,24,5,12,5,34,9,2985,324,5,69,8};
+    int len = sizeof(nums) / sizeof(int);
+
+    t_skiplist list;
+    skiplist_init(&list);
+    for (int i = 0; i < len; ++i) {
+        skiplist_insert(&list, nums[i]);
+    }
+
+    vector<int> result;
+    inorder_traversal(&list, result);
+    for (auto key : result) {
+        std::printf("%d ", key);
+    }
+    std::printf("\n");
+
+    int del_nums[] = {5, 0, 12, 2985, 69};
+    len = sizeof(del_nums) / sizeof(int);
+    for (int i = 0; i < len; ++i) {
+        skiplist_erase(&list, del_nums[i]);
+    }
+
+    result.clear();
+    inorder_traversal(&list, result);
+    for (auto key : result) {
+        std::printf("%d ", key);
+    }
+    std::printf("\n");
+    skiplist_destroy(&list);
+
+    // 多线程对比：跳表无锁；红黑树只能整棵树加一把互斥锁
+    int max_threads = argc > 1 ? std::atoi(argv[1]) : 64;
+    std::printf("%8s %16s %16s\n", "threads", "skiplist Mops/s", "rbtree Mops/s");
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        skiplist_init(&list);
+        double skiplist_mops = bench_run(threads, [&](int op, int key) {
+            if (op == 0)
+                return skiplist_insert(&list, key);
+            if (op == 1)
+                return skiplist_erase(&list, key);
+            return skiplist_contains(&list, key);
+        });
+        skiplist_destroy(&list);
+
+        t_rbtree tree = {};
+        rbtree_init(&tree);
+        std::mutex tree_mutex;
+        double rbtree_mops = bench_run(threads, [&](int op, int key) {
+            std::lock_guard<std::mutex> lock(tree_mutex);
+            if (op == 0) {
+                rbtree_insert(&tree, key);
+            } else if (op == 1) {
+                rbtree_erase(&tree, key);
+            } else {
+                return (int)(rbtree_find(&tree, key) != nullptr);
+            }
+            return 0;
+        });
+        rbtree_destroy(&tree);
+
+        std::printf("%8d %16.2f %16.2f\n", threads, skiplist_mops, rbtree_mops);
+    }
+
+    return 0;
+}
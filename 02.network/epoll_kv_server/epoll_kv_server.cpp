@@ -0,0 +1,523 @@
+/**
+ * @file epoll_kv_server.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief 基于epoll的单进程TCP键值服务器，以红黑树作为有序索引，支持GET/PUT/DEL/RANGE
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#define RBTREE_NO_MAIN
+#include "../../01.dataStructure/red_black_tree/red_black_tree_recursion.cpp"
+
+using std::vector;
+
+/*
+    协议是按行分隔的文本协议，一个连接上可以连续发送多条请求而不必等待响应（pipelining），响应按请求的顺序返回：
+        GET <key>                   ->  $<len>\r\n<value>\r\n，不存在时为$-1\r\n
+        PUT <key> <value>           ->  +OK\r\n，value是key之后直到行尾的全部内容
+        DEL <key>                   ->  :1\r\n或:0\r\n
+        RANGE <lo> <hi> [limit]     ->  *<n>\r\n，之后是n组:<key>\r\n$<len>\r\n<value>\r\n，按key升序，key在[lo, hi)中
+        出错时                       ->  -ERR <原因>\r\n
+
+    1. 存储：t_rbtree只保存key，作为RANGE所需的有序索引；值保存在以key为索引的哈希表中，GET不需要走树。
+    2. 按tick批量执行：一次epoll_wait返回后，先把所有可读连接上的数据读完并解析成命令，放进同一个批次，再按顺序依次
+       执行，最后统一给有响应的连接发送。同一个tick中到达的命令一起执行，减少了读写交替带来的缓存抖动，也让每个连接的
+       响应可以攒成一次writev发送。
+    3. 零拷贝拼装响应：响应中的值不拷贝到输出缓冲区，而是作为一个独立的片段直接引用存储中的字符串，只有很短的响应头
+       写到连接自己的头部缓冲区中，发送时把这些片段组成iovec数组交给writev。值用引用计数的只读字符串保存，PUT和DEL
+       替换或删除一个值时，还在等待发送的响应仍然持有旧值的引用，不会读到被释放的内存。
+    4. 输出背压：客户端只发请求不读响应时，响应会在连接的输出队列中无限积压。积压超过高水位KV_OUT_HIGH_WATER时
+       从epoll中去掉EPOLLIN，不再读取和解析这个连接上的请求，对端的发送缓冲区满了之后自然就停下来；发送到低水位
+       KV_OUT_LOW_WATER以下时再恢复读。两个水位之间留出间隔，避免在阈值附近反复调用epoll_ctl。水位只在每个tick
+       结束时检查，因此每个tick从一个连接上最多读KV_READ_PER_TICK字节，剩下的留在内核中，水平触发的epoll下一次
+       还会报告可读，这样一个tick中产生的响应也是有上限的。
+*/
+
+typedef std::shared_ptr<const std::string> t_kv_value;
+
+typedef struct kv_store {
+    t_rbtree index;
+    std::unordered_map<USER_KEY_TYPE, t_kv_value> values;
+} t_kv_store;
+
+// 待发送的一个片段：value为空时引用连接头部缓冲区中[offset, offset + length)的内容，否则引用value本身
+typedef struct kv_segment {
+    t_kv_value value;
+    size_t offset;
+    size_t length;
+} t_kv_segment;
+
+typedef struct kv_conn {
+    int fd;
+    std::string in;                 // 收到但还没有解析的数据
+    std::string header;             // 响应头
+    vector<t_kv_segment> out;
+    size_t out_head;                // out中第一个还没发完的片段
+    size_t out_written;             // 该片段已经发送的字节数
+    size_t out_bytes;               // 还没有发送的字节数
+    uint32_t events;                // 当前在epoll中注册的事件
+    int read_paused;                // 输出积压超过高水位，暂停读
+    int closing;                    // 对端已关闭或出错，本tick结束后关闭
+    int dirty;                      // 本tick中有新的响应需要发送
+} t_kv_conn;
+
+#define KV_CMD_GET   1
+#define KV_CMD_PUT   2
+#define KV_CMD_DEL   3
+#define KV_CMD_RANGE 4
+#define KV_CMD_ERROR 5
+
+typedef struct kv_command {
+    t_kv_conn *conn;
+    int type;
+    USER_KEY_TYPE key;
+    USER_KEY_TYPE key2;             // RANGE的上界
+    int limit;                      // RANGE最多返回的个数
+    t_kv_value value;               // PUT的值
+    const char *error;
+} t_kv_command;
+
+#define KV_MAX_LINE     (64 * 1024)
+#define KV_RANGE_LIMIT  1000
+#define KV_IOV_MAX      1024
+#define KV_MAX_EVENTS   256
+
+#define KV_READ_PER_TICK    (256 * 1024)
+#define KV_OUT_HIGH_WATER   (4 * 1024 * 1024)
+#define KV_OUT_LOW_WATER    (1 * 1024 * 1024)
+
+/* ---------------------------------- 存储 ---------------------------------- */
+
+static void kv_store_put(t_kv_store *store, USER_KEY_TYPE key, const t_kv_value& value) {
+    auto it = store->values.find(key);
+    if (it == store->values.end()) {
+        rbtree_insert(&store->index, key);
+        store->values.emplace(key, value);
+    } else {
+        it->second = value;
+    }
+}
+
+static int kv_store_del(t_kv_store *store, USER_KEY_TYPE key) {
+    if (store->values.erase(key) == 0)
+        return 0;
+
+    rbtree_erase(&store->index, key);
+    return 1;
+}
+
+// 把[lo, hi)中的key按升序追加到result中，最多limit个
+static void __kv_range(t_rbtree_node *root, USER_KEY_TYPE lo, USER_KEY_TYPE hi, size_t limit, vector<int>& result) {
+    if (root == nil_node || result.size() >= limit)
+        return;
+
+    if (lo < root->key) {
+        __kv_range(root->left, lo, hi, limit, result);
+    }
+    if (lo <= root->key && root->key < hi && result.size() < limit) {
+        result.push_back(root->key);
+    }
+    if (root->key < hi) {
+        __kv_range(root->right, lo, hi, limit, result);
+    }
+}
+
+/* -------------------------------- 响应拼装 -------------------------------- */
+
+// 追加一段响应头，与前一个头部片段相邻时直接合并，减少iovec的个数
+static void __kv_reply_header(t_kv_conn *conn, const char *data, size_t length) {
+    size_t offset = conn->header.size();
+    conn->header.append(data, length);
+    conn->out_bytes += length;
+
+    if (conn->out.size() > conn->out_head) {
+        t_kv_segment& last = conn->out.back();
+        if (!last.value && last.offset + last.length == offset) {
+            last.length += length;
+            return;
+        }
+    }
+    conn->out.push_back({nullptr, offset, length});
+}
+
+static void __kv_reply_format(t_kv_conn *conn, const char *format, long long number) {
+    char buffer[32];
+    int length = std::snprintf(buffer, sizeof(buffer), format, number);
+    __kv_reply_header(conn, buffer, length);
+}
+
+// 追加一个值：不拷贝，只持有它的引用
+static void __kv_reply_value(t_kv_conn *conn, const t_kv_value& value) {
+    __kv_reply_format(conn, "$%lld\r\n", (long long)value->size());
+    if (!value->empty()) {
+        conn->out.push_back({value, 0, value->size()});
+        conn->out_bytes += value->size();
+    }
+    __kv_reply_header(conn, "\r\n", 2);
+}
+
+static void kv_execute(t_kv_store *store, t_kv_command *command, vector<int>& scratch) {
+    t_kv_conn *conn = command->conn;
+    conn->dirty = 1;
+
+    switch (command->type) {
+    case KV_CMD_GET: {
+        auto it = store->values.find(command->key);
+        if (it == store->values.end()) {
+            __kv_reply_header(conn, "$-1\r\n", 5);
+        } else {
+            __kv_reply_value(conn, it->second);
+        }
+        break;
+    }
+    case KV_CMD_PUT:
+        kv_store_put(store, command->key, command->value);
+        __kv_reply_header(conn, "+OK\r\n", 5);
+        break;
+    case KV_CMD_DEL:
+        __kv_reply_format(conn, ":%lld\r\n", kv_store_del(store, command->key));
+        break;
+    case KV_CMD_RANGE:
+        scratch.clear();
+        __kv_range(store->index.root, command->key, command->key2, command->limit, scratch);
+        __kv_reply_format(conn, "*%lld\r\n", (long long)scratch.size());
+        for (auto key : scratch) {
+            __kv_reply_format(conn, ":%lld\r\n", key);
+            __kv_reply_value(conn, store->values[key]);
+        }
+        break;
+    default:
+        __kv_reply_header(conn, "-ERR ", 5);
+        __kv_reply_header(conn, command->error, std::strlen(command->error));
+        __kv_reply_header(conn, "\r\n", 2);
+        break;
+    }
+}
+
+/* ---------------------------------- 解析 ---------------------------------- */
+
+static int __kv_parse_int(const char **cursor, const char *end, USER_KEY_TYPE *value) {
+    const char *p = *cursor;
+    while (p < end && *p == ' ') {
+        ++p;
+    }
+
+    char *stop = nullptr;
+    errno = 0;
+    long long number = std::strtoll(p, &stop, 10);
+    if (stop == p || stop > end || errno != 0 || number < INT32_MIN || number > INT32_MAX)
+        return -1;
+
+    *value = (USER_KEY_TYPE)number;
+    *cursor = stop;
+    return 0;
+}
+
+// 解析一行命令，line不包含结尾的换行符
+static void __kv_parse_line(t_kv_conn *conn, const char *line, const char *end, vector<t_kv_command>& batch) {
+    t_kv_command command;
+    command.conn = conn;
+    command.type = KV_CMD_ERROR;
+    command.error = "unknown command";
+
+    const char *cursor = line;
+    while (cursor < end && *cursor != ' ') {
+        ++cursor;
+    }
+    std::string name(line, cursor);
+
+    if (name == "GET" || name == "DEL") {
+        command.type = (name == "GET" ? KV_CMD_GET : KV_CMD_DEL);
+        if (__kv_parse_int(&cursor, end, &command.key) != 0) {
+            command.type = KV_CMD_ERROR;
+            command.error = "invalid key";
+        }
+    } else if (name == "PUT") {
+        command.type = KV_CMD_PUT;
+        if (__kv_parse_int(&cursor, end, &command.key) != 0 || cursor == end || *cursor != ' ') {
+            command.type = KV_CMD_ERROR;
+            command.error = "usage: PUT <key> <value>";
+        } else {
+            command.value = std::make_shared<const std::string>(cursor + 1, end);
+        }
+    } else if (name == "RANGE") {
+        command.type = KV_CMD_RANGE;
+        command.limit = KV_RANGE_LIMIT;
+        USER_KEY_TYPE limit = KV_RANGE_LIMIT;
+        if (__kv_parse_int(&cursor, end, &command.key) != 0 || __kv_parse_int(&cursor, end, &command.key2) != 0 ||
+            (cursor < end && (__kv_parse_int(&cursor, end, &limit) != 0 || limit < 0))) {
+            command.type = KV_CMD_ERROR;
+            command.error = "usage: RANGE <lo> <hi> [limit]";
+        } else if (limit < KV_RANGE_LIMIT) {
+            command.limit = limit;
+        }
+    }
+
+    batch.push_back(std::move(command));
+}
+
+// 把连接输入缓冲区中所有完整的行解析成命令
+static void kv_parse(t_kv_conn *conn, vector<t_kv_command>& batch) {
+    size_t start = 0;
+    while (start < conn->in.size()) {
+        size_t newline = conn->in.find('\n', start);
+        if (newline == std::string::npos)
+            break;
+
+        size_t end = newline;
+        if (end > start && conn->in[end - 1] == '\r') {
+            --end;
+        }
+        if (end > start) {
+            __kv_parse_line(conn, conn->in.data() + start, conn->in.data() + end, batch);
+        }
+        start = newline + 1;
+    }
+    conn->in.erase(0, start);
+
+    // 一直凑不出一行，认为是恶意的输入
+    if (conn->in.size() > KV_MAX_LINE) {
+        conn->closing = 1;
+    }
+}
+
+/* ---------------------------------- 网络 ---------------------------------- */
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void on_signal(int) {
+    g_stop = 1;
+}
+
+static int kv_listen(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0)
+        return -1;
+
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 1024) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// 读到EAGAIN或者读满KV_READ_PER_TICK为止，对端关闭或出错时设置closing
+static void kv_read(t_kv_conn *conn) {
+    char buffer[64 * 1024];
+    size_t total = 0;
+    while (total < KV_READ_PER_TICK) {
+        ssize_t n = read(conn->fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            conn->in.append(buffer, n);
+            total += n;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        conn->closing = 1;
+        return;
+    }
+}
+
+// 用writev发送所有待发送的片段，全部发完返回0，还有剩余返回1，出错返回-1
+static int kv_flush(t_kv_conn *conn) {
+    struct iovec iov[KV_IOV_MAX];
+    while (conn->out_head < conn->out.size()) {
+        int count = 0;
+        for (size_t i = conn->out_head; i < conn->out.size() && count < KV_IOV_MAX; ++i, ++count) {
+            const t_kv_segment& segment = conn->out[i];
+            const char *base = segment.value ? segment.value->data() + segment.offset
+                                             : conn->header.data() + segment.offset;
+            size_t skip = (i == conn->out_head ? conn->out_written : 0);
+            iov[count].iov_base = (void *)(base + skip);
+            iov[count].iov_len = segment.length - skip;
+        }
+
+        ssize_t n = writev(conn->fd, iov, count);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 1 : -1;
+        }
+
+        size_t left = n;
+        conn->out_bytes -= n;
+        while (left > 0) {
+            size_t remain = conn->out[conn->out_head].length - conn->out_written;
+            if (left < remain) {
+                conn->out_written += left;
+                break;
+            }
+
+            left -= remain;
+            conn->out[conn->out_head++].value.reset();
+            conn->out_written = 0;
+        }
+    }
+
+    conn->out.clear();
+    conn->header.clear();
+    conn->out_head = conn->out_written = conn->out_bytes = 0;
+    return 0;
+}
+
+static void kv_close(int epfd, t_kv_conn *conn) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, nullptr);
+    close(conn->fd);
+    delete conn;
+}
+
+int main(int argc, char *argv[]) {
+    int port = argc > 1 ? std::atoi(argv[1]) : 9527;
+
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    int listen_fd = kv_listen(port);
+    if (listen_fd < 0) {
+        std::perror("listen");
+        return 1;
+    }
+
+    int epfd = epoll_create1(0);
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;          // data.ptr为空表示监听套接字
+    epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &event);
+
+    t_kv_store store;
+    rbtree_init(&store.index);
+
+    struct epoll_event events[KV_MAX_EVENTS];
+    vector<t_kv_command> batch;
+    vector<t_kv_conn *> touched;
+    vector<int> scratch;
+    long long ticks = 0, commands = 0, max_batch = 0;
+
+    std::printf("listening on port %d\n", port);
+    std::fflush(stdout);
+    while (!g_stop) {
+        int n = epoll_wait(epfd, events, KV_MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+
+            std::perror("epoll_wait");
+            break;
+        }
+
+        // 1. 读取并解析本tick中所有可读连接上的数据
+        batch.clear();
+        touched.clear();
+        for (int i = 0; i < n; ++i) {
+            t_kv_conn *conn = (t_kv_conn *)events[i].data.ptr;
+            if (conn == nullptr) {
+                int fd;
+                while ((fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK)) >= 0) {
+                    int on = 1;
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+                    t_kv_conn *client = new t_kv_conn;
+                    client->fd = fd;
+                    client->out_head = client->out_written = client->out_bytes = 0;
+                    client->events = EPOLLIN | EPOLLRDHUP;
+                    client->read_paused = client->closing = client->dirty = 0;
+
+                    struct epoll_event ev;
+                    ev.events = client->events;
+                    ev.data.ptr = client;
+                    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+                }
+                continue;
+            }
+
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                kv_read(conn);
+                kv_parse(conn, batch);
+            }
+            conn->dirty = 1;
+            touched.push_back(conn);
+        }
+
+        // 2. 按到达顺序批量执行
+        for (auto& command : batch) {
+            kv_execute(&store, &command, scratch);
+        }
+        ++ticks;
+        commands += batch.size();
+        max_batch = (long long)batch.size() > max_batch ? batch.size() : max_batch;
+
+        // 3. 发送响应，没发完的注册EPOLLOUT，等下一次可写时继续
+        for (auto conn : touched) {
+            if (!conn->dirty)
+                continue;
+
+            conn->dirty = 0;
+            // 对端已经关闭时尽量把响应发出去，发不完也直接关闭
+            int ret = kv_flush(conn);
+            if (ret < 0 || conn->closing) {
+                kv_close(epfd, conn);
+                continue;
+            }
+
+            // 输出积压超过高水位时暂停读，降到低水位以下再恢复
+            if (conn->out_bytes > KV_OUT_HIGH_WATER) {
+                conn->read_paused = 1;
+            } else if (conn->out_bytes <= KV_OUT_LOW_WATER) {
+                conn->read_paused = 0;
+            }
+
+            int want_write = (ret == 1);
+            uint32_t events = EPOLLRDHUP | (conn->read_paused ? 0u : (uint32_t)EPOLLIN) |
+                              (want_write ? (uint32_t)EPOLLOUT : 0u);
+            if (events != conn->events) {
+                struct epoll_event ev;
+                ev.events = events;
+                ev.data.ptr = conn;
+                epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &ev);
+                conn->events = events;
+            }
+        }
+    }
+
+    std::printf("ticks: %lld, commands: %lld, avg batch: %.1f, max batch: %lld, keys: %zu\n",
+                ticks, commands, ticks ? (double)commands / ticks : 0.0, max_batch, store.values.size());
+    close(epfd);
+    close(listen_fd);
+    rbtree_destroy(&store.index);
+    return 0;
+}
@@ -0,0 +1,289 @@
+/**
+ * @file kv_load_generator.cpp
+ * @author digSelf (coding@algo.ac.cn)
+ * @brief epoll_kv_server的回环压测工具：多个连接、固定的流水线深度，统计吞吐量和延迟分布
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using std::vector;
+
+/*
+    单线程、基于epoll的客户端。每个连接始终保持depth个请求在途：收到一个完整的响应，就立刻补发一个新的请求，
+发送时刻记录在连接自己的队列中，响应按顺序返回，所以队头就是这个响应对应的请求，两者之差就是这个请求的延迟。
+    请求的组成：80% GET，15% PUT，4% DEL，1% RANGE（最多10个key）。压测开始前先用PUT把一半的key写进去。
+*/
+
+typedef struct load_conn {
+    int fd;
+    std::string in;
+    std::string out;
+    size_t out_sent;
+    std::deque<int64_t> sent_at;            // 在途请求的发送时间，单位ns
+} t_load_conn;
+
+static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int load_connect(const char *host, int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, host, &addr.sin_addr);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    return fd;
+}
+
+// 从buffer的pos处读一行（以\r\n结尾），返回下一行的起始位置，不完整返回npos
+static size_t __read_line(const std::string& buffer, size_t pos) {
+    size_t end = buffer.find("\r\n", pos);
+    return end == std::string::npos ? std::string::npos : end + 2;
+}
+
+// 读一个$<len>\r\n<value>\r\n（或$-1\r\n），返回结束的位置，不完整返回npos
+static size_t __read_bulk(const std::string& buffer, size_t pos) {
+    size_t next = __read_line(buffer, pos);
+    if (next == std::string::npos)
+        return next;
+
+    long long length = std::atoll(buffer.c_str() + pos + 1);
+    if (length < 0)
+        return next;
+
+    return buffer.size() >= next + length + 2 ? next + length + 2 : std::string::npos;
+}
+
+// 解析buffer中从pos开始的一个完整响应，返回它结束的位置，不完整返回0
+static size_t parse_response(const std::string& buffer, size_t pos) {
+    if (pos >= buffer.size())
+        return 0;
+
+    size_t end = std::string::npos;
+    switch (buffer[pos]) {
+    case '$':
+        end = __read_bulk(buffer, pos);
+        break;
+    case '*': {
+        end = __read_line(buffer, pos);
+        long long count = std::atoll(buffer.c_str() + pos + 1);
+        for (long long i = 0; i < count && end != std::string::npos; ++i) {
+            end = __read_line(buffer, end);
+            if (end != std::string::npos) {
+                end = __read_bulk(buffer, end);
+            }
+        }
+        break;
+    }
+    default:
+        end = __read_line(buffer, pos);
+        break;
+    }
+
+    return end == std::string::npos ? 0 : end;
+}
+
+static void make_request(std::string& out, std::mt19937& rng, int key_space, const std::string& value) {
+    char buffer[64];
+    int key = (int)(rng() % key_space);
+    int dice = (int)(rng() % 100);
+    if (dice < 80) {
+        std::snprintf(buffer, sizeof(buffer), "GET %d\r\n", key);
+        out += buffer;
+    } else if (dice < 95) {
+        std::snprintf(buffer, sizeof(buffer), "PUT %d ", key);
+        out += buffer;
+        out += value;
+        out += "\r\n";
+    } else if (dice < 99) {
+        std::snprintf(buffer, sizeof(buffer), "DEL %d\r\n", key);
+        out += buffer;
+    } else {
+        std::snprintf(buffer, sizeof(buffer), "RANGE %d %d 10\r\n", key, key + 100);
+        out += buffer;
+    }
+}
+
+// 尽量把out发出去，出错返回-1
+static int load_flush(t_load_conn *conn) {
+    while (conn->out_sent < conn->out.size()) {
+        ssize_t n = send(conn->fd, conn->out.data() + conn->out_sent, conn->out.size() - conn->out_sent,
+                         MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) {
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+        conn->out_sent += n;
+    }
+
+    conn->out.clear();
+    conn->out_sent = 0;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *host = argc > 1 ? argv[1] : "127.0.0.1";
+    int port = argc > 2 ? std::atoi(argv[2]) : 9527;
+    int conns = argc > 3 ? std::atoi(argv[3]) : 16;
+    int depth = argc > 4 ? std::atoi(argv[4]) : 16;
+    double seconds = argc > 5 ? std::atof(argv[5]) : 5;
+    int key_space = 100000;
+    std::string value(64, 'v');
+
+    std::signal(SIGPIPE, SIG_IGN);
+    std::mt19937 rng(20260417);
+
+    // 预热：写入一半的key
+    int fd = load_connect(host, port);
+    if (fd < 0) {
+        std::perror("connect");
+        return 1;
+    }
+    {
+        std::string batch;
+        char buffer[64];
+        for (int key = 0; key < key_space; key += 2) {
+            std::snprintf(buffer, sizeof(buffer), "PUT %d ", key);
+            batch += buffer;
+            batch += value;
+            batch += "\r\n";
+        }
+        size_t expected = key_space / 2 * 5, received = 0, sent = 0;
+        while (sent < batch.size()) {
+            ssize_t n = write(fd, batch.data() + sent, batch.size() - sent);
+            if (n <= 0) {
+                std::perror("write");
+                return 1;
+            }
+            sent += n;
+        }
+        char reply[65536];
+        while (received < expected) {
+            ssize_t n = read(fd, reply, sizeof(reply));
+            if (n <= 0) {
+                std::perror("read");
+                return 1;
+            }
+            received += n;
+        }
+        close(fd);
+    }
+
+    int epfd = epoll_create1(0);
+    vector<t_load_conn> clients(conns);
+    for (int i = 0; i < conns; ++i) {
+        t_load_conn *conn = &clients[i];
+        conn->fd = load_connect(host, port);
+        if (conn->fd < 0) {
+            std::perror("connect");
+            return 1;
+        }
+        conn->out_sent = 0;
+
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = conn;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, conn->fd, &event);
+
+        int64_t now = now_ns();
+        for (int j = 0; j < depth; ++j) {
+            make_request(conn->out, rng, key_space, value);
+            conn->sent_at.push_back(now);
+        }
+        load_flush(conn);
+    }
+
+    vector<int64_t> latencies;
+    latencies.reserve(1 << 22);
+    struct epoll_event events[256];
+    int64_t start = now_ns();
+    int64_t deadline = start + (int64_t)(seconds * 1e9);
+    char buffer[64 * 1024];
+    while (now_ns() < deadline) {
+        int n = epoll_wait(epfd, events, 256, 100);
+        for (int i = 0; i < n; ++i) {
+            t_load_conn *conn = (t_load_conn *)events[i].data.ptr;
+            ssize_t bytes = read(conn->fd, buffer, sizeof(buffer));
+            if (bytes <= 0) {
+                std::fprintf(stderr, "server closed the connection\n");
+                return 1;
+            }
+            conn->in.append(buffer, bytes);
+
+            // 每收到一个完整的响应，记录延迟并补发一个请求
+            size_t consumed = 0, end;
+            int64_t now = now_ns();
+            while (!conn->sent_at.empty()) {
+                if ((end = parse_response(conn->in, consumed)) == 0)
+                    break;
+
+                consumed = end;
+                latencies.push_back(now - conn->sent_at.front());
+                conn->sent_at.pop_front();
+                make_request(conn->out, rng, key_space, value);
+                conn->sent_at.push_back(now);
+            }
+            conn->in.erase(0, consumed);
+            if (load_flush(conn) != 0) {
+                std::perror("send");
+                return 1;
+            }
+        }
+
+        // 发送缓冲区满时没发完的部分，这里补发
+        for (auto& conn : clients) {
+            if (!conn.out.empty()) {
+                load_flush(&conn);
+            }
+        }
+    }
+    double elapsed = (now_ns() - start) / 1e9;
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies.empty() ? 0.0 : latencies[(size_t)(p * (latencies.size() - 1))] / 1000.0;
+    };
+    std::printf("connections: %d, pipeline depth: %d, %.1f s\n", conns, depth, elapsed);
+    std::printf("requests: %zu, throughput: %.0f req/s\n", latencies.size(), latencies.size() / elapsed);
+    std::printf("latency us: p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+                percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999), percentile(1.0));
+
+    for (auto& conn : clients) {
+        close(conn.fd);
+    }
+    close(epfd);
+    return 0;
+}